@@ -0,0 +1,235 @@
+/* Throughput of first-match lookups replayed against generated tables.
+ *
+ * For each size a table is generated (see `generator_table`) and minimised
+ * with m-Trie, and a trace of keys is drawn from the entries of the original
+ * (with their Xs filled at random) mixed with arbitrary keys. The trace is
+ * replayed against both tables, using `lookup` and `lookup_batch`, on a
+ * single pinned CPU. A line of JSON is written for each table giving the
+ * size of its compiled form and the lookups per second achieved.
+ *
+ * Every key routed by the original table must be routed the same way by the
+ * minimised table; any which are not are counted as mismatches (and the exit
+ * status is non-zero).
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "mtrie.h"
+#include "table_generator.h"
+#include "lookup.h"
+
+
+// Default sizes of table
+static const unsigned int default_sizes[] = {100, 1000, 10000, 100000};
+#define N_DEFAULT_SIZES (sizeof(default_sizes) / sizeof(default_sizes[0]))
+
+// Most sizes which may be given
+#define MAX_SIZES 32
+
+// Seed of the generated tables and traces
+#define BENCH_SEED 1
+
+// One in this many keys of a trace is arbitrary
+#define ARBITRARY_KEYS 8
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+
+// Fill a trace with keys matching the entries of a table, and some arbitrary
+// keys
+static void make_trace(table_t *table, uint32_t *keys, unsigned int n_keys)
+{
+  uint64_t x = BENCH_SEED;
+  for (unsigned int i = 0; i < n_keys; i++)
+  {
+    // xorshift64*
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    uint64_t r = x * 0x2545f4914f6cdd1dull;
+
+    keys[i] = r >> 32;
+    if (table->size > 0 && (i % ARBITRARY_KEYS) != 0)
+    {
+      keymask_t km = table->entries[(r & 0xffffffff) % table->size].keymask;
+      keys[i] = (km.key & km.mask) | (keys[i] & ~km.mask);
+    }
+  }
+}
+
+
+// Replay a trace a number of times, returns the best lookups per second
+static double replay(lookup_t *l, uint32_t *keys, uint32_t *indices,
+                     unsigned int n_keys, unsigned int reps, bool batch)
+{
+  uint64_t best = UINT64_MAX;
+  for (unsigned int r = 0; r < reps; r++)
+  {
+    uint64_t t = now_ns();
+    if (batch)
+    {
+      lookup_batch(l, keys, n_keys, indices);
+    }
+    else
+    {
+      for (unsigned int i = 0; i < n_keys; i++)
+      {
+        indices[i] = lookup(l, keys[i]);
+      }
+    }
+    t = now_ns() - t;
+    best = (t < best) ? t : best;
+  }
+  return best ? n_keys * 1e9 / best : 0.0;
+}
+
+
+// Compile and replay a trace against a table, leaving the index of the entry
+// matching each key in `indices`
+static void bench(FILE *f, const char *name, table_t *table, uint32_t *keys,
+                  uint32_t *indices, unsigned int n_keys, unsigned int reps)
+{
+  uint64_t build_ns = now_ns();
+  lookup_t l = lookup_init(table);
+  build_ns = now_ns() - build_ns;
+
+  double single = replay(&l, keys, indices, n_keys, reps, false);
+  double batch = replay(&l, keys, indices, n_keys, reps, true);
+
+  fprintf(f, "{\"table\": \"%s\", \"entries\": %u, \"linear\": %s, "
+             "\"depth\": %u, \"nodes\": %u, \"blocks\": %u, "
+             "\"build_ns\": %llu, \"keys\": %u, \"lookups_per_s\": %.0f, "
+             "\"batch_lookups_per_s\": %.0f}\n",
+          name, table->size, l.linear ? "true" : "false", l.depth,
+          l.n_nodes, l.n_blocks, (unsigned long long) build_ns, n_keys,
+          single, batch);
+  fflush(f);
+
+  lookup_delete(&l);
+}
+
+
+int main(int argc, char *argv[])
+{
+  // Usage:
+  // bench_lookup [-k keys] [-r reps] [-c cpu] [size ...]
+  unsigned int n_keys = 1 << 24;
+  unsigned int reps = 5;
+  int cpu = -1;  // The CPU the benchmark starts on
+  int opt;
+  while ((opt = getopt(argc, argv, "k:r:c:")) != -1)
+  {
+    if (opt == 'k')
+    {
+      n_keys = atoi(optarg);
+    }
+    else if (opt == 'r')
+    {
+      reps = atoi(optarg);
+    }
+    else if (opt == 'c')
+    {
+      cpu = atoi(optarg);
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+
+  if (argc == 0 || n_keys == 0 || reps == 0 || optind + MAX_SIZES < argc)
+  {
+    fprintf(stderr, "Usage: bench_lookup [-k keys] [-r reps] [-c cpu] "
+                    "[size ...]\n");
+    return EXIT_FAILURE;
+  }
+
+  unsigned int sizes[MAX_SIZES];
+  unsigned int n_sizes = 0;
+  for (int i = optind; i < argc; i++)
+  {
+    sizes[n_sizes++] = atoi(argv[i]);
+  }
+  if (n_sizes == 0)
+  {
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+    n_sizes = N_DEFAULT_SIZES;
+  }
+
+  // Pin the benchmark to a single CPU
+  cpu = (cpu < 0) ? sched_getcpu() : cpu;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (cpu < 0 || sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+  {
+    fprintf(stderr, "Warning: could not pin to CPU %d\n", cpu);
+  }
+
+  uint32_t *keys = malloc(sizeof(uint32_t) * n_keys);
+  uint32_t *original = malloc(sizeof(uint32_t) * n_keys);
+  uint32_t *minimised = malloc(sizeof(uint32_t) * n_keys);
+  if (keys == NULL || original == NULL || minimised == NULL)
+  {
+    fprintf(stderr, "Could not allocate a trace of %u keys\n", n_keys);
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  for (unsigned int s = 0; s < n_sizes; s++)
+  {
+    table_t table;
+    if (!generator_table(&table, sizes[s], BENCH_SEED))
+    {
+      fprintf(stderr, "Could not generate a table of %u entries\n",
+              sizes[s]);
+      FREE(table.entries);
+      return EXIT_FAILURE;
+    }
+    table_t m_table = {table.size, malloc(sizeof(entry_t) * table.size)};
+    memcpy(m_table.entries, table.entries, sizeof(entry_t) * table.size);
+    mtrie_minimise(&m_table);
+
+    make_trace(&table, keys, n_keys);
+    bench(stdout, "original", &table, keys, original, n_keys, reps);
+    bench(stdout, "mtrie", &m_table, keys, minimised, n_keys, reps);
+
+    // Compare the routes of every key the original table routes
+    unsigned int mismatches = 0;
+    for (unsigned int i = 0; i < n_keys; i++)
+    {
+      mismatches += original[i] != LOOKUP_MISS &&
+                    (minimised[i] == LOOKUP_MISS ||
+                     table.entries[original[i]].route !=
+                     m_table.entries[minimised[i]].route);
+    }
+    if (mismatches > 0)
+    {
+      fprintf(stderr, "MISMATCH: %u of %u keys routed differently with %u "
+                      "entries\n", mismatches, n_keys, table.size);
+      ok = false;
+    }
+
+    free(m_table.entries);
+    FREE(table.entries);
+  }
+
+  free(keys);
+  free(original);
+  free(minimised);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
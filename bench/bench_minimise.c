@@ -0,0 +1,406 @@
+/* Benchmarks of the minimisers over generated tables of different sizes.
+ *
+ * Each minimiser is run over a table of each size (see `generator_table`),
+ * first a number of times to warm up and then repeatedly to measure it, on a
+ * single pinned CPU. A line of JSON is written for each minimiser and size
+ * giving the compression achieved, percentiles of the time taken, the
+ * throughput and the peak heap use (measured by the PROFILED allocator).
+ *
+ * Given the output of an earlier run as a baseline, results are compared
+ * against it and any which are worse by more than a threshold are reported
+ * as regressions (and the exit status is non-zero).
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "profile.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "mtrie.h"
+#include "remove_default_routes.h"
+#include "table_generator.h"
+
+
+// Default sizes of table
+static const unsigned int default_sizes[] = {100, 1000, 10000, 100000};
+#define N_DEFAULT_SIZES (sizeof(default_sizes) / sizeof(default_sizes[0]))
+
+// Most sizes which may be given
+#define MAX_SIZES 32
+
+// Seed of the generated tables
+#define BENCH_SEED 1
+
+
+typedef struct _options_t
+{
+  unsigned int warmup;  // Runs before measurement begins
+  unsigned int reps;    // Most runs measured
+  double seconds;       // Time after which no more runs are started
+} options_t;
+
+
+typedef struct _result_t
+{
+  const char *algorithm;
+  unsigned int entries, minimised;  // Size of the table before and after
+  unsigned int reps;                // Number of runs measured
+  uint64_t min_ns, p50_ns, p90_ns, p99_ns, max_ns;
+  size_t peak_bytes;                // Largest heap use of a run
+  bool failed;                      // Whether a run could not minimise
+} result_t;
+
+
+static bool run_oc(table_t *table)
+{
+  if (!table_sort_by_generality(table))
+  {
+    return false;
+  }
+
+  aliases_t aliases = aliases_init();
+  oc_minimise(table, 0, &aliases);
+  aliases_clear(&aliases);
+  return true;
+}
+
+
+static bool run_mtrie(table_t *table)
+{
+  mtrie_minimise(table);
+  return true;
+}
+
+
+static bool run_rdr(table_t *table)
+{
+  remove_default_routes_minimise(table);
+  return true;
+}
+
+
+typedef struct _algorithm_t
+{
+  const char *name;
+  bool (*run)(table_t *table);    // False if the table was not minimised
+  unsigned int max_default_size;  // Largest default size to run on
+} algorithm_t;
+
+
+// Ordered Covering would take hours on the largest default table
+static const algorithm_t algorithms[] = {
+  {"oc", run_oc, 10000},
+  {"mtrie", run_mtrie, UINT32_MAX},
+  {"rdr", run_rdr, UINT32_MAX},
+};
+#define N_ALGORITHMS (sizeof(algorithms) / sizeof(algorithms[0]))
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+
+static int compare_ns(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+
+// Get a percentile of sorted samples (nearest rank)
+static uint64_t percentile(uint64_t *samples, unsigned int n, unsigned int p)
+{
+  unsigned int rank = (p * n + 99) / 100;
+  return samples[rank ? rank - 1 : 0];
+}
+
+
+// Minimise a copy of a table, returns the time taken
+static uint64_t run_once(const algorithm_t *a, table_t *corpus,
+                         table_t *table, result_t *r)
+{
+  table->size = corpus->size;
+  memcpy(table->entries, corpus->entries, sizeof(entry_t) * corpus->size);
+  size_t live = profile_get()->live_bytes;
+  profile_reset_peak();
+
+  uint64_t t = now_ns();
+  r->failed = !a->run(table) || r->failed;
+  t = now_ns() - t;
+
+  size_t peak = profile_get()->peak_bytes - live;
+  r->peak_bytes = (peak > r->peak_bytes) ? peak : r->peak_bytes;
+  r->minimised = table->size;
+  return t;
+}
+
+
+// Minimise copies of a table repeatedly
+static result_t bench(const algorithm_t *a, table_t *corpus, options_t *o)
+{
+  result_t r = {a->name, corpus->size, 0, 0, 0, 0, 0, 0, 0, 0, false};
+  table_t table = {0, malloc(sizeof(entry_t) * corpus->size)};
+  uint64_t *samples = malloc(sizeof(uint64_t) * o->reps);
+  uint64_t budget = o->seconds * 1e9;
+
+  // Warm up, and then measure, until out of time (but always measure one
+  // run).
+  uint64_t start = now_ns();
+  for (unsigned int i = 0;
+       i < o->warmup && !r.failed && now_ns() - start <= budget; i++)
+  {
+    run_once(a, corpus, &table, &r);
+  }
+
+  start = now_ns();
+  while (r.reps < o->reps && !r.failed &&
+         (r.reps == 0 || now_ns() - start <= budget))
+  {
+    samples[r.reps++] = run_once(a, corpus, &table, &r);
+  }
+
+  if (r.reps > 0)
+  {
+    qsort(samples, r.reps, sizeof(uint64_t), compare_ns);
+    r.min_ns = samples[0];
+    r.p50_ns = percentile(samples, r.reps, 50);
+    r.p90_ns = percentile(samples, r.reps, 90);
+    r.p99_ns = percentile(samples, r.reps, 99);
+    r.max_ns = samples[r.reps - 1];
+  }
+
+  free(samples);
+  free(table.entries);
+  return r;
+}
+
+
+static void write_result(FILE *f, result_t *r)
+{
+  fprintf(f, "{\"algorithm\": \"%s\", \"entries\": %u, \"minimised\": %u, "
+             "\"ratio\": %.3f, \"reps\": %u, \"min_ns\": %llu, "
+             "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, "
+             "\"max_ns\": %llu, \"entries_per_s\": %.0f, "
+             "\"peak_bytes\": %zu}\n",
+          r->algorithm, r->entries, r->minimised,
+          r->minimised ? (double) r->entries / r->minimised : 0.0, r->reps,
+          (unsigned long long) r->min_ns, (unsigned long long) r->p50_ns,
+          (unsigned long long) r->p90_ns, (unsigned long long) r->p99_ns,
+          (unsigned long long) r->max_ns,
+          r->p50_ns ? r->entries * 1e9 / r->p50_ns : 0.0, r->peak_bytes);
+  fflush(f);
+}
+
+
+// Get the value of a field from a line written by `write_result`
+static bool read_field(const char *line, const char *name, uint64_t *value)
+{
+  char key[64];
+  snprintf(key, sizeof(key), "\"%s\": ", name);
+  const char *p = strstr(line, key);
+  if (p == NULL)
+  {
+    return false;
+  }
+  *value = strtoull(p + strlen(key), NULL, 10);
+  return true;
+}
+
+
+// Compare a value against the baseline, returns true if it has regressed
+static bool regressed(result_t *r, const char *what, uint64_t value,
+                      uint64_t baseline, double threshold)
+{
+  if (value <= baseline * (1.0 + threshold / 100.0))
+  {
+    return false;
+  }
+
+  fprintf(stderr, "REGRESSION: %s with %u entries, %s %llu vs %llu "
+                  "(%+.1f%%)\n",
+          r->algorithm, r->entries, what, (unsigned long long) value,
+          (unsigned long long) baseline,
+          baseline ? 100.0 * ((double) value / baseline - 1.0) : 100.0);
+  return true;
+}
+
+
+// Compare a result against the matching line of a baseline file, returns
+// true if it has regressed.
+static bool compare(FILE *baseline, result_t *r, double threshold)
+{
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "{\"algorithm\": \"%s\", ",
+           r->algorithm);
+
+  char line[1024];
+  rewind(baseline);
+  while (fgets(line, sizeof(line), baseline) != NULL)
+  {
+    uint64_t entries, minimised, p50_ns, peak_bytes;
+    if (strncmp(line, pattern, strlen(pattern)) != 0 ||
+        !read_field(line, "entries", &entries) || entries != r->entries ||
+        !read_field(line, "minimised", &minimised) ||
+        !read_field(line, "p50_ns", &p50_ns) ||
+        !read_field(line, "peak_bytes", &peak_bytes))
+    {
+      continue;
+    }
+
+    // Report every regression, not just the first
+    bool worse = regressed(r, "p50_ns", r->p50_ns, p50_ns, threshold);
+    worse |= regressed(r, "peak_bytes", r->peak_bytes, peak_bytes, threshold);
+    worse |= regressed(r, "minimised", r->minimised, minimised, threshold);
+    return worse;
+  }
+
+  fprintf(stderr, "No baseline for %s with %u entries\n", r->algorithm,
+          r->entries);
+  return false;
+}
+
+
+int main(int argc, char *argv[])
+{
+  // Usage:
+  // bench_minimise [-w warmup] [-r reps] [-t seconds] [-c cpu]
+  //                [-a algorithm] [-b baseline [-x threshold_percent]]
+  //                [size ...]
+  options_t options = {1, 10, 10.0};
+  int cpu = -1;  // The CPU the benchmark starts on
+  const char *algorithm = NULL;
+  const char *baseline_file = NULL;
+  double threshold = 10.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:r:t:c:a:b:x:")) != -1)
+  {
+    if (opt == 'w')
+    {
+      options.warmup = atoi(optarg);
+    }
+    else if (opt == 'r')
+    {
+      options.reps = atoi(optarg);
+    }
+    else if (opt == 't')
+    {
+      options.seconds = atof(optarg);
+    }
+    else if (opt == 'c')
+    {
+      cpu = atoi(optarg);
+    }
+    else if (opt == 'a')
+    {
+      algorithm = optarg;
+    }
+    else if (opt == 'b')
+    {
+      baseline_file = optarg;
+    }
+    else if (opt == 'x')
+    {
+      threshold = atof(optarg);
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+
+  if (argc == 0 || options.reps == 0 || optind + MAX_SIZES < argc)
+  {
+    fprintf(stderr, "Usage: bench_minimise [-w warmup] [-r reps] "
+                    "[-t seconds] [-c cpu] [-a oc|mtrie|rdr] "
+                    "[-b baseline [-x threshold_percent]] [size ...]\n");
+    return EXIT_FAILURE;
+  }
+
+  unsigned int sizes[MAX_SIZES];
+  unsigned int n_sizes = 0;
+  bool default_sizes_used = optind == argc;
+  for (int i = optind; i < argc; i++)
+  {
+    sizes[n_sizes++] = atoi(argv[i]);
+  }
+  if (n_sizes == 0)
+  {
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+    n_sizes = N_DEFAULT_SIZES;
+  }
+
+  FILE *baseline = NULL;
+  if (baseline_file != NULL && (baseline = fopen(baseline_file, "r")) == NULL)
+  {
+    fprintf(stderr, "Could not open baseline %s\n", baseline_file);
+    return EXIT_FAILURE;
+  }
+
+  // Pin the benchmark to a single CPU
+  cpu = (cpu < 0) ? sched_getcpu() : cpu;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (cpu < 0 || sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+  {
+    fprintf(stderr, "Warning: could not pin to CPU %d\n", cpu);
+  }
+
+  profile_init();
+  bool ok = true;
+  for (unsigned int s = 0; s < n_sizes; s++)
+  {
+    table_t corpus;
+    if (!generator_table(&corpus, sizes[s], BENCH_SEED))
+    {
+      fprintf(stderr, "Could not generate a table of %u entries\n",
+              sizes[s]);
+      FREE(corpus.entries);
+      return EXIT_FAILURE;
+    }
+
+    for (unsigned int i = 0; i < N_ALGORITHMS; i++)
+    {
+      if ((algorithm != NULL &&
+           strcmp(algorithm, algorithms[i].name) != 0) ||
+          (default_sizes_used && sizes[s] > algorithms[i].max_default_size))
+      {
+        continue;
+      }
+
+      result_t r = bench(&algorithms[i], &corpus, &options);
+      if (r.failed)
+      {
+        fprintf(stderr, "Could not minimise a table of %u entries with %s\n",
+                sizes[s], algorithms[i].name);
+        FREE(corpus.entries);
+        return EXIT_FAILURE;
+      }
+      write_result(stdout, &r);
+      if (baseline != NULL && compare(baseline, &r, threshold))
+      {
+        ok = false;
+      }
+    }
+
+    FREE(corpus.entries);
+  }
+
+  if (baseline != NULL)
+  {
+    fclose(baseline);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,153 @@
+/* Groups of hardware performance counters (Linux only).
+ *
+ * A group counts CPU cycles, instructions, cache misses and branch
+ * mispredictions for the calling thread (in user space only). If the
+ * counters cannot be opened, e.g., because of `perf_event_paranoid` or
+ * because the kernel or a virtual machine does not provide them, the group is
+ * marked as unavailable and every read returns zeros.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifndef __PERF_H__
+
+typedef enum _perf_counter_t
+{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_N_COUNTERS
+} perf_counter_t;
+
+
+typedef struct _perf_group_t
+{
+  int fds[PERF_N_COUNTERS];  // File descriptors, the first leads the group
+  bool available;            // Whether the counters could be opened
+} perf_group_t;
+
+
+// Values of the counters in a group
+typedef struct _perf_values_t
+{
+  uint64_t counts[PERF_N_COUNTERS];
+} perf_values_t;
+
+
+// Get the name of a counter
+static inline const char* perf_counter_name(perf_counter_t c)
+{
+  static const char *names[PERF_N_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+  };
+  return names[c];
+}
+
+
+// Open a group of counters for the calling thread, returns false if the
+// counters are unavailable (the group may still be used).
+static inline bool perf_group_open(perf_group_t *g)
+{
+  static const uint64_t configs[PERF_N_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  g->available = true;
+  for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+  {
+    g->fds[c] = -1;
+  }
+
+  for (unsigned int c = 0; c < PERF_N_COUNTERS && g->available; c++)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[c];
+    attr.disabled = (c == 0);  // The group is enabled through its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    g->fds[c] = syscall(__NR_perf_event_open, &attr, 0, -1,
+                        (c == 0) ? -1 : g->fds[0], 0);
+    g->available = g->fds[c] >= 0;
+  }
+
+  if (g->available)
+  {
+    ioctl(g->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  else
+  {
+    for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+    {
+      if (g->fds[c] >= 0)
+      {
+        close(g->fds[c]);
+      }
+      g->fds[c] = -1;
+    }
+  }
+
+  return g->available;
+}
+
+
+static inline void perf_group_close(perf_group_t *g)
+{
+  for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+  {
+    if (g->fds[c] >= 0)
+    {
+      close(g->fds[c]);
+    }
+  }
+  g->available = false;
+}
+
+
+// Read the current values of the counters in a group
+static inline perf_values_t perf_group_read(perf_group_t *g)
+{
+  perf_values_t v;
+  memset(&v, 0, sizeof(v));
+
+  if (g->available)
+  {
+    // With PERF_FORMAT_GROUP the number of counters precedes their values
+    uint64_t data[1 + PERF_N_COUNTERS];
+    if (read(g->fds[0], data, sizeof(data)) == sizeof(data))
+    {
+      memcpy(v.counts, &data[1], sizeof(v.counts));
+    }
+  }
+
+  return v;
+}
+
+
+// Add the difference between two readings to a total
+static inline void perf_values_accumulate(perf_values_t *total,
+                                          perf_values_t *start,
+                                          perf_values_t *end)
+{
+  for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+  {
+    total->counts[c] += end->counts[c] - start->counts[c];
+  }
+}
+
+#define __PERF_H__
+#endif  // __PERF_H__
@@ -0,0 +1,223 @@
+/* Hardware performance counters of Ordered Covering.
+ *
+ * Minimises every table in a file and reports the cycles, instructions,
+ * cache misses and branch mispredictions of each table and of each phase of
+ * Ordered Covering (see oc_stats.h) across all tables. Output is
+ * tab-separated with a fixed layout so that reports from different commits
+ * can be compared with `diff` or `paste`.
+ *
+ * Reading the counters on entering and leaving every phase costs a system
+ * call each time, so the tables are minimised twice: first with the phase
+ * hooks disabled, giving the counters of each table and the times of each
+ * phase, and then again with them enabled, giving the counters of each
+ * phase.
+ *
+ * If the counters are unavailable the report is still produced, with "n/a"
+ * in place of every counter.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "perf.h"
+#include "routing_table.h"
+#include "table_file.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "constant_columns.h"
+#include "oc_stats.h"
+
+
+// Counters of this (single-threaded) program
+static perf_group_t group;
+
+// Whether the phase hooks read the counters
+static bool hooks_enabled = false;
+
+// Counters at the entry to the current phase, and the total for each phase
+static perf_values_t phase_start;
+static perf_values_t phase_totals[OC_N_PHASES];
+static uint64_t phase_ns[OC_N_PHASES];
+static uint64_t phase_calls[OC_N_PHASES];
+
+
+void oc_phase_enter(oc_phase_t phase)
+{
+  (void) phase;
+  if (hooks_enabled)
+  {
+    phase_start = perf_group_read(&group);
+  }
+}
+
+
+void oc_phase_exit(oc_phase_t phase)
+{
+  if (!hooks_enabled)
+  {
+    return;
+  }
+
+  perf_values_t end = perf_group_read(&group);
+  perf_values_accumulate(&phase_totals[phase], &phase_start, &end);
+  phase_calls[phase]++;
+}
+
+
+// Print the counters, or "n/a" if they are unavailable
+static void print_counts(perf_values_t *v)
+{
+  for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+  {
+    if (group.available)
+    {
+      printf("\t%llu", (unsigned long long) v->counts[c]);
+    }
+    else
+    {
+      printf("\tn/a");
+    }
+  }
+
+  if (group.available && v->counts[PERF_CYCLES] > 0)
+  {
+    printf("\t%.3f", (double) v->counts[PERF_INSTRUCTIONS] /
+                     (double) v->counts[PERF_CYCLES]);
+  }
+  else
+  {
+    printf("\tn/a");
+  }
+}
+
+
+// Sort and minimise a table, returns false if there was no memory to sort it
+static bool minimise(table_t *table, unsigned int target_length)
+{
+  if (!table_sort_by_generality(table))
+  {
+    return false;
+  }
+
+  aliases_t aliases = aliases_init();
+  columns_oc_minimise(table, target_length, &aliases);
+  aliases_clear(&aliases);
+  return true;
+}
+
+
+// Print the header of a section of the report
+static void print_header(const char *first)
+{
+  printf("%s", first);
+  for (unsigned int c = 0; c < PERF_N_COUNTERS; c++)
+  {
+    printf("\t%s", perf_counter_name(c));
+  }
+  printf("\tipc\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  // Usage:
+  // perf_oc in_file [target_length]
+  if (argc < 2 || argc > 3)
+  {
+    fprintf(stderr, "Usage: %s in_file [target_length]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  unsigned int target_length = (argc == 3) ? atoi(argv[2]) : 0;
+
+  table_file_t file;
+  if (!table_file_open(&file, argv[1]))
+  {
+    fprintf(stderr, "Could not read %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  if (!perf_group_open(&group))
+  {
+    fprintf(stderr, "Hardware performance counters are unavailable, "
+                    "reporting times only\n");
+  }
+
+  // Minimise a copy of each table, without reading the counters of each
+  // phase
+  printf("# tables\n");
+  print_header("x\ty\tsize\tminimised\tns");
+  for (unsigned int i = 0; i < file.n_tables; i++)
+  {
+    chip_table_t *chip = &file.tables[i];
+    unsigned int size = chip->table.size;
+    table_t copy = {size, malloc(sizeof(entry_t) * (size ? size : 1))};
+    if (copy.entries == NULL)
+    {
+      fprintf(stderr, "Could not copy the table of (%u, %u)\n",
+              chip->x, chip->y);
+      return EXIT_FAILURE;
+    }
+    memcpy(copy.entries, chip->table.entries, sizeof(entry_t) * size);
+    table_t *table = &copy;
+    oc_stats_reset();
+
+    uint64_t start_ns = oc_stats_now();
+    perf_values_t start = perf_group_read(&group);
+
+    bool minimised = minimise(table, target_length);
+
+    perf_values_t end = perf_group_read(&group);
+    uint64_t ns = oc_stats_now() - start_ns;
+    if (!minimised)
+    {
+      fprintf(stderr, "Could not minimise the table of (%u, %u)\n",
+              chip->x, chip->y);
+      free(copy.entries);
+      return EXIT_FAILURE;
+    }
+
+    perf_values_t counts = {{0}};
+    perf_values_accumulate(&counts, &start, &end);
+    printf("%u\t%u\t%u\t%u\t%llu", chip->x, chip->y, size, table->size,
+           (unsigned long long) ns);
+    print_counts(&counts);
+    printf("\n");
+
+    for (unsigned int p = 0; p < OC_N_PHASES; p++)
+    {
+      phase_ns[p] += oc_stats.phase_ns[p];
+    }
+    free(copy.entries);
+  }
+
+  // Minimise each table again (in the copy-on-write mapping of the file),
+  // reading the counters on entering and leaving every phase
+  hooks_enabled = true;
+  for (unsigned int i = 0; i < file.n_tables; i++)
+  {
+    if (!minimise(&file.tables[i].table, target_length))
+    {
+      fprintf(stderr, "Could not minimise the table of (%u, %u)\n",
+              file.tables[i].x, file.tables[i].y);
+      return EXIT_FAILURE;
+    }
+  }
+  hooks_enabled = false;
+
+  // Summarise the phases over all the tables
+  printf("# phases\n");
+  print_header("phase\tcalls\tns");
+  for (unsigned int p = 0; p < OC_N_PHASES; p++)
+  {
+    printf("%s\t%llu\t%llu", oc_phase_name(p),
+           (unsigned long long) phase_calls[p],
+           (unsigned long long) phase_ns[p]);
+    print_counts(&phase_totals[p]);
+    printf("\n");
+  }
+
+  perf_group_close(&group);
+  table_file_close(&file);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,427 @@
+/* Batch minimisation of every table in a table file.
+ *
+ * Tables are independent so they may be pushed through a pipeline of three
+ * stages: a reader thread, a pool of minimiser threads and a writer (the
+ * calling thread). Workers take the largest table waiting to be minimised
+ * first (table sizes are very skewed between chips) while the writer writes
+ * the minimised tables out in the order they appeared in the input.
+ *
+ * Stages are linked by a bounded window of tables: the reader stalls once the
+ * window is full until the writer has written the oldest table. If the input
+ * was indexed up-front the tables are already in memory and the window holds
+ * every table.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "routing_table.h"
+#include "table_file.h"
+#include "rig_rt.h"
+
+#ifndef __BATCH_H__
+
+// Number of tables per worker which may be in the pipeline when streaming
+#define BATCH_WINDOW_PER_THREAD 4
+
+// Function used to minimise a single table, returns false if the table could
+// not be minimised.
+typedef bool (*batch_minimise_t)(table_t *table, void *arg);
+
+
+typedef struct _batch_t
+{
+  table_reader_t *in;           // Source of tables
+  batch_minimise_t minimise;    // Minimisation function
+  void *arg;                    // Argument for the minimisation function
+
+  // Tables in the pipeline, table `i` is stored in slot `i % window`
+  unsigned int window;
+  chip_table_t *slots;
+  bool *done;                   // Which slots have been minimised
+
+  // Max-heap (by size) of the tables waiting to be minimised
+  unsigned int *heap;
+  unsigned int heap_size;
+
+  unsigned int n_read;          // Number of tables read so far
+  unsigned int n_written;       // Number of tables written so far
+  bool eof;                     // Whether the reader has finished
+  bool failed;                  // Whether any table could not be minimised
+
+  pthread_mutex_t lock;
+  pthread_cond_t space;         // Signalled whenever a table is written
+  pthread_cond_t work;          // Signalled whenever a table is read
+  pthread_cond_t finished;      // Signalled whenever a table is minimised
+} batch_t;
+
+
+// Each thread which minimises tables has its own minimiser context, which is
+// freed when the thread exits.
+static pthread_key_t _batch_context_key;
+static pthread_once_t _batch_context_once = PTHREAD_ONCE_INIT;
+
+
+static inline void _batch_context_destroy(void *ctx)
+{
+  rig_rt_context_delete(ctx);
+}
+
+
+static inline void _batch_context_key_init(void)
+{
+  pthread_key_create(&_batch_context_key, _batch_context_destroy);
+}
+
+
+// Get the minimiser context of the calling thread
+static inline rig_rt_context_t* batch_context(void)
+{
+  pthread_once(&_batch_context_once, _batch_context_key_init);
+
+  rig_rt_context_t *ctx = pthread_getspecific(_batch_context_key);
+  if (ctx == NULL)
+  {
+    ctx = rig_rt_context_new();
+    pthread_setspecific(_batch_context_key, ctx);
+  }
+  return ctx;
+}
+
+
+// Table being minimised by the current thread
+static __thread chip_table_t *_batch_current = NULL;
+
+
+// Get the table being minimised by the calling thread, for use by
+// minimisation functions which report on each chip.
+static inline chip_table_t* batch_current_chip(void)
+{
+  return _batch_current;
+}
+
+
+// Report a table which could not be minimised
+static inline void _batch_print_failure(chip_table_t *chip)
+{
+  fprintf(stderr, "ERROR: (%u, %u) could not be minimised\n", chip->x,
+          chip->y);
+}
+
+
+// Print the progress line for a table
+static inline void _batch_print(FILE *log, chip_table_t *chip)
+{
+  fprintf(log, "(%3u, %3u)\t%4u\t%u\n", chip->x, chip->y, chip->table.size,
+          chip->minimised.size);
+}
+
+
+// Determine whether one table should be minimised before another, larger
+// tables go first and then earlier tables.
+static inline bool _batch_before(batch_t *b, unsigned int i, unsigned int j)
+{
+  unsigned int size_i = b->slots[i % b->window].table.size;
+  unsigned int size_j = b->slots[j % b->window].table.size;
+  return (size_i != size_j) ? (size_i > size_j) : (i < j);
+}
+
+
+// Add a table to the heap of tables waiting to be minimised
+static inline void _batch_push(batch_t *b, unsigned int i)
+{
+  // Sift the new table up
+  unsigned int n = b->heap_size++;
+  while (n > 0 && _batch_before(b, i, b->heap[(n - 1) / 2]))
+  {
+    b->heap[n] = b->heap[(n - 1) / 2];
+    n = (n - 1) / 2;
+  }
+  b->heap[n] = i;
+}
+
+
+// Remove the next table to minimise from the heap
+static inline unsigned int _batch_pop(batch_t *b)
+{
+  unsigned int top = b->heap[0];
+  unsigned int last = b->heap[--b->heap_size];
+
+  // Sift the last table down from the root
+  unsigned int n = 0;
+  while (2*n + 1 < b->heap_size)
+  {
+    unsigned int child = 2*n + 1;
+    if (child + 1 < b->heap_size &&
+        _batch_before(b, b->heap[child + 1], b->heap[child]))
+    {
+      child++;
+    }
+
+    if (!_batch_before(b, b->heap[child], last))
+    {
+      break;
+    }
+    b->heap[n] = b->heap[child];
+    n = child;
+  }
+  b->heap[n] = last;
+
+  return top;
+}
+
+
+// Reader thread, reads tables while there is space in the window
+static inline void* _batch_reader(void *arg)
+{
+  batch_t *b = arg;
+
+  while (true)
+  {
+    // Wait until there is space in the window
+    pthread_mutex_lock(&b->lock);
+    while (b->n_read - b->n_written == b->window)
+    {
+      pthread_cond_wait(&b->space, &b->lock);
+    }
+    unsigned int i = b->n_read;
+    pthread_mutex_unlock(&b->lock);
+
+    // Read the table without holding the lock, the slot is not visible to
+    // any other thread until `n_read` is incremented.
+    chip_table_t chip;
+    bool more = table_reader_next(b->in, &chip);
+
+    pthread_mutex_lock(&b->lock);
+    if (more)
+    {
+      b->slots[i % b->window] = chip;
+      b->done[i % b->window] = false;
+      b->n_read++;
+      _batch_push(b, i);
+    }
+    else
+    {
+      b->eof = true;
+    }
+    pthread_cond_broadcast(&b->work);
+    pthread_cond_broadcast(&b->finished);
+    pthread_mutex_unlock(&b->lock);
+
+    if (!more)
+    {
+      return NULL;
+    }
+  }
+}
+
+
+// Worker thread, repeatedly minimises the largest waiting table
+static inline void* _batch_worker(void *arg)
+{
+  batch_t *b = arg;
+
+  while (true)
+  {
+    // Get the next table to minimise
+    pthread_mutex_lock(&b->lock);
+    while (b->heap_size == 0 && !b->eof)
+    {
+      pthread_cond_wait(&b->work, &b->lock);
+    }
+    if (b->heap_size == 0)
+    {
+      pthread_mutex_unlock(&b->lock);
+      return NULL;
+    }
+    chip_table_t *chip = &b->slots[_batch_pop(b) % b->window];
+    pthread_mutex_unlock(&b->lock);
+
+    // Minimise the table, the original is kept for the progress line
+    table_t table = chip->table;
+    _batch_current = chip;
+    bool minimised = b->minimise(&table, b->arg);
+    _batch_current = NULL;
+    if (!minimised)
+    {
+      _batch_print_failure(chip);
+    }
+
+    // Mark the table as finished
+    pthread_mutex_lock(&b->lock);
+    chip->minimised = table;
+    b->failed = b->failed || !minimised;
+    b->done[chip - b->slots] = true;
+    pthread_cond_broadcast(&b->finished);
+    pthread_mutex_unlock(&b->lock);
+  }
+}
+
+
+// Minimise every table from `in` in turn on the calling thread, see
+// `batch_minimise`.
+static inline bool _batch_minimise_serial(table_reader_t *in,
+                                          table_writer_t *out, FILE *log,
+                                          batch_minimise_t minimise,
+                                          void *arg)
+{
+  chip_table_t chip;
+  bool ok = true, failed = false;
+  while (ok && table_reader_next(in, &chip))
+  {
+    // Print information about the current table
+    fprintf(log, "(%3u, %3u)\t%4u\t", chip.x, chip.y, chip.table.size);
+    fflush(log);
+
+    // Minimise and then write out the table
+    chip.minimised = chip.table;
+    _batch_current = &chip;
+    bool minimised = minimise(&chip.minimised, arg);
+    _batch_current = NULL;
+    fprintf(log, "%u\n", chip.minimised.size);
+    if (!minimised)
+    {
+      _batch_print_failure(&chip);
+      failed = true;
+    }
+
+    ok = table_file_write(out, chip.x, chip.y, &chip.minimised);
+    table_reader_release(in, &chip);
+  }
+
+  return ok && !failed && !in->error;
+}
+
+
+// Minimise every table from `in` using `n_threads` workers and write the
+// results, in input order, to `out`. A progress line is printed to `log` for
+// each table. Returns false if any table could not be minimised (which is
+// reported on stderr, and written out as the minimisation function left it)
+// or if the tables could not be read or written. If the pipeline cannot be
+// set up (memory or threads are not available) the tables are minimised on
+// the calling thread instead.
+static inline bool batch_minimise(table_reader_t *in, table_writer_t *out,
+                                  FILE *log,
+                                  unsigned int n_threads,
+                                  batch_minimise_t minimise, void *arg)
+{
+  if (n_threads <= 1)
+  {
+    return _batch_minimise_serial(in, out, log, minimise, arg);
+  }
+
+  batch_t b;
+  b.in = in;
+  b.minimise = minimise;
+  b.arg = arg;
+  b.n_read = b.n_written = 0;
+  b.heap_size = 0;
+  b.eof = b.failed = false;
+
+  // Tables which have been indexed up-front are already in memory so the
+  // window may as well hold all of them.
+  b.window = table_reader_count(in);
+  if (b.window == 0)
+  {
+    b.window = BATCH_WINDOW_PER_THREAD * n_threads;
+  }
+  b.slots = malloc(sizeof(chip_table_t) * b.window);
+  b.done = malloc(sizeof(bool) * b.window);
+  b.heap = malloc(sizeof(unsigned int) * b.window);
+  pthread_t *workers = malloc(sizeof(pthread_t) * n_threads);
+  if (b.slots == NULL || b.done == NULL || b.heap == NULL || workers == NULL)
+  {
+    free(b.slots);
+    free(b.done);
+    free(b.heap);
+    free(workers);
+    fprintf(stderr, "Warning: out of memory, minimising on one thread\n");
+    return _batch_minimise_serial(in, out, log, minimise, arg);
+  }
+
+  pthread_mutex_init(&b.lock, NULL);
+  pthread_cond_init(&b.space, NULL);
+  pthread_cond_init(&b.work, NULL);
+  pthread_cond_init(&b.finished, NULL);
+
+  // Start as many workers as possible and then the reader. Nothing is read
+  // until the reader starts, so if it cannot be (or no worker could be) the
+  // workers are stopped and the tables are minimised on this thread.
+  unsigned int n_workers = 0;
+  while (n_workers < n_threads &&
+         pthread_create(&workers[n_workers], NULL, _batch_worker, &b) == 0)
+  {
+    n_workers++;
+  }
+
+  pthread_t reader;
+  bool started = n_workers > 0 &&
+                 pthread_create(&reader, NULL, _batch_reader, &b) == 0;
+  if (!started)
+  {
+    pthread_mutex_lock(&b.lock);
+    b.eof = true;
+    pthread_cond_broadcast(&b.work);
+    pthread_mutex_unlock(&b.lock);
+  }
+
+  // Write out the tables in input order as they are finished
+  bool ok = true;
+  while (started)
+  {
+    pthread_mutex_lock(&b.lock);
+    unsigned int slot = b.n_written % b.window;
+    while (b.n_written < b.n_read ? !b.done[slot] : !b.eof)
+    {
+      pthread_cond_wait(&b.finished, &b.lock);
+    }
+    bool more = b.n_written < b.n_read;
+    pthread_mutex_unlock(&b.lock);
+
+    if (!more)
+    {
+      break;
+    }
+
+    _batch_print(log, &b.slots[slot]);
+    ok = ok && table_file_write(out, b.slots[slot].x, b.slots[slot].y,
+                                &b.slots[slot].minimised);
+    table_reader_release(in, &b.slots[slot]);
+
+    // Free the slot for the reader
+    pthread_mutex_lock(&b.lock);
+    b.n_written++;
+    pthread_cond_signal(&b.space);
+    pthread_mutex_unlock(&b.lock);
+  }
+
+  // Tidy up
+  if (started)
+  {
+    pthread_join(reader, NULL);
+  }
+  for (unsigned int t = 0; t < n_workers; t++)
+  {
+    pthread_join(workers[t], NULL);
+  }
+  free(workers);
+
+  pthread_cond_destroy(&b.finished);
+  pthread_cond_destroy(&b.work);
+  pthread_cond_destroy(&b.space);
+  pthread_mutex_destroy(&b.lock);
+  free(b.slots);
+  free(b.done);
+  free(b.heap);
+
+  if (!started)
+  {
+    fprintf(stderr, "Warning: could not start threads, minimising on one "
+                    "thread\n");
+    return _batch_minimise_serial(in, out, log, minimise, arg);
+  }
+  return ok && !b.failed && !in->error;
+}
+
+#define __BATCH_H__
+#endif  // __BATCH_H__
@@ -0,0 +1,215 @@
+/* Persistent cache of minimised routing tables.
+ *
+ * Minimised tables are stored in a directory, one file per table, named by a
+ * 128-bit hash of the input table together with the name of the algorithm
+ * and its target length. Files are written under a temporary name and then
+ * renamed into place so that concurrent processes sharing a cache only ever
+ * see complete entries.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "batch.h"
+
+#ifndef __CACHE_H__
+
+// Magic number at the start of cache files, "RTBC"
+#define CACHE_MAGIC 0x43425452
+
+typedef struct _cache_t
+{
+  const char *dir;              // Directory containing the cache
+  const char *algorithm;        // Name of the minimisation algorithm
+  unsigned int target_length;   // Target length passed to the algorithm
+
+  batch_minimise_t minimise;    // Minimisation function used on a miss
+  void *arg;                    // Argument for the minimisation function
+
+  unsigned int hits, misses;    // Number of lookups which hit and missed
+  unsigned int n_stored;        // Number of tables written to the cache
+  pthread_mutex_t lock;
+} cache_t;
+
+
+// Header of a cache file, followed by `size` entries
+typedef struct _cache_header_t
+{
+  uint32_t magic, size;
+} cache_header_t;
+
+
+// Open a cache in a directory (which is created if necessary)
+static inline bool cache_init(cache_t *c, const char *dir,
+                              const char *algorithm,
+                              unsigned int target_length,
+                              batch_minimise_t minimise, void *arg)
+{
+  c->dir = dir;
+  c->algorithm = algorithm;
+  c->target_length = target_length;
+  c->minimise = minimise;
+  c->arg = arg;
+  c->hits = c->misses = c->n_stored = 0;
+  pthread_mutex_init(&c->lock, NULL);
+
+  return mkdir(dir, 0777) == 0 || errno == EEXIST;
+}
+
+
+static inline void cache_delete(cache_t *c)
+{
+  pthread_mutex_destroy(&c->lock);
+}
+
+
+// Extend a pair of FNV-1a style hashes with a block of data, the two hashes
+// use different offset bases and multipliers to give a 128-bit hash.
+static inline void _cache_hash(uint64_t hash[2], const void *data, size_t n)
+{
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < n; i++)
+  {
+    hash[0] = (hash[0] ^ bytes[i]) * 0x100000001b3ull;
+    hash[1] = (hash[1] ^ bytes[i]) * 0x9e3779b97f4a7c15ull;
+  }
+}
+
+
+// Get the path of the cache file for a table
+static inline void _cache_path(cache_t *c, table_t *table, char *path,
+                               size_t n)
+{
+  uint64_t hash[2] = {0xcbf29ce484222325ull, 0x84222325cbf29ce4ull};
+  _cache_hash(hash, c->algorithm, strlen(c->algorithm) + 1);
+  _cache_hash(hash, &c->target_length, sizeof(c->target_length));
+  _cache_hash(hash, &table->size, sizeof(table->size));
+  _cache_hash(hash, table->entries, sizeof(entry_t) * table->size);
+
+  snprintf(path, n, "%s/%016llx%016llx", c->dir,
+           (unsigned long long) hash[0], (unsigned long long) hash[1]);
+}
+
+
+// Read a minimised table from the cache into the table, returns false if
+// there is no entry for the table (or it could not be read, e.g., for lack of
+// memory, in which case the table is minimised as if there were no entry).
+static inline bool _cache_read(const char *path, table_t *table)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    return false;
+  }
+
+  // Minimised tables are never longer than the original so are copied over
+  // it, but only once they have been read completely.
+  cache_header_t h;
+  bool ok = fread(&h, sizeof(cache_header_t), 1, f) == 1 &&
+            h.magic == CACHE_MAGIC && h.size <= table->size;
+
+  entry_t *entries = NULL;
+  if (ok)
+  {
+    entries = malloc(sizeof(entry_t) * (h.size ? h.size : 1));
+    ok = entries != NULL &&
+         fread(entries, sizeof(entry_t), h.size, f) == h.size;
+  }
+  fclose(f);
+
+  if (ok)
+  {
+    memcpy(table->entries, entries, sizeof(entry_t) * h.size);
+    table->size = h.size;
+  }
+  free(entries);
+  return ok;
+}
+
+
+// Write a minimised table into the cache
+static inline bool _cache_write(cache_t *c, const char *path, table_t *table)
+{
+  // Write to a temporary file which is unique to this write
+  pthread_mutex_lock(&c->lock);
+  unsigned int n = c->n_stored++;
+  pthread_mutex_unlock(&c->lock);
+
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.%u.tmp", path,
+           (long) getpid(), n);
+
+  FILE *f = fopen(tmp_path, "wb");
+  if (f == NULL)
+  {
+    return false;
+  }
+
+  cache_header_t h = {CACHE_MAGIC, table->size};
+  bool ok = fwrite(&h, sizeof(cache_header_t), 1, f) == 1 &&
+            fwrite(table->entries, sizeof(entry_t), table->size,
+                   f) == table->size;
+  ok = (fclose(f) == 0) && ok;
+
+  // Move the complete file into place
+  if (!ok || rename(tmp_path, path) != 0)
+  {
+    remove(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+
+// Minimise a table, using the cache if possible. Matches `batch_minimise_t`
+// with `arg` pointing to the cache.
+static inline bool cache_minimise(table_t *table, void *arg)
+{
+  cache_t *c = arg;
+
+  char path[4096];
+  _cache_path(c, table, path, sizeof(path));
+
+  bool hit = _cache_read(path, table);
+  pthread_mutex_lock(&c->lock);
+  if (hit)
+  {
+    c->hits++;
+  }
+  else
+  {
+    c->misses++;
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  if (!hit)
+  {
+    // Tables which could not be minimised are not stored
+    if (!c->minimise(table, c->arg))
+    {
+      return false;
+    }
+
+    // Failing to store the table only makes later runs slower
+    _cache_write(c, path, table);
+  }
+  return true;
+}
+
+
+// Print a summary of the use of the cache
+static inline void cache_report(cache_t *c, FILE *log)
+{
+  unsigned int n = c->hits + c->misses;
+  fprintf(log, "Cache: %u hits, %u misses (%.1f%% hit rate)\n",
+          c->hits, c->misses, n ? (100.0 * c->hits) / n : 0.0);
+}
+
+#define __CACHE_H__
+#endif  // __CACHE_H__
@@ -0,0 +1,211 @@
+/* Checkpointing of Ordered Covering.
+ *
+ * While a table is being minimised a snapshot of its progress (see
+ * snapshot.h) is written to a directory every few seconds. Snapshot files are
+ * named by a hash of the input table and the target length, so if the
+ * minimiser is stopped and rerun on the same input each table picks up from
+ * its last snapshot. The snapshot of a table is removed once it has been
+ * minimised.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "aliases.h"
+#include "snapshot.h"
+#include "constant_columns.h"
+#include "cache.h"
+
+#ifndef __CHECKPOINT_H__
+
+typedef struct _checkpoint_t
+{
+  const char *dir;             // Directory containing the snapshots
+  double interval;             // Seconds between snapshots of a table
+  unsigned int target_length;  // Target length passed to Ordered Covering
+
+  unsigned int n_resumed;      // Number of tables resumed from a snapshot
+  unsigned int n_written;      // Number of snapshots written
+  pthread_mutex_t lock;
+} checkpoint_t;
+
+
+// State of the checkpointing of a single table
+typedef struct _checkpoint_state_t
+{
+  checkpoint_t *c;
+  const char *path;      // Path of the snapshot
+  struct timespec last;  // Time at which the last snapshot was taken
+  uint32_t *buffer;      // Space in which to build snapshots
+  unsigned int capacity;
+} _checkpoint_state_t;
+
+
+// Open a checkpoint directory (which is created if necessary)
+static inline bool checkpoint_init(checkpoint_t *c, const char *dir,
+                                   double interval,
+                                   unsigned int target_length)
+{
+  c->dir = dir;
+  c->interval = interval;
+  c->target_length = target_length;
+  c->n_resumed = c->n_written = 0;
+  pthread_mutex_init(&c->lock, NULL);
+
+  return mkdir(dir, 0777) == 0 || errno == EEXIST;
+}
+
+
+static inline void checkpoint_delete(checkpoint_t *c)
+{
+  pthread_mutex_destroy(&c->lock);
+}
+
+
+static inline double _checkpoint_elapsed(struct timespec *since)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) + 1e-9 * (now.tv_nsec - since->tv_nsec);
+}
+
+
+// Read a snapshot into newly allocated memory, returns NULL if there is none
+static inline uint32_t* _checkpoint_read(const char *path,
+                                         unsigned int *n_words)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    return NULL;
+  }
+
+  uint32_t *data = NULL;
+  if (fseek(f, 0, SEEK_END) == 0)
+  {
+    long n_bytes = ftell(f);
+    if (n_bytes > 0 && n_bytes % sizeof(uint32_t) == 0 &&
+        fseek(f, 0, SEEK_SET) == 0)
+    {
+      // A snapshot which cannot be allocated is treated as if there were
+      // none, so the table is minimised from the start.
+      *n_words = n_bytes / sizeof(uint32_t);
+      data = malloc(n_bytes);
+      if (data != NULL &&
+          fread(data, sizeof(uint32_t), *n_words, f) != *n_words)
+      {
+        free(data);
+        data = NULL;
+      }
+    }
+  }
+
+  fclose(f);
+  return data;
+}
+
+
+// Write a snapshot of a table if enough time has passed since the last one,
+// matches `oc_checkpoint_t`.
+static inline void _checkpoint_write(table_t *table, aliases_t *aliases,
+                                     void *arg)
+{
+  _checkpoint_state_t *s = arg;
+  if (_checkpoint_elapsed(&s->last) < s->c->interval)
+  {
+    return;
+  }
+
+  // Build the snapshot in memory
+  unsigned int n_words = snapshot_size(table, aliases);
+  if (n_words > s->capacity)
+  {
+    free(s->buffer);
+    s->capacity = 2 * n_words;
+    s->buffer = malloc(sizeof(uint32_t) * s->capacity);
+    if (s->buffer == NULL)
+    {
+      // Skip this snapshot, and try again after another interval
+      s->capacity = 0;
+      clock_gettime(CLOCK_MONOTONIC, &s->last);
+      return;
+    }
+  }
+  snapshot_write(s->buffer, table, aliases);
+
+  // Write it to a temporary file which is unique to this write and then move
+  // the complete file into place.
+  pthread_mutex_lock(&s->c->lock);
+  unsigned int n = s->c->n_written++;
+  pthread_mutex_unlock(&s->c->lock);
+
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.%u.tmp", s->path,
+           (long) getpid(), n);
+
+  FILE *f = fopen(tmp_path, "wb");
+  if (f != NULL)
+  {
+    bool ok = fwrite(s->buffer, sizeof(uint32_t), n_words, f) == n_words;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp_path, s->path) != 0)
+    {
+      remove(tmp_path);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &s->last);
+}
+
+
+// Minimise a sorted table with Ordered Covering, resuming from and writing
+// snapshots to the checkpoint directory.
+static inline void checkpoint_minimise(table_t *table, checkpoint_t *c)
+{
+  // Name the snapshot after the table
+  uint64_t hash[2] = {0xcbf29ce484222325ull, 0x84222325cbf29ce4ull};
+  _cache_hash(hash, &c->target_length, sizeof(c->target_length));
+  _cache_hash(hash, &table->size, sizeof(table->size));
+  _cache_hash(hash, table->entries, sizeof(entry_t) * table->size);
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%016llx%016llx.snapshot", c->dir,
+           (unsigned long long) hash[0], (unsigned long long) hash[1]);
+
+  _checkpoint_state_t state = {c, path, {0, 0}, NULL, 0};
+  clock_gettime(CLOCK_MONOTONIC, &state.last);
+
+  // Resume from the last snapshot, if there is one
+  unsigned int n_words = 0;
+  uint32_t *snapshot = _checkpoint_read(path, &n_words);
+
+  aliases_t aliases = aliases_init();
+  bool resumed = columns_oc_minimise_checkpointed(
+    table, c->target_length, &aliases, _checkpoint_write, &state,
+    snapshot, n_words
+  );
+  aliases_clear(&aliases);
+
+  if (resumed)
+  {
+    pthread_mutex_lock(&c->lock);
+    c->n_resumed++;
+    pthread_mutex_unlock(&c->lock);
+  }
+
+  // The table is complete so the snapshot is no longer needed
+  remove(path);
+  free(snapshot);
+  free(state.buffer);
+}
+
+#define __CHECKPOINT_H__
+#endif  // __CHECKPOINT_H__
@@ -0,0 +1,295 @@
+/* Compact encoding of routing tables.
+ *
+ * Each table is encoded as:
+ *
+ *  - The route dictionary: the number of distinct routes followed by each
+ *    route, in increasing order.
+ *  - The source dictionary, encoded in the same way.
+ *  - For each entry: the index of its route and of its source in the
+ *    dictionaries, the difference between its key and the key of the previous
+ *    entry (zig-zag encoded) and the XOR of its mask with the mask of the
+ *    previous entry.
+ *
+ * Every value is stored as a varint (7 bits per byte, least significant group
+ * first, with the top bit of each byte set if more bytes follow). Entries
+ * keep their order, the keys of neighbouring entries are usually close and
+ * masks are usually the same so most entries take around 4 bytes rather than
+ * 16.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "routing_table.h"
+
+#ifndef __COMPACT_H__
+
+// Growable buffer of encoded bytes
+typedef struct _compact_buffer_t
+{
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} compact_buffer_t;
+
+
+// Create a new, empty, buffer
+static inline compact_buffer_t compact_buffer_init(void)
+{
+  compact_buffer_t b = {NULL, 0, 0};
+  return b;
+}
+
+
+// Free the memory used by a buffer
+static inline void compact_buffer_delete(compact_buffer_t *b)
+{
+  free(b->data);
+  b->data = NULL;
+  b->size = b->capacity = 0;
+}
+
+
+// Ensure a buffer has space for at least `n` more bytes, returns false (and
+// leaves the buffer unchanged) if memory could not be allocated.
+static inline bool compact_buffer_reserve(compact_buffer_t *b, size_t n)
+{
+  if (b->size + n > b->capacity)
+  {
+    size_t capacity = b->capacity;
+    while (b->size + n > capacity)
+    {
+      capacity = capacity ? capacity * 2 : 256;
+    }
+
+    uint8_t *data = realloc(b->data, capacity);
+    if (data == NULL)
+    {
+      return false;
+    }
+    b->data = data;
+    b->capacity = capacity;
+  }
+  return true;
+}
+
+
+// Append a varint to a buffer, the buffer must have space for 5 bytes
+static inline void _compact_put(compact_buffer_t *b, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    b->data[b->size++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  b->data[b->size++] = value;
+}
+
+
+// Read a varint, returns false if it runs past the end of the data
+static inline bool _compact_get(const uint8_t **data, const uint8_t *end,
+                                uint32_t *value)
+{
+  *value = 0;
+  for (unsigned int shift = 0; shift < 35; shift += 7)
+  {
+    if (*data == end)
+    {
+      return false;
+    }
+
+    uint8_t byte = *((*data)++);
+    *value |= (uint32_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      return true;
+    }
+  }
+
+  return false;  // Too many bytes
+}
+
+
+// Map signed differences onto unsigned values so that small differences of
+// either sign have small encodings.
+static inline uint32_t _compact_zigzag(uint32_t diff)
+{
+  return (diff << 1) ^ -(diff >> 31);
+}
+
+
+static inline uint32_t _compact_unzigzag(uint32_t value)
+{
+  return (value >> 1) ^ -(value & 1);
+}
+
+
+static inline int _compact_cmp(const void *a, const void *b)
+{
+  uint32_t va = *((const uint32_t *) a), vb = *((const uint32_t *) b);
+  return (va > vb) - (va < vb);
+}
+
+
+// Build a sorted dictionary of the distinct values in an array, returns the
+// number of values in the dictionary.
+static inline unsigned int _compact_dictionary(uint32_t *values,
+                                               unsigned int n)
+{
+  qsort(values, n, sizeof(uint32_t), _compact_cmp);
+
+  unsigned int n_unique = 0;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    if (n_unique == 0 || values[n_unique - 1] != values[i])
+    {
+      values[n_unique++] = values[i];
+    }
+  }
+
+  return n_unique;
+}
+
+
+// Get the index of a value in a dictionary
+static inline uint32_t _compact_index(uint32_t *dict, unsigned int n,
+                                      uint32_t value)
+{
+  uint32_t *found = bsearch(&value, dict, n, sizeof(uint32_t), _compact_cmp);
+  return found - dict;
+}
+
+
+// Append the encoding of a table to a buffer, returns false if memory could
+// not be allocated.
+static inline bool compact_encode(compact_buffer_t *b, table_t *table)
+{
+  // Build the route and source dictionaries
+  uint32_t *routes = malloc(sizeof(uint32_t) * (table->size + 1));
+  uint32_t *sources = malloc(sizeof(uint32_t) * (table->size + 1));
+  if (routes == NULL || sources == NULL)
+  {
+    free(routes);
+    free(sources);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    routes[i] = table->entries[i].route;
+    sources[i] = table->entries[i].source;
+  }
+  unsigned int n_routes = _compact_dictionary(routes, table->size);
+  unsigned int n_sources = _compact_dictionary(sources, table->size);
+
+  // Every value takes at most 5 bytes
+  if (!compact_buffer_reserve(b, 5 * ((size_t) 2 + n_routes + n_sources +
+                                      4 * (size_t) table->size)))
+  {
+    free(routes);
+    free(sources);
+    return false;
+  }
+
+  _compact_put(b, n_routes);
+  for (unsigned int i = 0; i < n_routes; i++)
+  {
+    _compact_put(b, routes[i]);
+  }
+
+  _compact_put(b, n_sources);
+  for (unsigned int i = 0; i < n_sources; i++)
+  {
+    _compact_put(b, sources[i]);
+  }
+
+  // Encode the entries
+  uint32_t key = 0x0, mask = 0x0;
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    entry_t *e = &table->entries[i];
+    _compact_put(b, _compact_index(routes, n_routes, e->route));
+    _compact_put(b, _compact_index(sources, n_sources, e->source));
+    _compact_put(b, _compact_zigzag(e->keymask.key - key));
+    _compact_put(b, e->keymask.mask ^ mask);
+
+    key = e->keymask.key;
+    mask = e->keymask.mask;
+  }
+
+  free(routes);
+  free(sources);
+  return true;
+}
+
+
+// Read a dictionary into newly allocated memory
+static inline uint32_t* _compact_get_dictionary(const uint8_t **data,
+                                                const uint8_t *end,
+                                                uint32_t *n)
+{
+  // Every value takes at least one byte
+  if (!_compact_get(data, end, n) || *n > (uint32_t) (end - *data))
+  {
+    return NULL;
+  }
+
+  uint32_t *dict = malloc(sizeof(uint32_t) * (*n + 1));
+  if (dict == NULL)
+  {
+    return NULL;
+  }
+
+  for (unsigned int i = 0; i < *n; i++)
+  {
+    if (!_compact_get(data, end, &dict[i]))
+    {
+      free(dict);
+      return NULL;
+    }
+  }
+
+  return dict;
+}
+
+
+// Decode the `size` entries of a table from `n_bytes` of data into
+// `entries`, returns false if the data is malformed.
+static inline bool compact_decode(const uint8_t *data, size_t n_bytes,
+                                  entry_t *entries, unsigned int size)
+{
+  const uint8_t *end = data + n_bytes;
+
+  uint32_t n_routes, n_sources;
+  uint32_t *routes = _compact_get_dictionary(&data, end, &n_routes);
+  uint32_t *sources = _compact_get_dictionary(&data, end, &n_sources);
+
+  bool ok = routes != NULL && sources != NULL;
+  uint32_t key = 0x0, mask = 0x0;
+  for (unsigned int i = 0; ok && i < size; i++)
+  {
+    uint32_t route, source, key_diff, mask_diff;
+    ok = _compact_get(&data, end, &route) && route < n_routes &&
+         _compact_get(&data, end, &source) && source < n_sources &&
+         _compact_get(&data, end, &key_diff) &&
+         _compact_get(&data, end, &mask_diff);
+
+    if (ok)
+    {
+      key += _compact_unzigzag(key_diff);
+      mask ^= mask_diff;
+
+      entries[i].keymask.key = key;
+      entries[i].keymask.mask = mask;
+      entries[i].route = routes[route];
+      entries[i].source = sources[source];
+    }
+  }
+
+  free(routes);
+  free(sources);
+  return ok && data == end;
+}
+
+#define __COMPACT_H__
+#endif  // __COMPACT_H__
@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "table_file.h"
+#include "table_generator.h"
+
+
+int main(int argc, char *argv[])
+{
+  // Usage:
+  // generate_tables [-v version] [-s seed] [-c cores_per_chip]
+  //                 [-p max_slices] [-f max_projections] [-r radius]
+  //                 [-l local_percent] width height out_file
+  generator_params_t params = generator_params_init(0, 0, 0);
+  unsigned int version = 2;
+  int opt;
+  while ((opt = getopt(argc, argv, "v:s:c:p:f:r:l:")) != -1)
+  {
+    if (opt == 'v')
+    {
+      version = atoi(optarg);
+    }
+    else if (opt == 's')
+    {
+      params.seed = strtoul(optarg, NULL, 0);
+    }
+    else if (opt == 'c')
+    {
+      params.cores_per_chip = atoi(optarg);
+    }
+    else if (opt == 'p')
+    {
+      params.max_slices = atoi(optarg);
+    }
+    else if (opt == 'f')
+    {
+      params.max_projections = atoi(optarg);
+    }
+    else if (opt == 'r')
+    {
+      params.radius = atoi(optarg);
+    }
+    else if (opt == 'l')
+    {
+      params.local_percent = atoi(optarg);
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+  argc -= optind;
+  argv += optind - 1;
+
+  if (argc < 3)
+  {
+    fprintf(stderr, "Usage: generate_tables [-v version] [-s seed] "
+                    "[-c cores_per_chip] [-p max_slices] "
+                    "[-f max_projections] [-r radius] [-l local_percent] "
+                    "width height out_file\n");
+    return EXIT_FAILURE;
+  }
+  params.width = atoi(argv[1]);
+  params.height = atoi(argv[2]);
+
+  table_t *tables = generator_run(&params);
+  if (tables == NULL)
+  {
+    fprintf(stderr, "Could not generate tables with these parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  // Write the tables, `-` means stdout
+  bool to_stdout = strcmp(argv[3], "-") == 0;
+  FILE *out_file = to_stdout ? stdout : fopen(argv[3], "wb");
+  if (out_file == NULL)
+  {
+    fprintf(stderr, "Could not open output file %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+
+  table_writer_t writer;
+  if (!table_writer_open(&writer, out_file, version))
+  {
+    fprintf(stderr, "Could not write version %u output\n", version);
+    return EXIT_FAILURE;
+  }
+
+  // Chips without any entries are left out of the file
+  bool ok = true;
+  unsigned int n_chips = params.width * params.height;
+  unsigned int n_tables = 0, n_entries = 0, max_entries = 0;
+  for (unsigned int i = 0; i < n_chips && ok; i++)
+  {
+    table_t *table = &tables[i];
+    if (table->size > 0)
+    {
+      ok = table_file_write(&writer, i % params.width, i / params.width,
+                            table);
+      n_tables++;
+      n_entries += table->size;
+      max_entries = (table->size > max_entries) ? table->size : max_entries;
+    }
+  }
+  ok = table_writer_close(&writer) && ok;
+  generator_tables_delete(tables, n_chips);
+
+  if (!to_stdout)
+  {
+    fclose(out_file);
+  }
+
+  if (!ok)
+  {
+    fprintf(stderr, "Could not write output file %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(stderr, "%u tables, %u entries (at most %u in a table)\n",
+          n_tables, n_entries, max_entries);
+  return EXIT_SUCCESS;
+}
@@ -1,104 +1,156 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "routing_table.h"
-#include "mtrie.h"
+#include "table_file.h"
+#include "batch.h"
+#include "cache.h"
+#include "verify.h"
+#include "rig_rt.h"
 
 
-// Data header in file format
-typedef struct _header_t
+// Minimise a table, ignoring any bits which are the same in every entry
+bool minimise(table_t *table, void *arg)
 {
-  uint8_t x, y;
-  uint16_t length;
-} header_t;
+  (void) arg;
+  rig_rt_mtrie_minimise(batch_context(), table);
+  return true;
+}
 
 
-// Table entry type in file format
-typedef struct _fentry
+// Minimise a table as above, sharing identical subtries
+bool minimise_shared(table_t *table, void *arg)
 {
-  uint32_t key, mask, source, route;
-} fentry_t;
+  (void) arg;
+  rig_rt_mtrie_minimise_shared(batch_context(), table);
+  return true;
+}
 
 
 int main(int argc, char *argv[])
 {
   // Usage:
-  // mtrie in_file out_file
-  if (argc < 3)
+  // mtrie [-j n_threads] [-v version] [-c cache_dir] [-e] [-H] in_file
+  //       out_file
+  unsigned int n_threads = 1;
+  unsigned int version = 0;  // Same format as the input
+  const char *cache_dir = NULL;
+  bool check = false;  // Check each minimised table against the original
+  bool shared = false;  // Share identical subtries
+  int opt;
+  while ((opt = getopt(argc, argv, "j:v:c:eH")) != -1)
+  {
+    if (opt == 'j')
+    {
+      n_threads = atoi(optarg);
+    }
+    else if (opt == 'v')
+    {
+      version = atoi(optarg);
+    }
+    else if (opt == 'c')
+    {
+      cache_dir = optarg;
+    }
+    else if (opt == 'e')
+    {
+      check = true;
+    }
+    else if (opt == 'H')
+    {
+      shared = true;
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+  argc -= optind;
+  argv += optind - 1;
+
+  if (argc < 2)
   {
-    fprintf(stderr, "Usage: mtrie in_file out_file");
+    fprintf(stderr, "Usage: mtrie [-j n_threads] [-v version] "
+                    "[-c cache_dir] [-e] [-H] in_file out_file\n");
     return EXIT_FAILURE;
   }
 
-  // Open the input and output files
-  FILE *in_file = fopen(argv[1], "rb");
-  if (in_file == NULL)
+  // Open the input and output files, `-` means stdin or stdout
+  table_reader_t in_file;
+  if (!table_reader_open(&in_file, argv[1]))
   {
     fprintf(stderr, "Could not open input file %s\n", argv[1]);
     return EXIT_FAILURE;
   }
 
-  FILE *out_file = fopen(argv[2], "wb+");
+  bool to_stdout = strcmp(argv[2], "-") == 0;
+  FILE *out_file = to_stdout ? stdout : fopen(argv[2], "wb+");
   if (out_file == NULL)
   {
     fprintf(stderr, "Could not open output file %s\n", argv[2]);
     return EXIT_FAILURE;
   }
 
-  // Stream through the input file
-  header_t h;
-  while (fread(&h, sizeof(header_t), 1, in_file))
+  // Write the output in the same format as the input unless told otherwise
+  table_writer_t writer;
+  if (!table_writer_open(&writer, out_file,
+                         version ? version : in_file.version))
   {
-    // Print information about the current table
-    printf("(%3u, %3u)\t%4u\t", h.x, h.y, h.length);
-    fflush(stdout);
+    fprintf(stderr, "Could not write version %u output\n", version);
+    return EXIT_FAILURE;
+  }
 
-    // Read in the routing table
-    table_t table;
-    table.size = h.length;
-    table.entries = malloc(sizeof(entry_t) * h.length);
+  // Progress is reported on stderr if stdout is being used for output
+  FILE *log = to_stdout ? stderr : stdout;
 
-    for (unsigned int i = 0; i < table.size; i++)
+  // Minimise each table in the input file, through the cache if one was given
+  batch_minimise_t fn = shared ? minimise_shared : minimise;
+  void *arg = NULL;
+  cache_t cache;
+  if (cache_dir != NULL)
+  {
+    if (!cache_init(&cache, cache_dir, "mtrie", 0, fn, arg))
     {
-      fentry_t t;
-      if (!fread(&t, sizeof(fentry_t), 1, in_file))
-      {
-        fprintf(stderr, "ERROR: Incomplete routing table\n");
-        return EXIT_FAILURE;
-      }
-
-      // Copy relevant fields across
-      table.entries[i].keymask.key = t.key;
-      table.entries[i].keymask.mask = t.mask;
-      table.entries[i].route = t.route;
-      table.entries[i].source = t.source;
+      fprintf(stderr, "Could not open cache %s\n", cache_dir);
+      return EXIT_FAILURE;
     }
+    fn = cache_minimise;
+    arg = &cache;
+  }
 
-    // Perform the minimisation
-    mtrie_minimise(&table);
-
-    printf("%u\n", table.size);
-
-    // Dump the table into the output file
-    h.length = table.size;
-    fwrite(&h, sizeof(header_t), 1, out_file);
+  // Check every table, including those from the cache, if asked to
+  verify_t verify;
+  if (check)
+  {
+    verify_init(&verify, fn, arg);
+    fn = verify_minimise;
+    arg = &verify;
+  }
 
-    for (unsigned int i = 0; i < table.size; i++)
-    {
-      fentry_t t = {
-        // Copy relevant fields across
-        table.entries[i].keymask.key,
-        table.entries[i].keymask.mask,
-        table.entries[i].source,
-        table.entries[i].route,
-      };
-      fwrite(&t, sizeof(fentry_t), 1, out_file);
-    }
+  bool ok = batch_minimise(&in_file, &writer, log, n_threads, fn, arg);
+  if (check)
+  {
+    verify_report(&verify, log);
+    ok = verify.n_failed == 0 && ok;
+    verify_delete(&verify);
   }
+  if (cache_dir != NULL)
+  {
+    cache_report(&cache, log);
+    cache_delete(&cache);
+  }
+  ok = table_writer_close(&writer) && ok;
 
   // Close the input and output files
-  fclose(in_file);
-  fclose(out_file);
+  table_reader_close(&in_file);
+  if (!to_stdout)
+  {
+    fclose(out_file);
+  }
 
-  return EXIT_SUCCESS;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,157 +1,377 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "routing_table.h"
+#include "table_file.h"
+#include "batch.h"
+#include "cache.h"
+#include "verify.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "warm.h"
+#include "rig_rt.h"
+#include "merge_history.h"
 #include "ordered_covering.h"
+#include "constant_columns.h"
+#include "oc_stats.h"
 
 
-// Data header in file format
-typedef struct _header_t
+typedef struct _options_t
 {
-  uint8_t x, y;
-  uint16_t length;
-} header_t;
+  unsigned int target_length;  // Length at which to stop minimising
+  warm_t *warm;                // Merges of finished tables, or NULL
+  checkpoint_t *checkpoint;    // Snapshots of tables being minimised, or NULL
+  FILE *stats;                 // File to which to write statistics, or NULL
+  trace_t *trace;              // Trace of every iteration, or NULL
+} options_t;
 
 
-// Table entry type in file format
-typedef struct _fentry
-{
-  uint32_t key, mask, source, route;
-} fentry_t;
+// Seconds between snapshots of a table when checkpointing
+#define CHECKPOINT_INTERVAL 5.0
+
+
+// Statistics of tables minimised by different threads are written one at a
+// time
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
-// Routing table entry comparison method
-int entry_cmp(const void *a, const void *b)
+// Write the statistics gathered while minimising a table as a line of JSON
+void write_stats(FILE *f, chip_table_t *chip, table_t *minimised)
 {
-  // Get the generalities
-  const unsigned int gen_a = keymask_count_xs(((entry_t *) a)->keymask);
-  const unsigned int gen_b = keymask_count_xs(((entry_t *) b)->keymask);
+  pthread_mutex_lock(&stats_lock);
+  fprintf(f, "{\"x\": %u, \"y\": %u, \"size\": %u, \"minimised\": %u",
+          chip->x, chip->y, chip->table.size, minimised->size);
 
-  // Compare
-  if (gen_a < gen_b)
+#ifdef OC_STATS
+  fprintf(f, ", \"intersect_tests\": %llu, \"downcheck_rounds\": %llu, "
+             "\"alias_elements_scanned\": %llu, \"merges_applied\": %llu, "
+             "\"bytes_moved\": %llu, \"phase_ns\": {",
+          (unsigned long long) oc_stats.intersect_tests,
+          (unsigned long long) oc_stats.downcheck_rounds,
+          (unsigned long long) oc_stats.alias_elements_scanned,
+          (unsigned long long) oc_stats.merges_applied,
+          (unsigned long long) oc_stats.bytes_moved);
+  for (unsigned int p = 0; p < OC_N_PHASES; p++)
   {
-    return -1;
+    fprintf(f, "%s\"%s\": %llu", p ? ", " : "", oc_phase_name(p),
+            (unsigned long long) oc_stats.phase_ns[p]);
   }
-  else if (gen_a == gen_b)
+  fprintf(f, "}");
+#endif
+
+  fprintf(f, "}\n");
+  pthread_mutex_unlock(&stats_lock);
+}
+
+
+// Sort and then minimise a table, `arg` points to the options. Returns false,
+// leaving the table unchanged, if there was no memory to sort it.
+bool minimise(table_t *table, void *arg)
+{
+  options_t *options = arg;
+  oc_stats_reset();
+
+  if (options->checkpoint != NULL)
   {
-    return 0;
+    // Minimise, resuming from and saving snapshots
+    if (!table_sort_by_generality(table))
+    {
+      return false;
+    }
+    checkpoint_minimise(table, options->checkpoint);
   }
-  else
+  else if (options->warm != NULL)
   {
-    return 1;
-  }
-}
+    // Replay the merges from the nearest chip which has finished (tables are
+    // often similar to their neighbours) and record the new merges.
+    if (!table_sort_by_generality(table))
+    {
+      return false;
+    }
 
+    chip_table_t *chip = batch_current_chip();
+    merge_history_t nearest;
+    bool found = warm_nearest(options->warm, chip->x, chip->y, &nearest);
 
-void minimise(table_t *table, unsigned int target_length)
-{
-  // Create an empty aliases table
-  aliases_t aliases = aliases_init();
+    aliases_t aliases = aliases_init();
+    merge_history_t merges = merge_history_init();
+    columns_oc_minimise_warm(table, options->target_length, &aliases,
+                             found ? &nearest : NULL, &merges);
+    warm_add(options->warm, chip->x, chip->y, merges);
+    aliases_clear(&aliases);
+  }
+  else if (options->trace != NULL)
+  {
+    // Trace every iteration
+    if (!table_sort_by_generality(table))
+    {
+      return false;
+    }
 
-  // Minimise
-  oc_minimise(table, target_length, &aliases);
+    chip_table_t *chip = batch_current_chip();
+    trace_table_t trace = trace_table(options->trace, chip->x, chip->y);
+    aliases_t aliases = aliases_init();
+    columns_oc_minimise_traced(table, options->target_length, &aliases,
+                               trace_write, &trace);
+    aliases_clear(&aliases);
+  }
+  else if (options->stats != NULL)
+  {
+    // Minimise here, rather than in the library, so that the statistics are
+    // gathered in the counters of this thread.
+    if (!table_sort_by_generality(table))
+    {
+      return false;
+    }
 
-  // Tidy up the aliases table
-  for (unsigned int i = 0; i < table->size; i++)
+    aliases_t aliases = aliases_init();
+    columns_oc_minimise(table, options->target_length, &aliases);
+    aliases_clear(&aliases);
+  }
+  else
   {
-    keymask_t km = table->entries[i].keymask;
-    if (aliases_contains(&aliases, km))
+    // Sort and minimise, ignoring any bits which are the same in every entry,
+    // reusing the memory of the tables this thread minimised before.
+    if (!rig_rt_oc_minimise(batch_context(), table, options->target_length))
     {
-      alias_list_delete((alias_list_t *) aliases_find(&aliases, km));
-      aliases_remove(&aliases, km);
+      return false;
     }
   }
+
+  if (options->stats != NULL)
+  {
+    write_stats(options->stats, batch_current_chip(), table);
+  }
+  return true;
 }
 
 
 int main(int argc, char *argv[])
 {
   // Usage:
-  // ordered_covering in_file out_file [target_length]
-  if (argc < 3)
+  // ordered_covering [-j n_threads] [-v version] [-c cache_dir] [-e]
+  //                  [-w | -k checkpoint_dir | -t trace_file]
+  //                  [-s stats_file] in_file out_file [target_length]
+  options_t options = {0, NULL, NULL, NULL, NULL};
+  unsigned int n_threads = 1;
+  unsigned int version = 0;  // Same format as the input
+  const char *cache_dir = NULL;
+  bool check = false;  // Check each minimised table against the original
+  bool warm = false;  // Warm-start from the merges of neighbouring chips
+  const char *checkpoint_dir = NULL;
+  const char *stats_file = NULL;
+  const char *trace_file = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:v:c:ewk:s:t:")) != -1)
+  {
+    if (opt == 'j')
+    {
+      n_threads = atoi(optarg);
+    }
+    else if (opt == 'v')
+    {
+      version = atoi(optarg);
+    }
+    else if (opt == 'c')
+    {
+      cache_dir = optarg;
+    }
+    else if (opt == 'e')
+    {
+      check = true;
+    }
+    else if (opt == 'w')
+    {
+      warm = true;
+    }
+    else if (opt == 'k')
+    {
+      checkpoint_dir = optarg;
+    }
+    else if (opt == 's')
+    {
+      stats_file = optarg;
+    }
+    else if (opt == 't')
+    {
+      trace_file = optarg;
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+  argc -= optind;
+  argv += optind - 1;
+
+  // Warm-started minimisation depends on the previous table so cannot be
+  // resumed from a snapshot, and neither warm-started nor resumed
+  // minimisation can be traced from the start.
+  if (argc < 2 ||
+      warm + (checkpoint_dir != NULL) + (trace_file != NULL) > 1)
   {
-    fprintf(stderr, "Usage: ordered_covering in_file out_file [target_length]\n");
+    fprintf(stderr, "Usage: ordered_covering [-j n_threads] [-v version] "
+                    "[-c cache_dir] [-e] "
+                    "[-w | -k checkpoint_dir | -t trace_file] "
+                    "[-s stats_file] in_file out_file [target_length]\n");
     return EXIT_FAILURE;
   }
 
-  unsigned int target_length = 0;
-  if (argc >= 4)
+  if (argc >= 3)
   {
-    target_length = atoi(argv[3]);
+    options.target_length = atoi(argv[3]);
+  }
+
+  if (stats_file != NULL)
+  {
+#ifndef OC_STATS
+    fprintf(stderr, "Warning: built without OC_STATS, statistics will only "
+                    "include table sizes\n");
+#endif
+    options.stats = fopen(stats_file, "w");
+    if (options.stats == NULL)
+    {
+      fprintf(stderr, "Could not open statistics file %s\n", stats_file);
+      return EXIT_FAILURE;
+    }
   }
 
-  // Open the input and output files
-  FILE *in_file = fopen(argv[1], "rb");
-  if (in_file == NULL)
+  // Open the input and output files, `-` means stdin or stdout
+  table_reader_t in_file;
+  if (!table_reader_open(&in_file, argv[1]))
   {
     fprintf(stderr, "Could not open input file %s\n", argv[1]);
     return EXIT_FAILURE;
   }
 
-  FILE *out_file = fopen(argv[2], "wb+");
+  bool to_stdout = strcmp(argv[2], "-") == 0;
+  FILE *out_file = to_stdout ? stdout : fopen(argv[2], "wb+");
   if (out_file == NULL)
   {
     fprintf(stderr, "Could not open output file %s\n", argv[2]);
     return EXIT_FAILURE;
   }
 
-  // Stream through the input file
-  header_t h;
-  while (fread(&h, sizeof(header_t), 1, in_file))
+  // Write the output in the same format as the input unless told otherwise
+  table_writer_t writer;
+  if (!table_writer_open(&writer, out_file,
+                         version ? version : in_file.version))
   {
-    // Print information about the current table
-    printf("(%3u, %3u)\t%4u\t", h.x, h.y, h.length);
-    fflush(stdout);
+    fprintf(stderr, "Could not write version %u output\n", version);
+    return EXIT_FAILURE;
+  }
 
-    // Read in the routing table
-    table_t table;
-    table.size = h.length;
-    table.entries = malloc(sizeof(entry_t) * h.length);
+  // Progress is reported on stderr if stdout is being used for output
+  FILE *log = to_stdout ? stderr : stdout;
 
-    for (unsigned int i = 0; i < table.size; i++)
+  // Traces are written as CSV if the file name ends in .csv
+  trace_t trace;
+  FILE *trace_out = NULL;
+  if (trace_file != NULL)
+  {
+    size_t len = strlen(trace_file);
+    bool csv = len >= 4 && strcmp(trace_file + len - 4, ".csv") == 0;
+    trace_out = fopen(trace_file, csv ? "w" : "wb");
+    if (trace_out == NULL || !trace_init(&trace, trace_out, csv))
     {
-      fentry_t t;
-      if (!fread(&t, sizeof(fentry_t), 1, in_file))
-      {
-        fprintf(stderr, "ERROR: Incomplete routing table\n");
-        return EXIT_FAILURE;
-      }
+      fprintf(stderr, "Could not open trace file %s\n", trace_file);
+      return EXIT_FAILURE;
+    }
+    options.trace = &trace;
+  }
 
-      // Copy relevant fields across
-      table.entries[i].keymask.key = t.key;
-      table.entries[i].keymask.mask = t.mask;
-      table.entries[i].route = t.route;
-      table.entries[i].source = t.source;
+  checkpoint_t checkpoint;
+  if (checkpoint_dir != NULL)
+  {
+    if (!checkpoint_init(&checkpoint, checkpoint_dir, CHECKPOINT_INTERVAL,
+                         options.target_length))
+    {
+      fprintf(stderr, "Could not open checkpoint directory %s\n",
+              checkpoint_dir);
+      return EXIT_FAILURE;
     }
+    options.checkpoint = &checkpoint;
+  }
+
+  warm_t warm_merges;
+  if (warm)
+  {
+    warm_init(&warm_merges);
+    options.warm = &warm_merges;
+  }
 
-    // Sort the table
-    qsort(table.entries, table.size, sizeof(entry_t), entry_cmp);
+  // Minimise each table in the input file, through the cache if one was given
+  batch_minimise_t fn = minimise;
+  void *arg = &options;
+  cache_t cache;
+  if (cache_dir != NULL)
+  {
+    const char *algorithm = warm ? "ordered_covering -w" :
+                                           "ordered_covering";
+    if (!cache_init(&cache, cache_dir, algorithm, options.target_length,
+                    fn, arg))
+    {
+      fprintf(stderr, "Could not open cache %s\n", cache_dir);
+      return EXIT_FAILURE;
+    }
+    fn = cache_minimise;
+    arg = &cache;
+  }
 
-    // Perform the minimisation
-    minimise(&table, target_length);
+  // Check every table, including those from the cache, if asked to
+  verify_t verify;
+  if (check)
+  {
+    verify_init(&verify, fn, arg);
+    fn = verify_minimise;
+    arg = &verify;
+  }
 
-    printf("%u\n", table.size);
+  bool ok = batch_minimise(&in_file, &writer, log, n_threads, fn, arg);
+  if (check)
+  {
+    verify_report(&verify, log);
+    ok = verify.n_failed == 0 && ok;
+    verify_delete(&verify);
+  }
+  if (cache_dir != NULL)
+  {
+    cache_report(&cache, log);
+    cache_delete(&cache);
+  }
+  ok = table_writer_close(&writer) && ok;
 
-    // Dump the table into the output file
-    h.length = table.size;
-    fwrite(&h, sizeof(header_t), 1, out_file);
+  if (checkpoint_dir != NULL)
+  {
+    fprintf(log, "Checkpoint: %u tables resumed, %u snapshots written\n",
+            checkpoint.n_resumed, checkpoint.n_written);
+    checkpoint_delete(&checkpoint);
+  }
 
-    for (unsigned int i = 0; i < table.size; i++)
-    {
-      fentry_t t = {
-        // Copy relevant fields across
-        table.entries[i].keymask.key,
-        table.entries[i].keymask.mask,
-        table.entries[i].source,
-        table.entries[i].route,
-      };
-      fwrite(&t, sizeof(fentry_t), 1, out_file);
-    }
+  if (warm)
+  {
+    warm_delete(&warm_merges);
   }
 
-  // Close the input and output files
-  fclose(in_file);
-  fclose(out_file);
+  // Close the input, output, statistics and trace files
+  if (options.stats != NULL)
+  {
+    fclose(options.stats);
+  }
+  if (trace_out != NULL)
+  {
+    trace_delete(&trace);
+    ok = (fclose(trace_out) == 0) && ok;
+  }
+  table_reader_close(&in_file);
+  if (!to_stdout)
+  {
+    fclose(out_file);
+  }
 
-  return EXIT_SUCCESS;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
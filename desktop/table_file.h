@@ -0,0 +1,936 @@
+/* Reading and writing routing table files.
+ *
+ * Two formats are supported:
+ *
+ *  - Version 1 (legacy): a sequence of tables, each an 8-bit x and y
+ *    co-ordinate and a 16-bit length followed by `length` entries of (key,
+ *    mask, source, route).
+ *
+ *  - Version 2: a 32-bit magic number and version number followed by a
+ *    sequence of tables, each a 16-bit x and y co-ordinate and a 32-bit
+ *    length followed by `length` entries in the same layout as `entry_t` (key,
+ *    mask, route, source). The tables are terminated by a header with x = y =
+ *    0xffff, after which comes an index of the tables (chip co-ordinates,
+ *    length and the offset of the table header) and a trailer giving the
+ *    offset of the terminating header.
+ *
+ *  - Version 3 (compact): the version 2 file header followed by a sequence of
+ *    tables, each the x and y co-ordinates, the number of entries and the
+ *    number of bytes of encoded entries (all varints) followed by the entries
+ *    encoded as described in `compact.h`. There is no index so these files
+ *    are always streamed.
+ *
+ * Input files are memory-mapped (copy-on-write) and indexed; version 2 files
+ * using the index in the footer and version 1 files in a single pass over the
+ * table headers. Version 1 entries are converted into `entry_t` in place, so
+ * in either case each table handed to the minimisers points directly into the
+ * mapping and no per-entry reads or copies are required.
+ *
+ * Streams which cannot be mapped (pipes, stdin) are instead read one table at
+ * a time by a `table_reader_t` so that tables can be processed as they arrive.
+ * The format of an input is detected from the presence of the magic number.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "compact.h"
+
+#ifndef __TABLE_FILE_H__
+
+// Magic number at the start of version 2 and 3 files (and end of version 2
+// files), "RTB2"
+#define TABLE_FILE_MAGIC 0x32425452
+
+// Co-ordinate used in the header which terminates the tables of a version 2
+// file.
+#define TABLE_FILE_FOOTER 0xffff
+
+// Most entries in a table read from a stream, larger tables are assumed to be
+// corrupt rather than allocated.
+#define TABLE_FILE_MAX_ENTRIES (1 << 24)
+
+// Most bytes of a table read from a stream which are allocated before any of
+// them have been read, more memory is allocated as more bytes arrive.
+#define _TABLE_FILE_CHUNK (1 << 16)
+
+// File header in version 2 and 3 file formats
+typedef struct _file_header_t
+{
+  uint32_t magic, version;
+} file_header_t;
+
+
+// Data header in version 1 file format
+typedef struct _header_t
+{
+  uint8_t x, y;
+  uint16_t length;
+} header_t;
+
+
+// Data header in version 2 file format
+typedef struct _header_v2_t
+{
+  uint16_t x, y;
+  uint32_t length;
+} header_v2_t;
+
+
+// Entry in the index at the end of a version 2 file
+typedef struct _index_entry_t
+{
+  uint16_t x, y;
+  uint32_t length;
+  uint64_t offset;  // Offset of the table header from the start of the file
+} index_entry_t;
+
+
+// Trailer at the very end of a version 2 file
+typedef struct _trailer_t
+{
+  uint64_t footer_offset;  // Offset of the header terminating the tables
+  uint32_t n_tables;       // Number of entries in the index
+  uint32_t magic;
+} trailer_t;
+
+
+// Table entry type in version 1 file format
+typedef struct _fentry
+{
+  uint32_t key, mask, source, route;
+} fentry_t;
+
+
+// Entries are converted in place so must be the same size in either layout
+_Static_assert(sizeof(fentry_t) == sizeof(entry_t),
+               "File entries must be the same size as table entries");
+
+
+// Routing table for a single chip
+typedef struct _chip_table_t
+{
+  unsigned int x, y;  // Chip co-ordinates
+  table_t table;      // Routing table (entries point into the file data)
+  table_t minimised;  // Minimised routing table (shares the same entries)
+} chip_table_t;
+
+
+// Routing table file which has been read into memory
+typedef struct _table_file_t
+{
+  uint8_t *data;          // Contents of the file
+  size_t size;            // Size of the file in bytes
+  bool mapped;            // Whether data is mapped (or allocated)
+  unsigned int version;   // Format of the file
+
+  unsigned int n_tables;  // Number of tables in the file
+  chip_table_t *tables;   // Index of the tables in the file
+} table_file_t;
+
+
+// Swap the route and source fields of a block of entries, this converts
+// between the version 1 file layout and `entry_t`.
+static inline void table_file_swap_fields(entry_t *entries, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; i++)
+  {
+    uint32_t route = entries[i].route;
+    entries[i].route = entries[i].source;
+    entries[i].source = route;
+  }
+}
+
+
+// Read the entire contents of a file which cannot be mapped
+static inline bool _table_file_read_all(table_file_t *f, FILE *in)
+{
+  size_t capacity = _TABLE_FILE_CHUNK;
+  f->data = malloc(capacity);
+  f->size = 0;
+  if (f->data == NULL)
+  {
+    fprintf(stderr, "ERROR: Out of memory reading routing tables\n");
+    return false;
+  }
+
+  size_t n_read;
+  while ((n_read = fread(f->data + f->size, 1, capacity - f->size, in)) > 0)
+  {
+    f->size += n_read;
+    if (f->size == capacity)
+    {
+      uint8_t *data = realloc(f->data, 2 * capacity);
+      if (data == NULL)
+      {
+        fprintf(stderr, "ERROR: Out of memory reading routing tables\n");
+        return false;
+      }
+      f->data = data;
+      capacity *= 2;
+    }
+  }
+
+  return !ferror(in);
+}
+
+
+// Build the index of tables in a version 1 file and convert the entries of
+// each table.
+static inline bool _table_file_index_v1(table_file_t *f)
+{
+  unsigned int capacity = 16;
+  f->n_tables = 0;
+  f->tables = malloc(sizeof(chip_table_t) * capacity);
+  if (f->tables == NULL)
+  {
+    fprintf(stderr, "ERROR: Out of memory indexing routing tables\n");
+    return false;
+  }
+
+  size_t offset = 0;
+  while (offset + sizeof(header_t) <= f->size)
+  {
+    header_t *h = (header_t *) (f->data + offset);
+    offset += sizeof(header_t);
+
+    if (offset + sizeof(fentry_t) * h->length > f->size)
+    {
+      fprintf(stderr, "ERROR: Incomplete routing table\n");
+      return false;
+    }
+
+    // Add the table to the index
+    if (f->n_tables == capacity)
+    {
+      chip_table_t *tables = realloc(f->tables,
+                                     sizeof(chip_table_t) * 2 * capacity);
+      if (tables == NULL)
+      {
+        fprintf(stderr, "ERROR: Out of memory indexing routing tables\n");
+        return false;
+      }
+      f->tables = tables;
+      capacity *= 2;
+    }
+
+    chip_table_t *t = &f->tables[f->n_tables++];
+    t->x = h->x;
+    t->y = h->y;
+    t->table.size = h->length;
+    t->table.entries = (entry_t *) (f->data + offset);
+    table_file_swap_fields(t->table.entries, t->table.size);
+
+    offset += sizeof(fentry_t) * h->length;
+  }
+
+  if (offset != f->size)
+  {
+    fprintf(stderr, "ERROR: Incomplete routing table\n");
+    return false;
+  }
+
+  return true;
+}
+
+
+// Build the index of tables in a version 2 file from its footer, no table
+// need be read to do so.
+static inline bool _table_file_index_v2(table_file_t *f)
+{
+  f->n_tables = 0;
+  f->tables = NULL;
+
+  if (f->size <
+      sizeof(file_header_t) + sizeof(header_v2_t) + sizeof(trailer_t))
+  {
+    fprintf(stderr, "ERROR: Missing or corrupt table index\n");
+    return false;
+  }
+
+  // Read the trailer and check that the index fits between it and the header
+  // which terminates the tables.
+  trailer_t *trailer = (trailer_t *) (f->data + f->size - sizeof(trailer_t));
+  if (((file_header_t *) f->data)->version != 2 ||
+      trailer->magic != TABLE_FILE_MAGIC ||
+      trailer->footer_offset + sizeof(header_v2_t) +
+        sizeof(index_entry_t) * (uint64_t) trailer->n_tables +
+        sizeof(trailer_t) != f->size)
+  {
+    fprintf(stderr, "ERROR: Missing or corrupt table index\n");
+    return false;
+  }
+
+  header_v2_t *footer = (header_v2_t *) (f->data + trailer->footer_offset);
+  index_entry_t *index = (index_entry_t *) (footer + 1);
+
+  // The number of tables has been checked against the size of the file
+  f->tables = malloc(sizeof(chip_table_t) *
+                     (trailer->n_tables ? trailer->n_tables : 1));
+  if (f->tables == NULL)
+  {
+    fprintf(stderr, "ERROR: Out of memory indexing routing tables\n");
+    return false;
+  }
+  f->n_tables = trailer->n_tables;
+
+  for (unsigned int i = 0; i < f->n_tables; i++)
+  {
+    uint64_t end = index[i].offset + sizeof(header_v2_t) +
+                   sizeof(entry_t) * (uint64_t) index[i].length;
+    if (index[i].offset < sizeof(file_header_t) ||
+        end > trailer->footer_offset)
+    {
+      fprintf(stderr, "ERROR: Missing or corrupt table index\n");
+      return false;
+    }
+
+    chip_table_t *t = &f->tables[i];
+    t->x = index[i].x;
+    t->y = index[i].y;
+    t->table.size = index[i].length;
+    t->table.entries = (entry_t *) (f->data + index[i].offset +
+                                    sizeof(header_v2_t));
+  }
+
+  return true;
+}
+
+
+// Close a table file, all tables read from it become invalid
+static inline void table_file_close(table_file_t *f)
+{
+  if (f->mapped)
+  {
+    munmap(f->data, f->size);
+  }
+  else
+  {
+    free(f->data);
+  }
+  f->data = NULL;
+  f->size = 0;
+
+  free(f->tables);
+  f->tables = NULL;
+  f->n_tables = 0;
+}
+
+
+// Read and index a table file. Tables may be modified in place (changes are
+// never written back to the file).
+static inline bool table_file_open(table_file_t *f, const char *path)
+{
+  f->data = NULL;
+  f->size = 0;
+  f->mapped = false;
+  f->version = 1;
+  f->n_tables = 0;
+  f->tables = NULL;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  // Map the file if possible, otherwise read it into memory
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    if (data != MAP_FAILED)
+    {
+      f->data = data;
+      f->size = st.st_size;
+      f->mapped = true;
+    }
+  }
+
+  bool ok = true;
+  if (!f->mapped)
+  {
+    FILE *in = fdopen(fd, "rb");
+    ok = _table_file_read_all(f, in);
+    fclose(in);
+  }
+  else
+  {
+    close(fd);
+  }
+
+  if (ok)
+  {
+    if (f->size >= sizeof(file_header_t) &&
+        *((uint32_t *) f->data) == TABLE_FILE_MAGIC)
+    {
+      f->version = ((file_header_t *) f->data)->version;
+      ok = (f->version == 2) && _table_file_index_v2(f);
+    }
+    else
+    {
+      ok = _table_file_index_v1(f);
+    }
+  }
+
+  if (!ok)
+  {
+    table_file_close(f);
+  }
+  return ok;
+}
+
+
+// Find the table for a chip, returns NULL if the file contains no table for
+// the chip.
+static inline chip_table_t* table_file_find(table_file_t *f,
+                                            unsigned int x, unsigned int y)
+{
+  for (unsigned int i = 0; i < f->n_tables; i++)
+  {
+    if (f->tables[i].x == x && f->tables[i].y == y)
+    {
+      return &f->tables[i];
+    }
+  }
+
+  return NULL;
+}
+
+
+// Writer of routing table files, tables are written as they are provided and
+// any index is written when the writer is closed.
+typedef struct _table_writer_t
+{
+  FILE *out;
+  unsigned int version;    // Format to write
+  uint64_t offset;         // Number of bytes written so far
+
+  unsigned int n_tables;   // Number of tables written so far
+  unsigned int capacity;   // Size of the index
+  index_entry_t *index;    // Index of tables which have been written
+
+  compact_buffer_t buffer; // Buffer used when encoding compact tables
+} table_writer_t;
+
+
+// Start writing a table file in the given format
+static inline bool table_writer_open(table_writer_t *w, FILE *out,
+                                     unsigned int version)
+{
+  w->out = out;
+  w->version = version;
+  w->offset = 0;
+  w->n_tables = 0;
+  w->capacity = 0;
+  w->index = NULL;
+  w->buffer = compact_buffer_init();
+
+  if (version == 2 || version == 3)
+  {
+    file_header_t h = {TABLE_FILE_MAGIC, version};
+    w->offset = sizeof(file_header_t);
+    return fwrite(&h, sizeof(file_header_t), 1, out) == 1;
+  }
+
+  return version == 1;
+}
+
+
+// Write a single varint to a file
+static inline bool _table_file_put(FILE *out, uint32_t value)
+{
+  uint8_t data[5];
+  compact_buffer_t b = {data, 0, sizeof(data)};
+  _compact_put(&b, value);
+  return fwrite(data, 1, b.size, out) == b.size;
+}
+
+
+// Write a routing table to a file, returns false if it could not be written
+// (or memory could not be allocated to encode it).
+static inline bool table_file_write(table_writer_t *w,
+                                    unsigned int x, unsigned int y,
+                                    table_t *table)
+{
+  if (w->version == 1)
+  {
+    // Check that the table can be represented by the legacy format
+    if (x > UINT8_MAX || y > UINT8_MAX || table->size > UINT16_MAX)
+    {
+      fprintf(stderr, "ERROR: (%u, %u) cannot be written in version 1 "
+                      "format\n", x, y);
+      return false;
+    }
+
+    header_t h = {x, y, table->size};
+    if (!fwrite(&h, sizeof(header_t), 1, w->out))
+    {
+      return false;
+    }
+
+    // Convert the entries to the file layout, write them in one go and then
+    // convert them back again.
+    table_file_swap_fields(table->entries, table->size);
+    size_t written = fwrite(table->entries, sizeof(fentry_t), table->size,
+                            w->out);
+    table_file_swap_fields(table->entries, table->size);
+
+    return written == table->size;
+  }
+
+  if (w->version == 3)
+  {
+    // Encode the entries after the header
+    compact_buffer_t *b = &w->buffer;
+    b->size = 0;
+    bool encoded = compact_buffer_reserve(b, 4 * 5);
+    if (encoded)
+    {
+      _compact_put(b, x);
+      _compact_put(b, y);
+      _compact_put(b, table->size);
+    }
+
+    size_t n_header = b->size;
+    if (!encoded || !compact_encode(b, table))
+    {
+      fprintf(stderr, "ERROR: (%u, %u) out of memory encoding the table\n",
+              x, y);
+      return false;
+    }
+    size_t n_bytes = b->size - n_header;
+
+    // Write the header, the size of the entries and then the entries
+    return fwrite(b->data, 1, n_header, w->out) == n_header &&
+           _table_file_put(w->out, n_bytes) &&
+           fwrite(b->data + n_header, 1, n_bytes, w->out) == n_bytes;
+  }
+
+  if (x >= TABLE_FILE_FOOTER || y >= TABLE_FILE_FOOTER)
+  {
+    fprintf(stderr, "ERROR: (%u, %u) cannot be written\n", x, y);
+    return false;
+  }
+
+  // Add the table to the index
+  if (w->n_tables == w->capacity)
+  {
+    unsigned int capacity = w->capacity ? w->capacity * 2 : 16;
+    index_entry_t *index = realloc(w->index,
+                                   sizeof(index_entry_t) * capacity);
+    if (index == NULL)
+    {
+      fprintf(stderr, "ERROR: Out of memory indexing routing tables\n");
+      return false;
+    }
+    w->index = index;
+    w->capacity = capacity;
+  }
+  index_entry_t *i = &w->index[w->n_tables++];
+  i->x = x;
+  i->y = y;
+  i->length = table->size;
+  i->offset = w->offset;
+
+  // Write the header and entries, which are stored unconverted
+  header_v2_t h = {x, y, table->size};
+  if (!fwrite(&h, sizeof(header_v2_t), 1, w->out) ||
+      fwrite(table->entries, sizeof(entry_t), table->size,
+             w->out) != table->size)
+  {
+    return false;
+  }
+  w->offset += sizeof(header_v2_t) + sizeof(entry_t) * table->size;
+
+  return true;
+}
+
+
+// Finish writing a table file, writing the index if required
+static inline bool table_writer_close(table_writer_t *w)
+{
+  bool ok = true;
+
+  if (w->version == 2)
+  {
+    header_v2_t footer = {TABLE_FILE_FOOTER, TABLE_FILE_FOOTER, w->n_tables};
+    trailer_t trailer = {w->offset, w->n_tables, TABLE_FILE_MAGIC};
+
+    ok = fwrite(&footer, sizeof(header_v2_t), 1, w->out) == 1 &&
+         fwrite(w->index, sizeof(index_entry_t), w->n_tables,
+                w->out) == w->n_tables &&
+         fwrite(&trailer, sizeof(trailer_t), 1, w->out) == 1;
+  }
+
+  free(w->index);
+  w->index = NULL;
+  compact_buffer_delete(&w->buffer);
+  return ok;
+}
+
+
+// Source of tables, either an indexed (mapped) file or a stream which is read
+// one table at a time.
+typedef struct _table_reader_t
+{
+  bool indexed;          // Whether tables come from `file` or `stream`
+  table_file_t file;     // Indexed file
+  unsigned int next;     // Next table to return from the indexed file
+  FILE *stream;          // Stream from which to read tables
+  unsigned int version;  // Format of the input
+  bool error;            // Set if the input was malformed or unreadable
+
+  // Bytes read from the stream while looking for the magic number
+  uint8_t pending[sizeof(file_header_t)];
+  unsigned int n_pending;
+} table_reader_t;
+
+
+// Read from the stream of a reader, returning any bytes read while looking for
+// the magic number first.
+static inline size_t _table_reader_read(table_reader_t *r, void *buf,
+                                        size_t n)
+{
+  size_t n_pending = (r->n_pending < n) ? r->n_pending : n;
+  memcpy(buf, r->pending, n_pending);
+  r->n_pending -= n_pending;
+  memmove(r->pending, r->pending + n_pending, r->n_pending);
+
+  return n_pending + fread((uint8_t *) buf + n_pending, 1, n - n_pending,
+                           r->stream);
+}
+
+
+// Determine whether a file can be indexed, only compact files cannot be
+static inline bool _table_file_indexable(const char *path)
+{
+  file_header_t h;
+  FILE *f = fopen(path, "rb");
+  bool compact = f != NULL &&
+                 fread(&h, sizeof(file_header_t), 1, f) == 1 &&
+                 h.magic == TABLE_FILE_MAGIC && h.version == 3;
+  if (f != NULL)
+  {
+    fclose(f);
+  }
+
+  return !compact;
+}
+
+
+// Open a source of tables, `-` means stdin. Regular files are indexed and
+// anything else (including compact files) is streamed.
+static inline bool table_reader_open(table_reader_t *r, const char *path)
+{
+  r->indexed = false;
+  r->next = 0;
+  r->stream = NULL;
+  r->version = 1;
+  r->error = false;
+  r->n_pending = 0;
+
+  struct stat st;
+  if (strcmp(path, "-") == 0)
+  {
+    r->stream = stdin;
+  }
+  else if (stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+           _table_file_indexable(path))
+  {
+    r->indexed = true;
+    bool ok = table_file_open(&r->file, path);
+    r->version = r->file.version;
+    return ok;
+  }
+  else
+  {
+    r->stream = fopen(path, "rb");
+    if (r->stream == NULL)
+    {
+      return false;
+    }
+  }
+
+  // Check for the magic number, if it isn't there the bytes read belong to
+  // the first table of a version 1 stream.
+  file_header_t h;
+  r->n_pending = fread(&h, 1, sizeof(file_header_t), r->stream);
+  memcpy(r->pending, &h, r->n_pending);
+  if (r->n_pending == sizeof(file_header_t) && h.magic == TABLE_FILE_MAGIC)
+  {
+    r->version = h.version;
+    r->n_pending = 0;
+
+    if (r->version != 2 && r->version != 3)
+    {
+      fprintf(stderr, "ERROR: Unsupported file version %u\n", r->version);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+// Close a source of tables
+static inline void table_reader_close(table_reader_t *r)
+{
+  if (r->indexed)
+  {
+    table_file_close(&r->file);
+  }
+  else if (r->stream != stdin)
+  {
+    fclose(r->stream);
+  }
+}
+
+
+// Get the number of tables which will be read, or 0 if this isn't known in
+// advance.
+static inline unsigned int table_reader_count(table_reader_t *r)
+{
+  return r->indexed ? r->file.n_tables : 0;
+}
+
+
+// Read a varint from the stream of a reader, returns the number of bytes read
+// or 0 on failure.
+static inline unsigned int _table_reader_get(table_reader_t *r,
+                                             uint32_t *value)
+{
+  *value = 0;
+  for (unsigned int n = 0; n < 5; n++)
+  {
+    uint8_t byte;
+    if (_table_reader_read(r, &byte, 1) != 1)
+    {
+      return 0;
+    }
+
+    *value |= (uint32_t) (byte & 0x7f) << (7 * n);
+    if (!(byte & 0x80))
+    {
+      return n + 1;
+    }
+  }
+
+  return 0;
+}
+
+
+// Read `n` bytes from the stream of a reader into newly allocated memory, or
+// return NULL if the stream ends first (or memory could not be allocated).
+// Memory is allocated as the bytes arrive, so a corrupt length causes an
+// error rather than a huge allocation.
+static inline void* _table_reader_read_new(table_reader_t *r, size_t n)
+{
+  size_t capacity = (n < _TABLE_FILE_CHUNK) ? n : _TABLE_FILE_CHUNK;
+  uint8_t *data = malloc(capacity ? capacity : 1);
+  size_t n_read = 0;
+  while (data != NULL && n_read < n)
+  {
+    if (n_read == capacity)
+    {
+      capacity = (2 * capacity < n) ? 2 * capacity : n;
+      uint8_t *grown = realloc(data, capacity);
+      if (grown == NULL)
+      {
+        free(data);
+        data = NULL;
+        break;
+      }
+      data = grown;
+    }
+
+    size_t n_new = _table_reader_read(r, data + n_read, capacity - n_read);
+    if (n_new == 0)
+    {
+      fprintf(stderr, "ERROR: Incomplete routing table\n");
+      free(data);
+      return NULL;
+    }
+    n_read += n_new;
+  }
+
+  if (data == NULL)
+  {
+    fprintf(stderr, "ERROR: Out of memory reading routing table\n");
+  }
+  return data;
+}
+
+
+// Read the next table from a compact stream
+static inline bool _table_reader_next_compact(table_reader_t *r,
+                                              chip_table_t *chip)
+{
+  // The stream may only end before the first byte of a table, once it has
+  // been read it is put back to be read again as part of the header.
+  uint8_t first;
+  if (_table_reader_read(r, &first, 1) != 1)
+  {
+    r->error = ferror(r->stream);
+    return false;
+  }
+  r->pending[0] = first;
+  r->n_pending = 1;
+
+  // Read the header
+
+  uint32_t x, y, size, n_bytes;
+  if (!_table_reader_get(r, &x) || !_table_reader_get(r, &y) ||
+      !_table_reader_get(r, &size) || !_table_reader_get(r, &n_bytes))
+  {
+    fprintf(stderr, "ERROR: Incomplete routing table\n");
+    r->error = true;
+    return false;
+  }
+  chip->x = x;
+  chip->y = y;
+  chip->table.size = size;
+
+  // Every entry takes at least four bytes
+  if (size > TABLE_FILE_MAX_ENTRIES || size > n_bytes / 4)
+  {
+    fprintf(stderr, "ERROR: Corrupt routing table\n");
+    r->error = true;
+    return false;
+  }
+
+  // Read and decode the entries
+  uint8_t *data = _table_reader_read_new(r, n_bytes);
+  if (data == NULL)
+  {
+    r->error = true;
+    return false;
+  }
+
+  chip->table.entries = malloc(sizeof(entry_t) * (size ? size : 1));
+  if (chip->table.entries == NULL)
+  {
+    fprintf(stderr, "ERROR: Out of memory reading routing table\n");
+    free(data);
+    r->error = true;
+    return false;
+  }
+
+  if (!compact_decode(data, n_bytes, chip->table.entries, size))
+  {
+    fprintf(stderr, "ERROR: Corrupt routing table\n");
+    free(data);
+    free(chip->table.entries);
+    r->error = true;
+    return false;
+  }
+  free(data);
+
+  return true;
+}
+
+
+// Read the next table, returns false at the end of the input (or if an error
+// occurred, in which case `error` is set). Tables read from a stream must be
+// passed to `table_reader_release` once they are no longer required.
+static inline bool table_reader_next(table_reader_t *r, chip_table_t *chip)
+{
+  if (r->indexed)
+  {
+    if (r->next == r->file.n_tables)
+    {
+      return false;
+    }
+
+    *chip = r->file.tables[r->next++];
+    return true;
+  }
+
+  if (r->version == 3)
+  {
+    return _table_reader_next_compact(r, chip);
+  }
+
+  // Read the header of the table
+  size_t n_header, n_read;
+  if (r->version == 1)
+  {
+    header_t h;
+    n_header = sizeof(header_t);
+    n_read = _table_reader_read(r, &h, n_header);
+    chip->x = h.x;
+    chip->y = h.y;
+    chip->table.size = h.length;
+  }
+  else
+  {
+    header_v2_t h;
+    n_header = sizeof(header_v2_t);
+    n_read = _table_reader_read(r, &h, n_header);
+    chip->x = h.x;
+    chip->y = h.y;
+    chip->table.size = h.length;
+
+    if (n_read == n_header &&
+        h.x == TABLE_FILE_FOOTER && h.y == TABLE_FILE_FOOTER)
+    {
+      return false;  // The remainder of the stream is the index
+    }
+  }
+
+  if (n_read != n_header)
+  {
+    // Only a partial header, or a failed read, is an error. Version 2 streams
+    // must end with the index.
+    r->error = (n_read != 0) || ferror(r->stream) || r->version == 2;
+    if (r->error)
+    {
+      fprintf(stderr, "ERROR: Incomplete routing table\n");
+    }
+    return false;
+  }
+
+  // Read the entries
+  if (chip->table.size > TABLE_FILE_MAX_ENTRIES)
+  {
+    fprintf(stderr, "ERROR: Corrupt routing table\n");
+    r->error = true;
+    return false;
+  }
+  chip->table.entries = _table_reader_read_new(
+    r, sizeof(entry_t) * chip->table.size
+  );
+  if (chip->table.entries == NULL)
+  {
+    r->error = true;
+    return false;
+  }
+
+  if (r->version == 1)
+  {
+    table_file_swap_fields(chip->table.entries, chip->table.size);
+  }
+
+  return true;
+}
+
+
+// Release a table returned by `table_reader_next`
+static inline void table_reader_release(table_reader_t *r, chip_table_t *chip)
+{
+  if (!r->indexed)
+  {
+    free(chip->table.entries);
+  }
+  chip->table.entries = NULL;
+}
+
+#define __TABLE_FILE_H__
+#endif  // __TABLE_FILE_H__
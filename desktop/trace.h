@@ -0,0 +1,115 @@
+/* Trace files of Ordered Covering iterations.
+ *
+ * Every iteration of Ordered Covering on every chip is written to the trace
+ * file (see oc_trace.h), either as CSV with a header line:
+ *
+ *    x,y,iteration,table_size,goodness,route,generality,n_aliases,elapsed_ns
+ *
+ * or as binary: TRACE_MAGIC (uint32) followed by a `trace_entry_t` for each
+ * iteration. Records are buffered and written under a lock, so there is very
+ * little cost to tracing beyond the stdio buffer copy.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "oc_trace.h"
+
+#ifndef __TRACE_H__
+
+// Magic number at the start of binary trace files, "RTBT"
+#define TRACE_MAGIC 0x54425452
+
+
+// Entry of a binary trace file
+typedef struct _trace_entry_t
+{
+  uint16_t x, y;             // Chip whose table is being minimised
+  uint32_t _padding;
+  oc_trace_record_t record;  // The iteration
+} trace_entry_t;
+
+
+typedef struct _trace_t
+{
+  FILE *f;
+  bool csv;  // CSV rather than binary
+  pthread_mutex_t lock;
+} trace_t;
+
+
+// State of the tracing of a single table
+typedef struct _trace_table_t
+{
+  trace_t *t;
+  uint16_t x, y;
+  struct timespec start;  // Time at which minimisation began
+} trace_table_t;
+
+
+// Start a trace file
+static inline bool trace_init(trace_t *t, FILE *f, bool csv)
+{
+  t->f = f;
+  t->csv = csv;
+  pthread_mutex_init(&t->lock, NULL);
+
+  if (csv)
+  {
+    return fprintf(f, "x,y,iteration,table_size,goodness,route,generality,"
+                      "n_aliases,elapsed_ns\n") > 0;
+  }
+  else
+  {
+    uint32_t magic = TRACE_MAGIC;
+    return fwrite(&magic, sizeof(magic), 1, f) == 1;
+  }
+}
+
+
+static inline void trace_delete(trace_t *t)
+{
+  pthread_mutex_destroy(&t->lock);
+}
+
+
+// Prepare to trace the minimisation of the table of a chip
+static inline trace_table_t trace_table(trace_t *t, unsigned int x,
+                                        unsigned int y)
+{
+  trace_table_t tt = {t, x, y, {0, 0}};
+  clock_gettime(CLOCK_MONOTONIC, &tt.start);
+  return tt;
+}
+
+
+// Write a trace record, matches `oc_trace_t` with `arg` pointing to a
+// `trace_table_t`.
+static inline void trace_write(oc_trace_record_t *record, void *arg)
+{
+  trace_table_t *tt = arg;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  record->elapsed_ns = (uint64_t) (now.tv_sec - tt->start.tv_sec) *
+                       1000000000ull + now.tv_nsec - tt->start.tv_nsec;
+
+  pthread_mutex_lock(&tt->t->lock);
+  if (tt->t->csv)
+  {
+    fprintf(tt->t->f, "%u,%u,%u,%u,%u,0x%08x,%u,%u,%llu\n", tt->x, tt->y,
+            record->iteration, record->table_size, record->goodness,
+            record->route, record->generality, record->n_aliases,
+            (unsigned long long) record->elapsed_ns);
+  }
+  else
+  {
+    trace_entry_t e = {tt->x, tt->y, 0, *record};
+    fwrite(&e, sizeof(e), 1, tt->t->f);
+  }
+  pthread_mutex_unlock(&tt->t->lock);
+}
+
+#define __TRACE_H__
+#endif  // __TRACE_H__
@@ -0,0 +1,92 @@
+/* Verification of minimised routing tables.
+ *
+ * Wraps a minimisation function so that every table it minimises is checked
+ * for equivalence with the original (see equivalence.h). Tables which fail
+ * are reported, with a key which they route differently, and counted.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "routing_table.h"
+#include "equivalence.h"
+#include "batch.h"
+
+#ifndef __VERIFY_H__
+
+typedef struct _verify_t
+{
+  batch_minimise_t minimise;  // Minimisation function being verified
+  void *arg;                  // Argument for the minimisation function
+
+  unsigned int n_verified;    // Number of tables checked
+  unsigned int n_failed;      // Number of tables which were not equivalent
+  pthread_mutex_t lock;
+} verify_t;
+
+
+static inline void verify_init(verify_t *v, batch_minimise_t minimise,
+                               void *arg)
+{
+  v->minimise = minimise;
+  v->arg = arg;
+  v->n_verified = v->n_failed = 0;
+  pthread_mutex_init(&v->lock, NULL);
+}
+
+
+static inline void verify_delete(verify_t *v)
+{
+  pthread_mutex_destroy(&v->lock);
+}
+
+
+// Minimise a table and check the result against the original. Matches
+// `batch_minimise_t` with `arg` pointing to the verifier; tables which could
+// not be minimised (or copied) are not checked.
+static inline bool verify_minimise(table_t *table, void *arg)
+{
+  verify_t *v = arg;
+
+  // Keep a copy of the original, the table is minimised in place
+  table_t original = {table->size, malloc(sizeof(entry_t) * table->size)};
+  if (original.entries == NULL && table->size > 0)
+  {
+    return false;
+  }
+  memcpy(original.entries, table->entries, sizeof(entry_t) * table->size);
+
+  if (!v->minimise(table, v->arg))
+  {
+    free(original.entries);
+    return false;
+  }
+  equivalence_t e = equivalence_check(&original, table);
+  free(original.entries);
+
+  pthread_mutex_lock(&v->lock);
+  v->n_verified++;
+  if (!e.equivalent)
+  {
+    v->n_failed++;
+
+    chip_table_t *chip = batch_current_chip();
+    fprintf(stderr, "ERROR: (%u, %u) routes key 0x%08x to 0x%08x, not "
+                    "0x%08x\n", chip->x, chip->y, e.key,
+            e.matched ? e.route : 0, e.original);
+  }
+  pthread_mutex_unlock(&v->lock);
+  return true;
+}
+
+
+// Print a summary of the verification
+static inline void verify_report(verify_t *v, FILE *log)
+{
+  fprintf(log, "Verify: %u tables checked, %u not equivalent\n",
+          v->n_verified, v->n_failed);
+}
+
+#define __VERIFY_H__
+#endif  // __VERIFY_H__
@@ -0,0 +1,274 @@
+/* Merge histories from which tables are warm-started.
+ *
+ * Neighbouring chips usually have similar tables, so the merges applied to
+ * one table are a good place to start minimising the next (see
+ * `oc_minimise_warm`). Tables are not minimised in the order of their chips
+ * (workers take the largest waiting table first), so the merges applied to
+ * every finished table are kept, by chip, and each table is warm-started
+ * from the nearest chip which has finished. Histories are kept until every
+ * table has been minimised. Tables read from a cache (see `cache.h`) are not
+ * minimised, so have no history and are not recorded.
+ *
+ * Finished chips are indexed by a grid of cells of `WARM_CELL_SIZE` x
+ * `WARM_CELL_SIZE` chips, so the nearest chip is found by searching outwards
+ * from the cell of the new chip rather than by looking at every chip.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include "merge_history.h"
+
+#ifndef __WARM_H__
+
+// Cells of the grid are 8 x 8 chips
+#define WARM_CELL_BITS 3
+#define WARM_CELL_SIZE (1 << WARM_CELL_BITS)
+
+// Marks the end of the list of chips in a cell, and cells which are unused
+#define WARM_NONE UINT_MAX
+
+typedef struct _warm_chip_t
+{
+  unsigned int x, y;       // Chip co-ordinates
+  unsigned int next;       // Previous chip to finish in the same cell
+  merge_history_t merges;  // Merges applied to the table of the chip
+} warm_chip_t;
+
+
+typedef struct _warm_cell_t
+{
+  unsigned int x, y;       // Cell co-ordinates
+  unsigned int last;       // Last chip to finish in the cell, or WARM_NONE
+} warm_cell_t;
+
+
+typedef struct _warm_t
+{
+  unsigned int n_chips;    // Number of chips which have finished
+  unsigned int capacity;   // Number of chips which may be stored
+  warm_chip_t *chips;      // Finished chips, in the order they finished
+
+  // Cells containing finished chips, a hash table (with linear probing) of
+  // `n_cells` used cells. The extent of the used cells bounds the search.
+  unsigned int n_cells, cell_capacity;
+  warm_cell_t *cells;
+  unsigned int min_x, min_y, max_x, max_y;
+
+  pthread_rwlock_t lock;
+} warm_t;
+
+
+static inline void warm_init(warm_t *w)
+{
+  w->n_chips = w->capacity = 0;
+  w->chips = NULL;
+  w->n_cells = w->cell_capacity = 0;
+  w->cells = NULL;
+  w->min_x = w->min_y = w->max_x = w->max_y = 0;
+  pthread_rwlock_init(&w->lock, NULL);
+}
+
+
+static inline void warm_delete(warm_t *w)
+{
+  for (unsigned int i = 0; i < w->n_chips; i++)
+  {
+    merge_history_delete(&w->chips[i].merges);
+  }
+  free(w->chips);
+  free(w->cells);
+  w->chips = NULL;
+  w->cells = NULL;
+  w->n_chips = w->capacity = 0;
+  w->n_cells = w->cell_capacity = 0;
+  pthread_rwlock_destroy(&w->lock);
+}
+
+
+// Get the slot of a cell in the hash table, which is unused if the cell
+// contains no chips. The table must have at least one unused slot.
+static inline warm_cell_t *_warm_cell(warm_cell_t *cells,
+                                      unsigned int capacity,
+                                      unsigned int x, unsigned int y)
+{
+  unsigned int i = (x * 0x9e3779b1u ^ y * 0x85ebca6bu) & (capacity - 1);
+  while (cells[i].last != WARM_NONE && (cells[i].x != x || cells[i].y != y))
+  {
+    i = (i + 1) & (capacity - 1);
+  }
+  return &cells[i];
+}
+
+
+// Find the chip in a cell nearest to the given chip, updating `best` and
+// `best_distance` if it is nearer (or as near and finished earlier).
+static inline void _warm_search_cell(warm_t *w, unsigned int cell_x,
+                                     unsigned int cell_y, unsigned int x,
+                                     unsigned int y, unsigned int *best,
+                                     unsigned int *best_distance)
+{
+  warm_cell_t *cell = _warm_cell(w->cells, w->cell_capacity, cell_x, cell_y);
+  for (unsigned int i = cell->last; i != WARM_NONE; i = w->chips[i].next)
+  {
+    unsigned int distance = abs((int) w->chips[i].x - (int) x) +
+                            abs((int) w->chips[i].y - (int) y);
+    if (*best == WARM_NONE || distance < *best_distance ||
+        (distance == *best_distance && i < *best))
+    {
+      *best = i;
+      *best_distance = distance;
+    }
+  }
+}
+
+
+// Get the merges applied to the finished chip nearest (by Manhattan distance)
+// to the given chip, the earliest to finish if several are as near. Returns
+// false if no chip has finished. The history remains owned by `w` and must
+// not be modified.
+static inline bool warm_nearest(warm_t *w, unsigned int x, unsigned int y,
+                                merge_history_t *merges)
+{
+  pthread_rwlock_rdlock(&w->lock);
+  unsigned int best = WARM_NONE, best_distance = 0;
+
+  // Search rings of cells around the cell of the chip. Chips in the ring `r`
+  // cells away are at least `(r - 1) * WARM_CELL_SIZE + 1` chips away, so
+  // the search stops once no further ring could hold a chip as near as the
+  // best so far, or once the rings cover every used cell.
+  int cx = x >> WARM_CELL_BITS, cy = y >> WARM_CELL_BITS;
+  int min_x = w->min_x, min_y = w->min_y, max_x = w->max_x, max_y = w->max_y;
+  for (int r = 0; w->n_chips > 0; r++)
+  {
+    for (int i = (cx - r > min_x) ? cx - r : min_x;
+         i <= cx + r && i <= max_x; i++)
+    {
+      // Visit every cell of the ring's left and right columns, but only the
+      // top and bottom cells of the other columns.
+      int step = (i == cx - r || i == cx + r) ? 1 : 2 * r;
+      for (int j = cy - r; j <= cy + r && j <= max_y; j += step)
+      {
+        if (j >= min_y)
+        {
+          _warm_search_cell(w, i, j, x, y, &best, &best_distance);
+        }
+      }
+    }
+
+    if ((best != WARM_NONE &&
+         best_distance <= (unsigned int) r * WARM_CELL_SIZE) ||
+        (cx - r <= min_x && cx + r >= max_x &&
+         cy - r <= min_y && cy + r >= max_y))
+    {
+      break;
+    }
+  }
+
+  // The merges of a history are never moved or freed until `warm_delete`, so
+  // the copy may be used without holding the lock.
+  bool found = best != WARM_NONE;
+  if (found)
+  {
+    *merges = w->chips[best].merges;
+  }
+  pthread_rwlock_unlock(&w->lock);
+  return found;
+}
+
+
+// Make space for another chip and (possibly) another cell, returns false if
+// memory could not be allocated. Must be called with the lock held.
+static inline bool _warm_reserve(warm_t *w)
+{
+  if (w->n_chips == w->capacity)
+  {
+    unsigned int capacity = 2 * w->capacity + 16;
+    warm_chip_t *chips = realloc(w->chips, sizeof(warm_chip_t) * capacity);
+    if (chips == NULL)
+    {
+      return false;
+    }
+    w->chips = chips;
+    w->capacity = capacity;
+  }
+
+  // Keep the hash table at most half full
+  if (2 * (w->n_cells + 1) > w->cell_capacity)
+  {
+    unsigned int capacity = w->cell_capacity ? 2 * w->cell_capacity : 64;
+    warm_cell_t *cells = malloc(sizeof(warm_cell_t) * capacity);
+    if (cells == NULL)
+    {
+      return false;
+    }
+    for (unsigned int i = 0; i < capacity; i++)
+    {
+      cells[i].last = WARM_NONE;
+    }
+
+    for (unsigned int i = 0; i < w->cell_capacity; i++)
+    {
+      if (w->cells[i].last != WARM_NONE)
+      {
+        *_warm_cell(cells, capacity, w->cells[i].x, w->cells[i].y) =
+          w->cells[i];
+      }
+    }
+    free(w->cells);
+    w->cells = cells;
+    w->cell_capacity = capacity;
+  }
+
+  return true;
+}
+
+
+// Store the merges applied to the table of a chip, the history is then owned
+// by `w`. Returns false if memory could not be allocated, in which case the
+// history is freed.
+static inline bool warm_add(warm_t *w, unsigned int x, unsigned int y,
+                            merge_history_t merges)
+{
+  pthread_rwlock_wrlock(&w->lock);
+  if (!_warm_reserve(w))
+  {
+    pthread_rwlock_unlock(&w->lock);
+    merge_history_delete(&merges);
+    return false;
+  }
+
+  // Add the chip to the front of the list of its cell
+  unsigned int cx = x >> WARM_CELL_BITS, cy = y >> WARM_CELL_BITS;
+  warm_cell_t *cell = _warm_cell(w->cells, w->cell_capacity, cx, cy);
+  if (cell->last == WARM_NONE)
+  {
+    cell->x = cx;
+    cell->y = cy;
+    w->n_cells++;
+  }
+
+  unsigned int i = w->n_chips++;
+  w->chips[i].x = x;
+  w->chips[i].y = y;
+  w->chips[i].next = cell->last;
+  w->chips[i].merges = merges;
+  cell->last = i;
+
+  // Extend the area to be searched
+  if (i == 0)
+  {
+    w->min_x = w->max_x = cx;
+    w->min_y = w->max_y = cy;
+  }
+  w->min_x = (cx < w->min_x) ? cx : w->min_x;
+  w->max_x = (cx > w->max_x) ? cx : w->max_x;
+  w->min_y = (cy < w->min_y) ? cy : w->min_y;
+  w->max_y = (cy > w->max_y) ? cy : w->max_y;
+
+  pthread_rwlock_unlock(&w->lock);
+  return true;
+}
+
+#define __WARM_H__
+#endif  // __WARM_H__
@@ -125,13 +125,14 @@ typedef struct _node_t
 typedef struct _aliases_t
 {
   node_t *root;
+  unsigned int count;  // Number of keys which have a value
 } aliases_t;
 
 
 // Create a new, empty, aliases container
 static inline aliases_t aliases_init(void)
 {
-  aliases_t aliases = {NULL};
+  aliases_t aliases = {NULL, 0};
   return aliases;
 }
 
@@ -275,6 +276,10 @@ static inline node_t* _aliases_insert(node_t *n, akey_t key, alias_list_t *val)
 // Add/overwrite an element into an aliases tree
 static inline void aliases_insert(aliases_t *a, keymask_t key, alias_list_t *value)
 {
+  // Keep count of the keys with values
+  a->count += (value != NULL);
+  a->count -= aliases_contains(a, key);
+
   // Insert into, and balance, the tree
   a->root = _aliases_insert(a->root, (akey_t) key, value);
 }
@@ -286,9 +291,10 @@ static inline void aliases_remove(aliases_t *a, keymask_t key)
   // XXX This is a hack which removes the reference to the element in the tree
   // but doesn't remove the Node from the tree.
   node_t *n = _aliases_find_node(a->root, (akey_t) key);
-  if (n != NULL)
+  if (n != NULL && n->val != NULL)
   {
     n->val = NULL;
+    a->count--;
   }
 }
 
@@ -326,6 +332,7 @@ static inline void _aliases_clear(node_t *n)
 static inline void aliases_clear(aliases_t *a)
 {
   _aliases_clear(a->root);
+  *a = aliases_init();
 }
 
 /*****************************************************************************/
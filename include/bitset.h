@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "platform.h"
 
 #ifndef __BITSET_H__
@@ -17,10 +18,7 @@ typedef struct _bitset_t
 static inline bool bitset_clear(bitset_t* b)
 {
   // Clear the data
-  for (unsigned int i = 0; i < b->n_words; i++)
-  {
-    b->_data[i] = 0x0;
-  }
+  memset(b->_data, 0, b->n_words * sizeof(uint32_t));
 
   // Reset the count
   b->count = 0;
@@ -42,6 +40,9 @@ static inline bool bitset_init(bitset_t* b, unsigned int length)
   uint32_t* data = (uint32_t*) MALLOC(n_words * sizeof(uint32_t));
   if (data == NULL)
   {
+    // Leave an empty set, which may still be safely queried and deleted
+    b->_data = NULL;
+    b->n_words = b->n_elements = 0;
     return false;
   }
   else
@@ -76,8 +77,13 @@ static inline bool bitset_add(bitset_t* b, unsigned int i)
   unsigned int word = i / 32;
   unsigned int bit  = 1 << (i & 31);
 
-  b->_data[word] |= bit;  // Set the word and bit
-  b->count++;             // Increment the count of set elements
+  // Increment the count of set elements if the element wasn't already in the
+  // set, then set the word and bit.
+  if (!(b->_data[word] & bit))
+  {
+    b->count++;
+  }
+  b->_data[word] |= bit;
   return true;
 }
 
@@ -116,5 +122,142 @@ static inline bool bitset_remove(bitset_t* b, unsigned int i)
   }
 }
 
+// Get the first element at or after `i` which is in a bitset, returns
+// `n_elements` if there are no further elements in the set.
+//
+// Members can be iterated over with:
+//
+//     for (unsigned int i = bitset_next_set(b, 0);
+//          i < b->n_elements;
+//          i = bitset_next_set(b, i + 1))
+static inline unsigned int bitset_next_set(bitset_t* b, unsigned int i)
+{
+  if (b->n_elements <= i)
+  {
+    return b->n_elements;
+  }
+
+  // Mask out the bits of the first word which come before `i`
+  unsigned int word = i / 32;
+  uint32_t bits = b->_data[word] & (0xffffffff << (i & 31));
+
+  // Skip empty words
+  while (bits == 0x0)
+  {
+    if (++word >= b->n_words)
+    {
+      return b->n_elements;
+    }
+    bits = b->_data[word];
+  }
+
+  return word * 32 + __builtin_ctz(bits);
+}
+
+
+// Get the last element before `i` which is in a bitset, returns `n_elements`
+// if there are no earlier elements in the set.
+//
+// Members can be iterated over, last first, with:
+//
+//     for (unsigned int i = bitset_prev_set(b, b->n_elements);
+//          i < b->n_elements;
+//          i = bitset_prev_set(b, i))
+static inline unsigned int bitset_prev_set(bitset_t* b, unsigned int i)
+{
+  i = (i < b->n_elements) ? i : b->n_elements;
+  if (i == 0)
+  {
+    return b->n_elements;
+  }
+
+  // Mask out the bits of the last word which come at or after `i`
+  unsigned int word = (i - 1) / 32;
+  uint32_t bits = b->_data[word] & (0xffffffff >> (31 - ((i - 1) & 31)));
+
+  // Skip empty words
+  while (bits == 0x0)
+  {
+    if (word-- == 0)
+    {
+      return b->n_elements;
+    }
+    bits = b->_data[word];
+  }
+
+  return word * 32 + 31 - __builtin_clz(bits);
+}
+
+
+// Recompute the count of elements in a bitset from its data
+static inline unsigned int bitset_recount(bitset_t* b)
+{
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < b->n_words; i++)
+  {
+    count += __builtin_popcount(b->_data[i]);
+  }
+
+  b->count = count;
+  return count;
+}
+
+
+// Store the intersection of two bitsets in a third (which may be either of
+// the first two). All bitsets must be of the same size.
+static inline bool bitset_and(bitset_t* dest, bitset_t* a, bitset_t* b)
+{
+  if (dest->n_words != a->n_words || dest->n_words != b->n_words)
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < dest->n_words; i++)
+  {
+    dest->_data[i] = a->_data[i] & b->_data[i];
+  }
+  bitset_recount(dest);
+
+  return true;
+}
+
+
+// Store the union of two bitsets in a third (which may be either of the first
+// two). All bitsets must be of the same size.
+static inline bool bitset_or(bitset_t* dest, bitset_t* a, bitset_t* b)
+{
+  if (dest->n_words != a->n_words || dest->n_words != b->n_words)
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < dest->n_words; i++)
+  {
+    dest->_data[i] = a->_data[i] | b->_data[i];
+  }
+  bitset_recount(dest);
+
+  return true;
+}
+
+
+// Store the elements of `a` which are not in `b` in a third bitset (which may
+// be either of the first two). All bitsets must be of the same size.
+static inline bool bitset_andnot(bitset_t* dest, bitset_t* a, bitset_t* b)
+{
+  if (dest->n_words != a->n_words || dest->n_words != b->n_words)
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < dest->n_words; i++)
+  {
+    dest->_data[i] = a->_data[i] & ~b->_data[i];
+  }
+  bitset_recount(dest);
+
+  return true;
+}
+
 #define __BITSET_H__
 #endif  // __BITSET_H__
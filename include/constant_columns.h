@@ -0,0 +1,369 @@
+/* Constant column elimination.
+ *
+ * Bit positions which are the same in every entry of a table (always 0, always
+ * 1 or always X) play no part in minimisation. Keys and masks can be
+ * compressed down to just the varying bit positions, minimised, and expanded
+ * back out again afterwards.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "platform.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "merge_history.h"
+#include "ordered_covering.h"
+#include "snapshot.h"
+#include "mtrie.h"
+
+#ifndef __CONSTANT_COLUMNS_H__
+
+typedef struct _column_map_t
+{
+  uint32_t varying;     // Bit positions which differ between entries
+  uint32_t fixed;       // Bit positions which are always 0 or always 1
+  uint32_t ones;        // Bit positions which are always 1
+  unsigned int n_bits;  // Number of varying bit positions
+} column_map_t;
+
+
+// Determine which bit positions of a table are constant
+static inline column_map_t columns_get_map(table_t *table)
+{
+  // Start by assuming every bit is 1, 0 and X in every entry and then remove
+  // bits as they are contradicted.
+  uint32_t ones = 0xffffffff, zeros = 0xffffffff, xs = 0xffffffff;
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    keymask_t km = table->entries[i].keymask;
+    ones  &=  km.key &  km.mask;
+    zeros &= ~km.key &  km.mask;
+    xs    &= ~km.key & ~km.mask;
+  }
+
+  column_map_t map;
+  if (table->size == 0)
+  {
+    // An empty table has no varying bits (and nothing to restore)
+    map.varying = map.fixed = map.ones = 0x0;
+  }
+  else
+  {
+    map.fixed = ones | zeros;
+    map.ones = ones;
+    map.varying = ~(map.fixed | xs);
+  }
+  map.n_bits = __builtin_popcount(map.varying);
+
+  return map;
+}
+
+
+// Gather the bits of a value selected by a mask into the least significant
+// bits of the result.
+static inline uint32_t _columns_extract(uint32_t value, uint32_t select)
+{
+  uint32_t result = 0x0;
+  for (uint32_t out = 1; select; out <<= 1)
+  {
+    if (value & select & -select)  // Is the lowest selected bit set?
+    {
+      result |= out;
+    }
+    select &= select - 1;  // Move onto the next selected bit
+  }
+
+  return result;
+}
+
+
+// Scatter the least significant bits of a value into the bits selected by a
+// mask.
+static inline uint32_t _columns_deposit(uint32_t value, uint32_t select)
+{
+  uint32_t result = 0x0;
+  for (uint32_t in = 1; select; in <<= 1)
+  {
+    if (value & in)
+    {
+      result |= select & -select;  // Set the lowest selected bit
+    }
+    select &= select - 1;  // Move onto the next selected bit
+  }
+
+  return result;
+}
+
+
+// Compress a keymask into the varying bits of the map. Unused bits of the
+// result are set to 0 (rather than X) so that the generality of the keymask
+// is unchanged.
+static inline keymask_t columns_compress_keymask(keymask_t km,
+                                                 column_map_t *map)
+{
+  uint32_t padding = (map->n_bits == 32) ? 0x0 : 0xffffffff << map->n_bits;
+
+  keymask_t result;
+  result.key = _columns_extract(km.key, map->varying);
+  result.mask = _columns_extract(km.mask, map->varying) | padding;
+  return result;
+}
+
+
+// Expand a compressed keymask, restoring the constant bits
+static inline keymask_t columns_expand_keymask(keymask_t km, column_map_t *map)
+{
+  keymask_t result;
+  result.key = _columns_deposit(km.key, map->varying) | map->ones;
+  result.mask = _columns_deposit(km.mask, map->varying) | map->fixed;
+  return result;
+}
+
+
+// Compress every entry in a table
+static inline void columns_compress(table_t *table, column_map_t *map)
+{
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    table->entries[i].keymask = columns_compress_keymask(
+      table->entries[i].keymask, map);
+  }
+}
+
+
+// Expand every entry in a table
+static inline void columns_expand(table_t *table, column_map_t *map)
+{
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    table->entries[i].keymask = columns_expand_keymask(
+      table->entries[i].keymask, map);
+  }
+}
+
+
+// Move every alias list from an aliases tree into a new tree, compressing or
+// expanding the keys and the elements of the lists as we go.
+static inline void _columns_map_aliases(node_t *n, aliases_t *out,
+                                        column_map_t *map, bool expand)
+{
+  if (n == NULL)
+  {
+    return;
+  }
+
+  _columns_map_aliases(n->left, out, map, expand);
+  _columns_map_aliases(n->right, out, map, expand);
+
+  // Nodes which have been removed from the tree have no value
+  if (n->val != NULL)
+  {
+    for (alias_list_t *l = n->val; l != NULL; l = l->next)
+    {
+      for (unsigned int i = 0; i < l->n_elements; i++)
+      {
+        alias_element_t *e = &(&l->data)[i];
+        e->keymask = expand ? columns_expand_keymask(e->keymask, map) :
+                              columns_compress_keymask(e->keymask, map);
+      }
+    }
+
+    keymask_t km = expand ? columns_expand_keymask(n->key.km, map) :
+                            columns_compress_keymask(n->key.km, map);
+    aliases_insert(out, km, n->val);
+  }
+
+  FREE(n);
+}
+
+
+// Compress every keymask held in an aliases tree
+static inline void columns_compress_aliases(aliases_t *aliases,
+                                            column_map_t *map)
+{
+  aliases_t out = aliases_init();
+  _columns_map_aliases(aliases->root, &out, map, false);
+  *aliases = out;
+}
+
+
+// Expand every keymask held in an aliases tree
+static inline void columns_expand_aliases(aliases_t *aliases,
+                                          column_map_t *map)
+{
+  aliases_t out = aliases_init();
+  _columns_map_aliases(aliases->root, &out, map, true);
+  *aliases = out;
+}
+
+
+// Apply ordered covering to a routing table with the constant columns removed,
+// replaying and recording merge histories as `oc_minimise_warm`. Histories
+// always contain uncompressed keymasks.
+static inline void columns_oc_minimise_warm(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  merge_history_t *history,
+  merge_history_t *record
+)
+{
+  column_map_t map = columns_get_map(table);
+  if (map.n_bits == 32)
+  {
+    // Nothing to remove
+    oc_minimise_warm(table, target_length, aliases, history, record);
+    return;
+  }
+
+  // Compress the history to be replayed
+  merge_history_t compressed = merge_history_init();
+  if (history != NULL)
+  {
+    for (unsigned int i = 0; i < history->n_merges; i++)
+    {
+      merge_history_append(
+        &compressed,
+        columns_compress_keymask(history->merges[i].keymask, &map),
+        history->merges[i].route
+      );
+    }
+  }
+
+  // Compress, minimise and then expand the table and aliases
+  columns_compress(table, &map);
+  columns_compress_aliases(aliases, &map);
+
+  unsigned int n_recorded = (record != NULL) ? record->n_merges : 0;
+  oc_minimise_warm(table, target_length, aliases,
+                   (history != NULL) ? &compressed : NULL, record);
+
+  columns_expand(table, &map);
+  columns_expand_aliases(aliases, &map);
+
+  // Expand any newly recorded merges
+  for (unsigned int i = n_recorded; record != NULL && i < record->n_merges;
+       i++)
+  {
+    record->merges[i].keymask = columns_expand_keymask(
+      record->merges[i].keymask, &map);
+  }
+
+  merge_history_delete(&compressed);
+}
+
+
+// Apply ordered covering to a routing table with the constant columns removed
+static inline void columns_oc_minimise(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases
+)
+{
+  columns_oc_minimise_warm(table, target_length, aliases, NULL, NULL);
+}
+
+
+// Apply ordered covering to a routing table with the constant columns removed,
+// calling `checkpoint` after every merge. The checkpointed table and aliases
+// have the constant columns removed; a snapshot of them (which may be NULL)
+// taken while minimising the same table is restored before minimising.
+// Returns true if the snapshot was restored.
+static inline bool columns_oc_minimise_checkpointed(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  oc_checkpoint_t checkpoint,
+  void *arg,
+  uint32_t *snapshot,
+  unsigned int n_words
+)
+{
+  column_map_t map = columns_get_map(table);
+
+  columns_compress(table, &map);
+  columns_compress_aliases(aliases, &map);
+
+  // Snapshots are never larger than the table they were taken from
+  bool resumed = snapshot != NULL &&
+                 snapshot_read(snapshot, n_words, table, table->size, aliases);
+  oc_minimise_checkpointed(table, target_length, aliases, checkpoint, arg);
+
+  columns_expand(table, &map);
+  columns_expand_aliases(aliases, &map);
+
+  return resumed;
+}
+
+
+typedef struct _columns_trace_t
+{
+  oc_trace_t trace;
+  void *arg;
+  unsigned int n_xs;  // Number of bit positions which are always X
+} _columns_trace_t;
+
+
+// Add the removed X columns back into the generality of traced merges
+static inline void _columns_trace(oc_trace_record_t *record, void *arg)
+{
+  _columns_trace_t *t = arg;
+  record->generality += t->n_xs;
+  t->trace(record, t->arg);
+}
+
+
+// Apply ordered covering to a routing table with the constant columns removed,
+// passing a record of each iteration to `trace`.
+static inline void columns_oc_minimise_traced(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  oc_trace_t trace,
+  void *arg
+)
+{
+  column_map_t map = columns_get_map(table);
+  _columns_trace_t t = {
+    trace, arg, 32 - map.n_bits - __builtin_popcount(map.fixed)
+  };
+
+  columns_compress(table, &map);
+  columns_compress_aliases(aliases, &map);
+
+  oc_minimise_traced(table, target_length, aliases, _columns_trace, &t);
+
+  columns_expand(table, &map);
+  columns_expand_aliases(aliases, &map);
+}
+
+
+// Apply m-Trie minimisation to a routing table with the constant columns
+// removed, the resulting tries only have as many levels as there are varying
+// bits.
+static inline void columns_mtrie_minimise(table_t *table)
+{
+  column_map_t map = columns_get_map(table);
+
+  columns_compress(table, &map);
+  _mtrie_minimise(table, NULL, map.n_bits);
+  columns_expand(table, &map);
+}
+
+
+// As `columns_mtrie_minimise`, building the tries from shared nodes (see
+// `mtrie_minimise_shared`).
+static inline void columns_mtrie_minimise_shared(table_t *table)
+{
+  column_map_t map = columns_get_map(table);
+  mtrie_pool_t pool;
+  mtrie_pool_init(&pool);
+
+  columns_compress(table, &map);
+  _mtrie_minimise(table, &pool, map.n_bits);
+  columns_expand(table, &map);
+
+  mtrie_pool_delete(&pool);
+}
+
+#define __CONSTANT_COLUMNS_H__
+#endif  // __CONSTANT_COLUMNS_H__
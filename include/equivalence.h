@@ -0,0 +1,207 @@
+/* Functional equivalence of routing tables.
+ *
+ * A minimised table is equivalent to the original if first-match lookup
+ * routes every key in the same direction as the original does, except that:
+ *
+ *  - keys which match no entry of the original may be routed anywhere (or
+ *    nowhere), and
+ *  - keys whose first match in the original is default-routable (see
+ *    `remove_default_routes.h`) may match no entry of the minimised table.
+ *
+ * Rather than trying every key, the keyspace is split recursively: a region
+ * (itself a keymask) is checked against the entries of each table which
+ * intersect it, in order. Once the first such entry of both tables covers the
+ * whole region their routes can be compared directly; otherwise the region is
+ * split on a bit which one of those entries fixes but the region does not.
+ * Entries following one which covers the region can never be reached from
+ * it and are dropped, so the lists of entries shrink quickly as the regions
+ * do.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "platform.h"
+#include "routing_table.h"
+
+#ifndef __EQUIVALENCE_H__
+
+typedef struct _equivalence_t
+{
+  bool equivalent;    // Whether the tables are equivalent
+
+  // A key which is routed differently, if the tables are not equivalent
+  uint32_t key;
+  uint32_t original;  // Route of the key in the original table
+  bool matched;       // Whether the key matches the minimised table
+  uint32_t route;     // Route of the key in the minimised table, if matched
+} equivalence_t;
+
+
+// Lists of the indices of the entries of both tables which intersect each
+// region being checked, stacked in the order the regions were split.
+typedef struct _equivalence_stack_t
+{
+  unsigned int *indices;
+  unsigned int size, capacity;
+} equivalence_stack_t;
+
+
+// Determine whether every key in a region matches a keymask
+static inline bool equivalence_covers(keymask_t km, keymask_t region)
+{
+  return (km.mask & ~region.mask) == 0 &&
+         (km.key & km.mask) == (region.key & km.mask);
+}
+
+
+// Determine whether an entry is default-routable, i.e., whether packets
+// arrive on a single link and leave on the opposite link alone.
+static inline bool equivalence_default_routable(entry_t *e)
+{
+  return __builtin_popcount(e->route) == 1 && (e->route & 0x3f) &&
+         __builtin_popcount(e->source) == 1 && (e->source & 0x3f) &&
+         (e->route >> 3) == (e->source & 0x7) &&
+         (e->source >> 3) == (e->route & 0x7);
+}
+
+
+// Copy the entries of a list (the `length` indices on the stack from `start`)
+// which intersect a region onto the top of the stack, stopping after the
+// first which covers it. Returns the length of the new list.
+static inline unsigned int equivalence_filter(equivalence_stack_t *s,
+                                              table_t *table,
+                                              unsigned int start,
+                                              unsigned int length,
+                                              keymask_t region)
+{
+  if (s->size + length > s->capacity)
+  {
+    // Grow the stack, the list being filtered may move
+    unsigned int capacity = 2 * (s->size + length);
+    unsigned int *indices = MALLOC(sizeof(unsigned int) * capacity);
+    memcpy(indices, s->indices, sizeof(unsigned int) * s->size);
+    FREE(s->indices);
+    s->indices = indices;
+    s->capacity = capacity;
+  }
+
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < length; i++)
+  {
+    unsigned int index = s->indices[start + i];
+    keymask_t km = table->entries[index].keymask;
+    if (keymask_intersect(km, region))
+    {
+      s->indices[s->size + n++] = index;
+      if (equivalence_covers(km, region))
+      {
+        break;
+      }
+    }
+  }
+  s->size += n;
+  return n;
+}
+
+
+// Check a region given the lists of entries of each table which intersect
+// it (stored on the stack from `a` and `b` respectively).
+static inline bool _equivalence_check(equivalence_stack_t *s,
+                                      table_t *original, table_t *minimised,
+                                      keymask_t region,
+                                      unsigned int a, unsigned int n_a,
+                                      unsigned int b, unsigned int n_b,
+                                      equivalence_t *result)
+{
+  if (n_a == 0)
+  {
+    // No key in the region matches the original table
+    return true;
+  }
+
+  entry_t *e_a = &original->entries[s->indices[a]];
+  entry_t *e_b = (n_b > 0) ? &minimised->entries[s->indices[b]] : NULL;
+  bool covers_a = equivalence_covers(e_a->keymask, region);
+  bool covers_b = e_b != NULL && equivalence_covers(e_b->keymask, region);
+
+  if (covers_a && (e_b == NULL || covers_b))
+  {
+    // Every key in the region is routed by a single entry of each table
+    if ((e_b == NULL) ? equivalence_default_routable(e_a)
+                      : e_b->route == e_a->route)
+    {
+      return true;
+    }
+
+    result->key = region.key;
+    result->original = e_a->route;
+    result->matched = e_b != NULL;
+    result->route = (e_b != NULL) ? e_b->route : 0;
+    return false;
+  }
+
+  // Split the region on the most significant bit fixed by the first entry
+  // which does not cover it.
+  keymask_t km = covers_a ? e_b->keymask : e_a->keymask;
+  uint32_t bit = 1u << (31 - __builtin_clz(km.mask & ~region.mask));
+
+  unsigned int size = s->size;
+  for (unsigned int value = 0; value < 2; value++)
+  {
+    keymask_t half = {region.key | (value ? bit : 0), region.mask | bit};
+
+    unsigned int a_half = s->size;
+    unsigned int n_a_half = equivalence_filter(s, original, a, n_a, half);
+    unsigned int b_half = s->size;
+    unsigned int n_b_half = equivalence_filter(s, minimised, b, n_b, half);
+
+    if (!_equivalence_check(s, original, minimised, half, a_half, n_a_half,
+                            b_half, n_b_half, result))
+    {
+      return false;
+    }
+    s->size = size;  // Pop the lists of this half
+  }
+
+  return true;
+}
+
+
+// Check whether a minimised table is equivalent to the original, if not the
+// result contains a counterexample.
+static inline equivalence_t equivalence_check(table_t *original,
+                                              table_t *minimised)
+{
+  equivalence_t result = {true, 0, 0, false, 0};
+
+  // Start with the whole keyspace and every entry of both tables
+  equivalence_stack_t s;
+  s.size = original->size + minimised->size;
+  s.capacity = 2 * s.size + 1;
+  s.indices = MALLOC(sizeof(unsigned int) * s.capacity);
+  for (unsigned int i = 0; i < original->size; i++)
+  {
+    s.indices[i] = i;
+  }
+  for (unsigned int i = 0; i < minimised->size; i++)
+  {
+    s.indices[original->size + i] = i;
+  }
+
+  // Filter the lists once so that entries hidden by a catch-all are dropped
+  keymask_t all = {0, 0};
+  unsigned int a = s.size;
+  unsigned int n_a = equivalence_filter(&s, original, 0, original->size,
+                                        all);
+  unsigned int b = s.size;
+  unsigned int n_b = equivalence_filter(&s, minimised, original->size,
+                                        minimised->size, all);
+
+  result.equivalent = _equivalence_check(&s, original, minimised, all,
+                                         a, n_a, b, n_b, &result);
+  FREE(s.indices);
+  return result;
+}
+
+#define __EQUIVALENCE_H__
+#endif  // __EQUIVALENCE_H__
@@ -0,0 +1,478 @@
+/* First-match lookup of keys in routing tables.
+ *
+ * A table is compiled into a decision tree over the bits of keys. Each
+ * internal node selects one of its children by up to `LOOKUP_STRIDE` bits of
+ * the key and each leaf holds a block of (at most `LOOKUP_LEAF_SIZE`) entries
+ * which intersect the keys reaching it, in table order. Every entry of a
+ * block is compared against the key at once, using vector instructions, to
+ * find the first which matches.
+ *
+ * The tree is built in the same way as regions are checked in
+ * `equivalence.h`: the keyspace is split until few enough entries intersect
+ * each region, entries following one which covers a region being dropped.
+ * Regions are split on the bits which most evenly divide their entries.
+ * Entries with an X in a bit being tested are copied into every child, so
+ * the tree for a table of heavily overlapping entries could grow very large;
+ * instead every entry of such a table is scanned (as they are for tables
+ * small enough to fit in a single leaf).
+ *
+ * Lookups of many keys should use `lookup_batch`, which walks the tree for a
+ * number of keys at once so that the loads of their nodes overlap.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+#ifdef __BMI2__
+  #include <immintrin.h>
+#endif
+#include "platform.h"
+#include "routing_table.h"
+#include "equivalence.h"
+
+#ifndef __LOOKUP_H__
+
+// Index returned for keys which match no entry
+#define LOOKUP_MISS UINT32_MAX
+
+// Number of entries compared in a single vector
+#define LOOKUP_LANES 4
+
+// Most entries in a leaf of the tree, a multiple of the number of lanes
+#define LOOKUP_LEAF_SIZE 8
+#define _LOOKUP_LEAF_VECTORS (LOOKUP_LEAF_SIZE / LOOKUP_LANES)
+
+// Most bits of the key tested by a node of the tree
+#define LOOKUP_STRIDE 4
+
+// Most copies of each entry which may be stored in leaves of the tree before
+// the table is scanned instead
+#define LOOKUP_MAX_COPIES 8
+
+// Number of keys whose lookups are interleaved by `lookup_batch`
+#define LOOKUP_BATCH 16
+
+typedef uint32_t lookup_vector_t
+  __attribute__ ((vector_size (sizeof(uint32_t) * LOOKUP_LANES)));
+
+// Block of the entries of a leaf, padded with entries which match no key
+typedef struct _lookup_block_t
+{
+  lookup_vector_t keys[_LOOKUP_LEAF_VECTORS];
+  lookup_vector_t masks[_LOOKUP_LEAF_VECTORS];
+
+  // Index in the table of each entry, followed by LOOKUP_MISS
+  uint32_t indices[LOOKUP_LEAF_SIZE + 1];
+} lookup_block_t;
+
+// Leaf field of internal nodes
+#define _LOOKUP_INTERNAL UINT32_MAX
+
+typedef struct _lookup_node_t
+{
+  uint32_t children;  // First of the children, which are contiguous
+  uint32_t bits;      // Bits of the key which select the child, none for
+                      // leaves (which are their own only child)
+  uint8_t shifts[LOOKUP_STRIDE];  // Right shift of each bit, least
+                                  // significant first, to its place in the
+                                  // index of the child
+  uint32_t leaf;      // Block of the entries of a leaf, or _LOOKUP_INTERNAL
+} lookup_node_t;
+
+typedef struct _lookup_t
+{
+  bool linear;            // Whether every block is scanned rather than the tree
+  uint32_t root;          // Root node of the tree
+  unsigned int depth;     // Greatest depth of a leaf
+
+  lookup_node_t *nodes;
+  unsigned int n_nodes, node_capacity;
+
+  lookup_block_t *blocks;  // Blocks of entries, the first is empty
+  unsigned int n_blocks, block_capacity;
+} lookup_t;
+
+
+// Get the child of a node to which a key belongs
+static inline uint32_t _lookup_child(const lookup_node_t *node, uint32_t key)
+{
+#ifdef __BMI2__
+  return node->children + _pext_u32(key, node->bits);
+#else
+  uint32_t k = key & node->bits;
+  uint32_t child = node->children;
+  for (unsigned int i = 0; i < LOOKUP_STRIDE; i++)
+  {
+    child += (k >> node->shifts[i]) & (1 << i);
+  }
+  return child;
+#endif
+}
+
+
+// Get a mask of the lanes in which a vector comparison was true
+static inline uint32_t _lookup_lanes(lookup_vector_t match)
+{
+#if defined(__SSE2__) && LOOKUP_LANES == 4
+  return _mm_movemask_ps((__m128) match);
+#else
+  uint32_t lanes = 0;
+  for (unsigned int i = 0; i < LOOKUP_LANES; i++)
+  {
+    lanes |= (match[i] & 1) << i;
+  }
+  return lanes;
+#endif
+}
+
+
+// Get the index of the first entry of a block which matches a key, or
+// LOOKUP_MISS.
+static inline uint32_t _lookup_block(const lookup_block_t *b, uint32_t key)
+{
+  uint32_t lanes = 1 << LOOKUP_LEAF_SIZE;  // Selects LOOKUP_MISS
+  for (unsigned int v = 0; v < _LOOKUP_LEAF_VECTORS; v++)
+  {
+    lookup_vector_t match = (lookup_vector_t) ((key & b->masks[v]) ==
+                                               b->keys[v]);
+    lanes |= _lookup_lanes(match) << (v * LOOKUP_LANES);
+  }
+  return b->indices[__builtin_ctz(lanes)];
+}
+
+
+// Scan every block in turn
+static inline uint32_t _lookup_linear(const lookup_t *l, uint32_t key)
+{
+  for (unsigned int b = 0; b < l->n_blocks; b++)
+  {
+    uint32_t index = _lookup_block(&l->blocks[b], key);
+    if (index != LOOKUP_MISS)
+    {
+      return index;
+    }
+  }
+  return LOOKUP_MISS;
+}
+
+
+// Get the index of the first entry of the table which matches a key, or
+// LOOKUP_MISS if there is none.
+static inline uint32_t lookup(const lookup_t *l, uint32_t key)
+{
+  if (l->linear)
+  {
+    return _lookup_linear(l, key);
+  }
+
+  const lookup_node_t *node = &l->nodes[l->root];
+  while (node->leaf == _LOOKUP_INTERNAL)
+  {
+    node = &l->nodes[_lookup_child(node, key)];
+  }
+  return _lookup_block(&l->blocks[node->leaf], key);
+}
+
+
+// Look up a number of keys, writing the index of the first entry matching
+// each (or LOOKUP_MISS) to `indices`.
+static inline void lookup_batch(const lookup_t *l, const uint32_t *keys,
+                                unsigned int n, uint32_t *indices)
+{
+  unsigned int i = 0;
+  for (; !l->linear && i + LOOKUP_BATCH <= n; i += LOOKUP_BATCH)
+  {
+    // Walk the tree for every key in the batch a level at a time, keys which
+    // reach leaves early stay where they are.
+    uint32_t nodes[LOOKUP_BATCH];
+    for (unsigned int k = 0; k < LOOKUP_BATCH; k++)
+    {
+      nodes[k] = l->root;
+    }
+    for (unsigned int depth = 0; depth < l->depth; depth++)
+    {
+      for (unsigned int k = 0; k < LOOKUP_BATCH; k++)
+      {
+        nodes[k] = _lookup_child(&l->nodes[nodes[k]], keys[i + k]);
+      }
+    }
+
+    // Fetch every block before scanning any of them
+    const lookup_block_t *blocks[LOOKUP_BATCH];
+    for (unsigned int k = 0; k < LOOKUP_BATCH; k++)
+    {
+      blocks[k] = &l->blocks[l->nodes[nodes[k]].leaf];
+      __builtin_prefetch(blocks[k]);
+    }
+    for (unsigned int k = 0; k < LOOKUP_BATCH; k++)
+    {
+      indices[i + k] = _lookup_block(blocks[k], keys[i + k]);
+    }
+  }
+
+  // Look up any remaining keys one at a time
+  for (; i < n; i++)
+  {
+    indices[i] = lookup(l, keys[i]);
+  }
+}
+
+
+// Append a block containing a list of entries, returns its index
+static inline unsigned int _lookup_new_block(lookup_t *l, table_t *table,
+                                             const unsigned int *list,
+                                             unsigned int length)
+{
+  if (l->n_blocks == l->block_capacity)
+  {
+    unsigned int capacity = 2 * l->block_capacity + 1;
+    lookup_block_t *blocks = MALLOC(sizeof(lookup_block_t) * capacity);
+    if (l->n_blocks)
+    {
+      memcpy(blocks, l->blocks, sizeof(lookup_block_t) * l->n_blocks);
+    }
+    FREE(l->blocks);
+    l->blocks = blocks;
+    l->block_capacity = capacity;
+  }
+
+  lookup_block_t *b = &l->blocks[l->n_blocks];
+  for (unsigned int i = 0; i < LOOKUP_LEAF_SIZE; i++)
+  {
+    // Padding has a key bit outside its mask and so never matches
+    keymask_t km = {1, 0};
+    if (i < length)
+    {
+      km = table->entries[list[i]].keymask;
+      km.key &= km.mask;
+    }
+    b->keys[i / LOOKUP_LANES][i % LOOKUP_LANES] = km.key;
+    b->masks[i / LOOKUP_LANES][i % LOOKUP_LANES] = km.mask;
+    b->indices[i] = (i < length) ? list[i] : LOOKUP_MISS;
+  }
+  b->indices[LOOKUP_LEAF_SIZE] = LOOKUP_MISS;
+
+  return l->n_blocks++;
+}
+
+
+// Append a number of contiguous nodes, returns the index of the first
+static inline unsigned int _lookup_new_nodes(lookup_t *l, unsigned int n)
+{
+  if (l->n_nodes + n > l->node_capacity)
+  {
+    unsigned int capacity = 2 * (l->n_nodes + n);
+    lookup_node_t *nodes = MALLOC(sizeof(lookup_node_t) * capacity);
+    if (l->n_nodes)
+    {
+      memcpy(nodes, l->nodes, sizeof(lookup_node_t) * l->n_nodes);
+    }
+    FREE(l->nodes);
+    l->nodes = nodes;
+    l->node_capacity = capacity;
+  }
+
+  l->n_nodes += n;
+  return l->n_nodes - n;
+}
+
+
+// Choose the bits on which to split a region, those which leave the fewest
+// entries in the larger half when split on alone. Returns the number of bits
+// chosen.
+static inline unsigned int _lookup_split_bits(table_t *table,
+                                              const unsigned int *list,
+                                              unsigned int length,
+                                              keymask_t region,
+                                              unsigned int n_bits,
+                                              uint32_t *bits)
+{
+  unsigned int n_0[32] = {0}, n_1[32] = {0};
+  for (unsigned int i = 0; i < length; i++)
+  {
+    keymask_t km = table->entries[list[i]].keymask;
+    for (uint32_t fixed = km.mask & ~region.mask; fixed; fixed &= fixed - 1)
+    {
+      unsigned int bit = __builtin_ctz(fixed);
+      if (km.key & (1u << bit))
+      {
+        n_1[bit]++;
+      }
+      else
+      {
+        n_0[bit]++;
+      }
+    }
+  }
+
+  // Choose the best bit repeatedly, preferring more significant bits when
+  // halves are equally large.
+  *bits = 0;
+  unsigned int n = 0;
+  for (; n < n_bits; n++)
+  {
+    int best = -1;
+    unsigned int best_size = 0;
+    for (int bit = 31; bit >= 0; bit--)
+    {
+      unsigned int n_x = length - n_0[bit] - n_1[bit];
+      unsigned int size = n_x + ((n_0[bit] > n_1[bit]) ? n_0[bit] : n_1[bit]);
+      if (n_x < length && !(*bits & (1u << bit)) &&
+          (best < 0 || size < best_size))
+      {
+        best = bit;
+        best_size = size;
+      }
+    }
+
+    if (best < 0)
+    {
+      break;  // No bits left which any entry fixes
+    }
+    *bits |= 1u << best;
+  }
+  return n;
+}
+
+
+// Build the tree for a region in the given node from the list of entries
+// which intersect the region (on the stack from `start`). Returns false if
+// too many copies of entries would be made.
+static inline bool _lookup_build(lookup_t *l, equivalence_stack_t *s,
+                                 table_t *table, keymask_t region,
+                                 unsigned int start, unsigned int length,
+                                 uint32_t node, unsigned int depth,
+                                 unsigned int *copies)
+{
+  if (length <= LOOKUP_LEAF_SIZE)
+  {
+    *copies += length;
+    if (*copies > LOOKUP_MAX_COPIES * table->size)
+    {
+      return false;
+    }
+
+    // Leaves are still walked by `lookup_batch` (until the deepest leaf is
+    // reached) and test no bits, so every shift must be valid. Leaves without
+    // entries share the empty block.
+    l->depth = (depth > l->depth) ? depth : l->depth;
+    l->nodes[node].children = node;
+    l->nodes[node].bits = 0;
+    memset(l->nodes[node].shifts, 0, sizeof(l->nodes[node].shifts));
+    l->nodes[node].leaf = length ?
+      _lookup_new_block(l, table, &s->indices[start], length) : 0;
+    return true;
+  }
+
+  // Test only as many bits as are needed to divide the entries into leaves.
+  // Every entry fixes a bit which the region does not, otherwise the first
+  // would cover the region and be the last in the list.
+  unsigned int n_bits = 1;
+  while (n_bits < LOOKUP_STRIDE && (length >> n_bits) > LOOKUP_LEAF_SIZE)
+  {
+    n_bits++;
+  }
+  uint32_t bits;
+  n_bits = _lookup_split_bits(table, &s->indices[start], length, region,
+                              n_bits, &bits);
+
+  // Bit `i` of the index of a child is the `i`th least significant bit
+  // tested, shifted into place by `shifts[i]`. Unused shifts move a bit
+  // which is not tested into place instead.
+  uint8_t shifts[LOOKUP_STRIDE];
+  uint32_t remaining = bits;
+  for (unsigned int i = 0; i < LOOKUP_STRIDE; i++)
+  {
+    uint32_t untested = ~(bits | ((1u << i) - 1));
+    shifts[i] = __builtin_ctz(remaining ? remaining : untested) - i;
+    remaining &= remaining - 1;
+  }
+
+  // The nodes may move while the children are built
+  unsigned int children = _lookup_new_nodes(l, 1 << n_bits);
+  l->nodes[node].children = children;
+  l->nodes[node].bits = bits;
+  memcpy(l->nodes[node].shifts, shifts, sizeof(shifts));
+  l->nodes[node].leaf = _LOOKUP_INTERNAL;
+
+  unsigned int size = s->size;
+  for (unsigned int child = 0; child < (1u << n_bits); child++)
+  {
+    keymask_t sub = region;
+    sub.mask |= bits;
+    for (unsigned int i = 0; i < n_bits; i++)
+    {
+      sub.key |= ((child >> i) & 1) << (shifts[i] + i);
+    }
+
+    unsigned int sub_start = s->size;
+    unsigned int sub_length = equivalence_filter(s, table, start, length,
+                                                 sub);
+    if (!_lookup_build(l, s, table, sub, sub_start, sub_length,
+                       children + child, depth + 1, copies))
+    {
+      return false;
+    }
+    s->size = size;  // Pop the list of this child
+  }
+
+  return true;
+}
+
+
+// Compile a table for lookups, the table may not be changed while it is
+// being used.
+static inline lookup_t lookup_init(table_t *table)
+{
+  lookup_t l = {false, 0, 0, NULL, 0, 0, NULL, 0, 0};
+  _lookup_new_block(&l, table, NULL, 0);
+
+  // Start with the entries not hidden behind a catch-all
+  equivalence_stack_t s;
+  s.size = table->size;
+  s.capacity = 2 * s.size + 1;
+  s.indices = MALLOC(sizeof(unsigned int) * s.capacity);
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    s.indices[i] = i;
+  }
+  keymask_t all = {0, 0};
+  unsigned int start = s.size;
+  unsigned int length = equivalence_filter(&s, table, 0, table->size, all);
+
+  unsigned int copies = 0;
+  l.root = _lookup_new_nodes(&l, 1);
+  if (!_lookup_build(&l, &s, table, all, start, length, l.root, 0, &copies))
+  {
+    // Scan blocks of every entry instead
+    l.linear = true;
+    l.n_nodes = l.n_blocks = 0;
+    l.depth = 0;
+    for (unsigned int i = 0; i < length; i += LOOKUP_LEAF_SIZE)
+    {
+      unsigned int n = length - i;
+      _lookup_new_block(&l, table, &s.indices[start + i],
+                        (n < LOOKUP_LEAF_SIZE) ? n : LOOKUP_LEAF_SIZE);
+    }
+  }
+
+  FREE(s.indices);
+  return l;
+}
+
+
+// Free the memory used by a compiled table
+static inline void lookup_delete(lookup_t *l)
+{
+  FREE(l->nodes);
+  FREE(l->blocks);
+  l->nodes = NULL;
+  l->blocks = NULL;
+  l->n_nodes = l->node_capacity = 0;
+  l->n_blocks = l->block_capacity = 0;
+}
+
+#define __LOOKUP_H__
+#endif  // __LOOKUP_H__
@@ -101,25 +101,24 @@ static inline void merge_remove(merge_t* m, unsigned int i)
     m->source = 0x0;
     m->keymask.key  = 0xffffffff;
     m->keymask.mask = 0x000000000;
-    for (unsigned int j = 0; j < m->table->size; j++)
+    for (unsigned int j = bitset_next_set(&(m->entries), 0);
+         j < m->entries.n_elements;
+         j = bitset_next_set(&(m->entries), j + 1))
     {
       entry_t e = m->table->entries[j];
 
-      if (bitset_contains(&(m->entries), j))
+      m->route |= e.route;
+      m->source |= e.source;
+      if (m->keymask.key  == 0xffffffff && m->keymask.mask == 0x00000000)
       {
-        m->route |= e.route;
-        m->source |= e.source;
-        if (m->keymask.key  == 0xffffffff && m->keymask.mask == 0x00000000)
-        {
-          // Initialise the keymask
-          m->keymask.key  = e.keymask.key;
-          m->keymask.mask = e.keymask.mask;
-        }
-        else
-        {
-          // Merge the keymask
-          m->keymask = keymask_merge(m->keymask, e.keymask);
-        }
+        // Initialise the keymask
+        m->keymask.key  = e.keymask.key;
+        m->keymask.mask = e.keymask.mask;
+      }
+      else
+      {
+        // Merge the keymask
+        m->keymask = keymask_merge(m->keymask, e.keymask);
       }
     }
   }
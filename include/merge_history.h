@@ -0,0 +1,89 @@
+/* History of the merges applied by Ordered Covering.
+ *
+ * Each merge is recorded as the keymask and route of the entry it produced.
+ * A history recorded while minimising one table can be replayed against a
+ * similar table (see `oc_minimise_warm`) to avoid searching for the same
+ * merges again.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "platform.h"
+#include "routing_table.h"
+
+#ifndef __MERGE_HISTORY_H__
+
+typedef struct _merge_record_t
+{
+  keymask_t keymask;  // Keymask of the entry resulting from the merge
+  uint32_t route;     // Route of the merged entries
+} merge_record_t;
+
+
+typedef struct _merge_history_t
+{
+  unsigned int n_merges;   // Number of merges in the history
+  unsigned int capacity;   // Number of merges which may be stored
+  merge_record_t *merges;  // Merges in the order they were applied
+} merge_history_t;
+
+
+// Create a new, empty, history
+static inline merge_history_t merge_history_init(void)
+{
+  merge_history_t h = {0, 0, NULL};
+  return h;
+}
+
+
+// Free the memory used by a history
+static inline void merge_history_delete(merge_history_t *h)
+{
+  if (h->merges != NULL)
+  {
+    FREE(h->merges);
+  }
+  *h = merge_history_init();
+}
+
+
+// Remove every merge from a history, keeping its memory for reuse
+static inline void merge_history_clear(merge_history_t *h)
+{
+  h->n_merges = 0;
+}
+
+
+// Add a merge to the end of a history
+static inline void merge_history_append(merge_history_t *h, keymask_t km,
+                                        uint32_t route)
+{
+  if (h->n_merges == h->capacity)
+  {
+    // Double the space available to the history
+    h->capacity = h->capacity ? h->capacity * 2 : 16;
+    merge_record_t *merges = MALLOC(sizeof(merge_record_t) * h->capacity);
+    if (h->merges != NULL)
+    {
+      memcpy(merges, h->merges, sizeof(merge_record_t) * h->n_merges);
+      FREE(h->merges);
+    }
+    h->merges = merges;
+  }
+
+  h->merges[h->n_merges].keymask = km;
+  h->merges[h->n_merges].route = route;
+  h->n_merges++;
+}
+
+
+// Determine whether a keymask is contained within the keymask of a recorded
+// merge, i.e., whether the merged entry could have been produced from it.
+static inline bool merge_record_covers(merge_record_t *r, keymask_t km)
+{
+  return (km.mask & r->keymask.mask) == r->keymask.mask &&
+         (km.key & r->keymask.mask) == (r->keymask.key & r->keymask.mask);
+}
+
+#define __MERGE_HISTORY_H__
+#endif  // __MERGE_HISTORY_H__
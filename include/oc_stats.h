@@ -0,0 +1,107 @@
+/* Operation counters and phase timers for Ordered Covering.
+ *
+ * When compiled with OC_STATS defined, Ordered Covering counts the work done
+ * in its hot paths and times each of its phases in `oc_stats`. Every thread
+ * has its own counters, which are never reset by Ordered Covering itself.
+ * Without OC_STATS the macros below expand to nothing and there is no cost.
+ *
+ * Counters are per translation unit: code compiled separately (e.g.,
+ * librig_rt) keeps its own.
+ *
+ * When compiled with OC_PHASE_HOOKS defined, `oc_phase_enter` and
+ * `oc_phase_exit` (which must be defined by the program) are also called on
+ * entering and leaving each phase, e.g., to read hardware counters.
+ */
+#include <stdint.h>
+
+#ifndef __OC_STATS_H__
+
+// Phases of Ordered Covering which are timed
+typedef enum _oc_phase_t
+{
+  OC_PHASE_GROUP,      // Grouping entries by route to form merges
+  OC_PHASE_DOWNCHECK,  // Removing entries from merges which cover others
+  OC_PHASE_UPCHECK,    // Removing entries from merges which are covered
+  OC_PHASE_APPLY,      // Rewriting the table and aliases to apply a merge
+  OC_N_PHASES
+} oc_phase_t;
+
+
+typedef struct _oc_stats_t
+{
+  uint64_t intersect_tests;         // Number of keymask intersection tests
+  uint64_t downcheck_rounds;        // Number of iterations of the downcheck
+  uint64_t alias_elements_scanned;  // Aliases checked by the downcheck
+  uint64_t merges_applied;          // Number of merges applied to the table
+  uint64_t bytes_moved;             // Bytes of table entries copied
+
+  uint64_t phase_ns[OC_N_PHASES];   // Time spent in each phase
+} oc_stats_t;
+
+
+#ifdef OC_PHASE_HOOKS
+  void oc_phase_enter(oc_phase_t phase);
+  void oc_phase_exit(oc_phase_t phase);
+
+  #define _OC_PHASE_ENTER(phase) oc_phase_enter(phase)
+  #define _OC_PHASE_EXIT(phase) oc_phase_exit(phase)
+#else
+  #define _OC_PHASE_ENTER(phase) ((void) 0)
+  #define _OC_PHASE_EXIT(phase) ((void) 0)
+#endif
+
+
+#ifdef OC_STATS
+  #ifdef SPINNAKER
+    #error "OC_STATS requires a monotonic clock, unavailable on SpiNNaker"
+  #endif
+
+  #include <string.h>
+  #include <time.h>
+
+  // Counters of the current thread
+  static __thread oc_stats_t oc_stats;
+
+  static inline uint64_t oc_stats_now(void)
+  {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+  }
+
+  // Zero the counters of the current thread
+  static inline void oc_stats_reset(void)
+  {
+    memset(&oc_stats, 0, sizeof(oc_stats));
+  }
+
+  // Time phases, excluding the time taken by any hooks
+  #define OC_STATS_ADD(counter, n) (oc_stats.counter += (n))
+  #define OC_STATS_START(phase, timer) \
+    _OC_PHASE_ENTER(phase); \
+    uint64_t _oc_timer_##timer = oc_stats_now()
+  #define OC_STATS_STOP(phase, timer) \
+    (oc_stats.phase_ns[phase] += oc_stats_now() - _oc_timer_##timer, \
+     _OC_PHASE_EXIT(phase))
+#else
+  static inline void oc_stats_reset(void)
+  {
+  }
+
+  #define OC_STATS_ADD(counter, n) do {} while (0)
+  #define OC_STATS_START(phase, timer) _OC_PHASE_ENTER(phase)
+  #define OC_STATS_STOP(phase, timer) _OC_PHASE_EXIT(phase)
+#endif
+
+
+// Get the name of a phase
+static inline const char* oc_phase_name(oc_phase_t phase)
+{
+  static const char *names[OC_N_PHASES] = {
+    "group", "downcheck", "upcheck", "apply"
+  };
+  return names[phase];
+}
+
+#define __OC_STATS_H__
+#endif  // __OC_STATS_H__
@@ -0,0 +1,28 @@
+/* Per-iteration trace of Ordered Covering.
+ *
+ * `oc_minimise_traced` passes a record to a sink after every merge it
+ * applies, describing the merge and the state of the table afterwards. The
+ * sink decides what to do with it (e.g., write it to a file), and fills in
+ * the time at which the iteration finished if it wants it.
+ */
+#include <stdint.h>
+
+#ifndef __OC_TRACE_H__
+
+typedef struct _oc_trace_record_t
+{
+  uint32_t iteration;   // Number of merges applied before this one
+  uint32_t table_size;  // Size of the table after the merge
+  uint32_t goodness;    // Goodness of the merge
+  uint32_t route;       // Route of the merged entries
+  uint32_t generality;  // Number of Xs in the keymask of the merged entry
+  uint32_t n_aliases;   // Number of entries in the table with aliases
+  uint64_t elapsed_ns;  // Time since minimisation began, set by the sink
+} oc_trace_record_t;
+
+
+// Sink of trace records
+typedef void (*oc_trace_t)(oc_trace_record_t *record, void *arg);
+
+#define __OC_TRACE_H__
+#endif  // __OC_TRACE_H__
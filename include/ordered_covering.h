@@ -1,6 +1,9 @@
 #include "aliases.h"
 #include "bitset.h"
 #include "merge.h"
+#include "merge_history.h"
+#include "oc_stats.h"
+#include "oc_trace.h"
 #include "routing_table.h"
 
 #ifndef __ORDERED_COVERING_H__
@@ -61,24 +64,19 @@ static inline unsigned int oc_get_insertion_point(
 // entries if they were included in the given merge.
 static inline bool oc_upcheck(merge_t *m, int min_goodness)
 {
+  OC_STATS_START(OC_PHASE_UPCHECK, upcheck);
   min_goodness = (min_goodness > 0) ? min_goodness : 0;
   bool changed = false;  // Track whether we remove any entries
   // Get the point where the merge will be inserted into the table.
   unsigned int generality = keymask_count_xs(m->keymask);
   unsigned int insertion_index = oc_get_insertion_point(m->table, generality);
 
-  // For every entry in the merge check that the entry would not be covered by
-  // any existing entries if it were to be merged.
-  for (unsigned int _i = m->table->size, i = m->table->size - 1;
-       _i > 0 && merge_goodness(m) > min_goodness;
-       _i--, i--)
+  // For every entry in the merge, last first, check that the entry would not
+  // be covered by any existing entries if it were to be merged.
+  for (unsigned int i = bitset_prev_set(&m->entries, m->table->size);
+       i < m->entries.n_elements && merge_goodness(m) > min_goodness;
+       i = bitset_prev_set(&m->entries, i))
   {
-    if (!merge_contains(m, i))
-    {
-      // If this entry is not contained within the merge skip it
-      continue;
-    }
-
     // Get the keymask for this entry
     keymask_t km = m->table->entries[i].keymask;
 
@@ -87,6 +85,7 @@ static inline bool oc_upcheck(merge_t *m, int min_goodness)
     for (unsigned int j = i + 1; j < insertion_index; j++)
     {
       keymask_t other_km = m->table->entries[j].keymask;
+      OC_STATS_ADD(intersect_tests, 1);
 
       // If the key masks intersect then remove this entry from the merge and
       // recalculate the insertion index.
@@ -108,6 +107,7 @@ static inline bool oc_upcheck(merge_t *m, int min_goodness)
     merge_clear(m);
   }
 
+  OC_STATS_STOP(OC_PHASE_UPCHECK, upcheck);
   return changed;
 }
 
@@ -170,14 +170,10 @@ static inline __sets_t _get_removables(
     // a X or a 0 or 1 (as specified by `to_one`) to the working set of entries
     // to remove.
     unsigned int entry = 0;
-    for (unsigned int i = 0; i < m->table->size; i++)
+    for (unsigned int i = bitset_next_set(&m->entries, 0);
+         i < m->entries.n_elements;
+         i = bitset_next_set(&m->entries, i + 1))
     {
-      // Skip if this isn't an entry
-      if (!merge_contains(m, i))
-      {
-        continue;
-      }
-
       // See if this entry should be removed
       keymask_t km = m->table->entries[i].keymask;
       if (
@@ -210,15 +206,14 @@ static inline __sets_t _get_removables(
 }
 
 
-// Remove entries from a merge such that the merge would not cover existing
-// entries positioned below the merge.
-static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
+static inline void _oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
 {
   min_goodness = (min_goodness > 0) ? min_goodness : 0;
   table_t *table = m->table;  // Retrieve the table
 
   while (merge_goodness(m) > min_goodness)
   {
+    OC_STATS_ADD(downcheck_rounds, 1);
     bool covered_entries = false;  // Record if there were any covered entries
     unsigned int stringency = 33;  // Not at all stringent
     uint32_t set_to_zero = 0x0;    // Mask of which bits could be set to zero
@@ -234,6 +229,7 @@ static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
          i++)
     {
       keymask_t km = table->entries[i].keymask;
+      OC_STATS_ADD(intersect_tests, 1);
       if (keymask_intersect(km, m->keymask))
       {
         if (!aliases_contains(a, km))
@@ -249,6 +245,8 @@ static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
           alias_list_t *l = aliases_find(a, km);
           while (l != NULL)
           {
+            OC_STATS_ADD(alias_elements_scanned, l->n_elements);
+            OC_STATS_ADD(intersect_tests, l->n_elements);
             for (unsigned int j = 0; j < l->n_elements; j++)
             {
               km = alias_list_get(l, j).keymask;
@@ -292,17 +290,17 @@ static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
     sets = _get_removables(m, set_to_one, true, sets);
 
     // Remove the specified entries
+    // NOTE: `best` is indexed by position in the merge; removing the current
+    // entry doesn't change the position of the entries which follow it.
     unsigned int entry = 0;
-    for (unsigned int i = 0; i < m->table->size; i++)
+    for (unsigned int i = bitset_next_set(&m->entries, 0);
+         i < m->entries.n_elements;
+         i = bitset_next_set(&m->entries, i + 1), entry++)
     {
-      if (merge_contains(m, i))
+      if (bitset_contains(sets.best, entry))
       {
-        if (bitset_contains(sets.best, entry))
-        {
-          // Remove this entry from the merge
-          merge_remove(m, i);
-        }
-        entry++;
+        // Remove this entry from the merge
+        merge_remove(m, i);
       }
     }
 
@@ -319,6 +317,16 @@ static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
 }
 
 
+// Remove entries from a merge such that the merge would not cover existing
+// entries positioned below the merge.
+static inline void oc_downcheck(merge_t *m, int min_goodness, aliases_t *a)
+{
+  OC_STATS_START(OC_PHASE_DOWNCHECK, downcheck);
+  _oc_downcheck(m, min_goodness, a);
+  OC_STATS_STOP(OC_PHASE_DOWNCHECK, downcheck);
+}
+
+
 // Get the best merge which can be applied to a routing table
 static inline merge_t oc_get_best_merge(table_t* table, aliases_t *aliases)
 {
@@ -349,6 +357,7 @@ static inline merge_t oc_get_best_merge(table_t* table, aliases_t *aliases)
     entry_t entry = table->entries[i];  // Get the entry
 
     // Try to merge with other entries
+    OC_STATS_START(OC_PHASE_GROUP, group);
     for (unsigned int j = i+1; j < table->size; j++)
     {
       entry_t other = table->entries[j];  // Get the other entry
@@ -359,6 +368,7 @@ static inline merge_t oc_get_best_merge(table_t* table, aliases_t *aliases)
         bitset_add(&considered, j);  // Mark the other entry as considered
       }
     }
+    OC_STATS_STOP(OC_PHASE_GROUP, group);
 
     if (merge_goodness(&working) <= merge_goodness(&best))
     {
@@ -409,6 +419,9 @@ static inline merge_t oc_get_best_merge(table_t* table, aliases_t *aliases)
 // Apply a merge to the table against which it is defined
 static inline void oc_merge_apply(merge_t *m, aliases_t *aliases)
 {
+  OC_STATS_START(OC_PHASE_APPLY, apply);
+  OC_STATS_ADD(merges_applied, 1);
+
   // Get the new entry
   entry_t new_entry;
   new_entry.keymask = m->keymask;
@@ -441,6 +454,7 @@ static inline void oc_merge_apply(merge_t *m, aliases_t *aliases)
     {
       table->entries[insert] = new_entry;
       insert++;
+      OC_STATS_ADD(bytes_moved, sizeof(entry_t));
     }
 
     if (!merge_contains(m, remove))
@@ -449,6 +463,7 @@ static inline void oc_merge_apply(merge_t *m, aliases_t *aliases)
       // current position to its new position.
       table->entries[insert] = current;
       insert++;
+      OC_STATS_ADD(bytes_moved, sizeof(entry_t));
     }
     else
     {
@@ -480,23 +495,100 @@ static inline void oc_merge_apply(merge_t *m, aliases_t *aliases)
   if (insertion_point == table->size)
   {
     table->entries[insert] = new_entry;
+    OC_STATS_ADD(bytes_moved, sizeof(entry_t));
   }
 
   // Record the new size of the table
   table->size = new_size;
+  OC_STATS_STOP(OC_PHASE_APPLY, apply);
 }
 
 
-// Apply the ordered covering algorithm to a routing table
-// Minimise the table until either the table is shorter than the target length
-// or no more merges are possible.
-static inline void oc_minimise(
+// Replay a history of merges against a routing table
+// Each merge is rebuilt from the entries of the table which have the same
+// route and which are covered by the recorded keymask. The merge is then
+// checked as if it had been found by `oc_get_best_merge` and applied if any
+// of it remains. Merges which are applied are added to `record` (which may be
+// NULL).
+static inline void oc_replay(
   table_t *table,
   unsigned int target_length,
-  aliases_t *aliases
+  aliases_t *aliases,
+  merge_history_t *history,
+  merge_history_t *record
 )
 {
-  while (table->size > target_length)
+  for (unsigned int r = 0;
+       r < history->n_merges && table->size > target_length;
+       r++)
+  {
+    merge_record_t *rec = &history->merges[r];
+
+    // Rebuild the merge from the current table
+    merge_t merge;
+    merge_init(&merge, table);
+    for (unsigned int i = 0; i < table->size; i++)
+    {
+      if (table->entries[i].route == rec->route &&
+          merge_record_covers(rec, table->entries[i].keymask))
+      {
+        merge_add(&merge, i);
+      }
+    }
+
+    // Check the merge in the same way as `oc_get_best_merge`
+    if (merge_goodness(&merge) > 0)
+    {
+      oc_downcheck(&merge, 0, aliases);
+      if (oc_upcheck(&merge, 0))
+      {
+        oc_downcheck(&merge, 0, aliases);
+      }
+    }
+
+    // Apply whatever remains of the merge
+    if (merge.entries.count > 1)
+    {
+      if (record != NULL)
+      {
+        merge_history_append(record, merge.keymask, merge.route);
+      }
+      oc_merge_apply(&merge, aliases);
+    }
+
+    merge_delete(&merge);
+  }
+}
+
+
+// Called by `oc_minimise_checkpointed` after each merge with the partially
+// minimised table and its aliases, which must not be modified.
+typedef void (*oc_checkpoint_t)(table_t *table, aliases_t *aliases,
+                                void *arg);
+
+
+// What `_oc_minimise` does after each merge, any of which may be NULL
+typedef struct _oc_hooks_t
+{
+  merge_history_t *record;     // History to which each merge is added
+  oc_checkpoint_t checkpoint;  // Called with the table and aliases
+  void *checkpoint_arg;
+  oc_trace_t trace;            // Called with a record of the iteration
+  void *trace_arg;
+} _oc_hooks_t;
+
+
+// Apply merges to a routing table until it is shorter than the target length
+// or no more merges are possible, calling the hooks after each merge.
+static inline void _oc_minimise(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  _oc_hooks_t *hooks
+)
+{
+  merge_history_t *record = hooks->record;
+  for (unsigned int iteration = 0; table->size > target_length; iteration++)
   {
     // Get the best possible merge, if this merge is empty then break out of
     // the loop.
@@ -507,9 +599,22 @@ static inline void oc_minimise(
     {
       // Apply the merge to the table if it would result in merging actually
       // occurring.
+      if (record != NULL)
+      {
+        merge_history_append(record, merge.keymask, merge.route);
+      }
       oc_merge_apply(&merge, aliases);
     }
 
+    if (count > 1 && hooks->trace != NULL)
+    {
+      oc_trace_record_t r = {
+        iteration, table->size, merge_goodness(&merge), merge.route,
+        keymask_count_xs(merge.keymask), aliases->count, 0
+      };
+      hooks->trace(&r, hooks->trace_arg);
+    }
+
     // Free any memory used by the merge
     merge_delete(&merge);
 
@@ -519,9 +624,349 @@ static inline void oc_minimise(
     {
       break;
     }
+
+    if (hooks->checkpoint != NULL)
+    {
+      hooks->checkpoint(table, aliases, hooks->checkpoint_arg);
+    }
   }
 }
 
 
+// Apply the ordered covering algorithm to a routing table, starting by
+// replaying the merges in `history` (which may be NULL) and recording every
+// merge which is applied in `record` (which may also be NULL).
+// Minimise the table until either the table is shorter than the target length
+// or no more merges are possible.
+static inline void oc_minimise_warm(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  merge_history_t *history,
+  merge_history_t *record
+)
+{
+  if (history != NULL)
+  {
+    oc_replay(table, target_length, aliases, history, record);
+  }
+
+  _oc_hooks_t hooks = {record, NULL, NULL, NULL, NULL};
+  _oc_minimise(table, target_length, aliases, &hooks);
+}
+
+
+// Apply the ordered covering algorithm to a routing table, calling
+// `checkpoint` after every merge so that the progress can be saved (see
+// snapshot.h).
+// The table and aliases are the entire state of the algorithm, so
+// minimisation is resumed by calling this again with the saved table and
+// aliases.
+static inline void oc_minimise_checkpointed(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  oc_checkpoint_t checkpoint,
+  void *arg
+)
+{
+  _oc_hooks_t hooks = {NULL, checkpoint, arg, NULL, NULL};
+  _oc_minimise(table, target_length, aliases, &hooks);
+}
+
+
+// Apply the ordered covering algorithm to a routing table, passing a record
+// of each iteration to `trace` (see oc_trace.h).
+static inline void oc_minimise_traced(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  oc_trace_t trace,
+  void *arg
+)
+{
+  _oc_hooks_t hooks = {NULL, NULL, NULL, trace, arg};
+  _oc_minimise(table, target_length, aliases, &hooks);
+}
+
+
+// Apply the ordered covering algorithm to a routing table
+// Minimise the table until either the table is shorter than the target length
+// or no more merges are possible.
+static inline void oc_minimise(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases
+)
+{
+  oc_minimise_warm(table, target_length, aliases, NULL, NULL);
+}
+
+
+// Determine whether an entry is one of a set of entries
+static inline bool _oc_entry_in(table_t *entries, keymask_t km, uint32_t route)
+{
+  for (unsigned int i = 0; i < entries->size; i++)
+  {
+    if (entries->entries[i].keymask.key == km.key &&
+        entries->entries[i].keymask.mask == km.mask &&
+        entries->entries[i].route == route)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// Determine whether an entry of a minimised table must be expanded back into
+// the entries which were merged to form it before the table can be updated.
+// This is the case if it was formed from a deleted entry or if it intersects
+// an inserted entry.
+static inline bool _oc_must_expand(entry_t *entry, alias_list_t *l,
+                                   table_t *inserted, table_t *deleted)
+{
+  for (unsigned int i = 0; i < inserted->size; i++)
+  {
+    if (keymask_intersect(entry->keymask, inserted->entries[i].keymask))
+    {
+      return true;
+    }
+  }
+
+  for (; l != NULL; l = l->next)
+  {
+    for (unsigned int i = 0; i < l->n_elements; i++)
+    {
+      if (_oc_entry_in(deleted, alias_list_get(l, i).keymask, entry->route))
+      {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+// Sort entries by key, and entries with equal keys by mask, using a scratch
+// array of the same size (a radix sort of 8 bits at a time).
+static inline void _oc_sort_by_key(entry_t *entries, entry_t *scratch,
+                                   unsigned int n)
+{
+  entry_t *from = entries, *to = scratch;
+  for (unsigned int pass = 0; pass < 8; pass++)
+  {
+    unsigned int shift = 8 * (pass % 4);
+    bool by_key = pass >= 4;
+
+    // Count the entries with each value of the digit and then where the
+    // entries with each value start.
+    unsigned int next[256] = {0};
+    for (unsigned int i = 0; i < n; i++)
+    {
+      keymask_t km = from[i].keymask;
+      next[((by_key ? km.key : km.mask) >> shift) & 0xff]++;
+    }
+    for (unsigned int d = 0, start = 0; d < 256; d++)
+    {
+      unsigned int count = next[d];
+      next[d] = start;
+      start += count;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+      keymask_t km = from[i].keymask;
+      to[next[((by_key ? km.key : km.mask) >> shift) & 0xff]++] = from[i];
+    }
+
+    // An even number of passes leaves the entries back in `entries`
+    entry_t *t = from;
+    from = to;
+    to = t;
+  }
+}
+
+
+// Get the (MALLOCed) entries of a minimised table once it has been updated:
+// merged entries which must be expanded are replaced by the entries they were
+// formed from, deleted entries are removed and inserted entries are added. The
+// aliases of the expanded entries are removed from `aliases`. If `all` is true
+// every merged entry is expanded, giving the updated original table, and
+// `aliases` is left unchanged. The new entries are sorted by generality (and,
+// if `all` is true, then by key and mask so that the order does not depend on
+// which entries were merged). Returns false if memory could not be allocated,
+// in which case nothing is changed.
+static inline bool _oc_update(
+  table_t *table,
+  aliases_t *aliases,
+  table_t *inserted,
+  table_t *deleted,
+  bool all,
+  table_t *updated
+)
+{
+  // Count the entries in the updated table, expanded entries contribute their
+  // aliases.
+  unsigned int size = inserted->size;
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    entry_t *e = &table->entries[i];
+    alias_list_t *l = aliases_find(aliases, e->keymask);
+
+    if (l != NULL && (all || _oc_must_expand(e, l, inserted, deleted)))
+    {
+      for (; l != NULL; l = l->next)
+      {
+        size += l->n_elements;
+      }
+    }
+    else
+    {
+      size++;
+    }
+  }
+
+  entry_t *scratch = MALLOC(sizeof(entry_t) * size);
+  entry_t *entries = MALLOC(sizeof(entry_t) * size);
+  if (size > 0 && (scratch == NULL || entries == NULL))
+  {
+    if (scratch != NULL)
+    {
+      FREE(scratch);
+    }
+    if (entries != NULL)
+    {
+      FREE(entries);
+    }
+    return false;
+  }
+
+  // Copy the entries which are being kept, expanding merged entries and
+  // removing deleted entries as required.
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    entry_t *e = &table->entries[i];
+    alias_list_t *l = aliases_find(aliases, e->keymask);
+
+    if (l == NULL)
+    {
+      // An original entry, keep it unless it is being deleted
+      if (!_oc_entry_in(deleted, e->keymask, e->route))
+      {
+        scratch[n++] = *e;
+      }
+    }
+    else if (all || _oc_must_expand(e, l, inserted, deleted))
+    {
+      // Replace the merged entry with the entries it was formed from
+      for (alias_list_t *m = l; m != NULL; m = m->next)
+      {
+        for (unsigned int j = 0; j < m->n_elements; j++)
+        {
+          alias_element_t a = alias_list_get(m, j);
+          if (!_oc_entry_in(deleted, a.keymask, e->route))
+          {
+            scratch[n].keymask = a.keymask;
+            scratch[n].route = e->route;
+            scratch[n].source = a.source;
+            n++;
+          }
+        }
+      }
+
+      if (!all)
+      {
+        aliases_remove(aliases, e->keymask);
+        alias_list_delete(l);
+      }
+    }
+    else
+    {
+      // A merged entry which is unaffected
+      scratch[n++] = *e;
+    }
+  }
+
+  // Add the inserted entries
+  for (unsigned int i = 0; i < inserted->size; i++)
+  {
+    scratch[n++] = inserted->entries[i];
+  }
+
+  // Sort the new table, unless every entry was expanded entries which were
+  // already present retain their relative order.
+  if (all)
+  {
+    _oc_sort_by_key(scratch, entries, n);
+  }
+  table_sort_by_generality_into(entries, scratch, n);
+  FREE(scratch);
+  updated->size = n;
+  updated->entries = entries;
+  return true;
+}
+
+
+// Update a table which has already been minimised (together with its aliases)
+// to account for entries being inserted into, or deleted from, the original
+// table and then minimise it again.
+// Only merged entries which were formed from deleted entries, or which
+// intersect inserted entries, are expanded back into their original entries;
+// every other merge is kept. Deleted entries which were never merged are
+// simply removed. The merges which are kept can stop the other entries being
+// merged as well as they would be from scratch, so if the table grows by more
+// than the number of inserted entries the updated original table (sorted by
+// generality, key and then mask) is also minimised from scratch and the
+// smaller of the two tables is kept.
+// NOTE: The entries of `table` must have been allocated with MALLOC, they are
+// replaced by a new (MALLOCed) array of entries. Returns false if memory could
+// not be allocated, in which case the table is unchanged.
+static inline bool oc_reminimise(
+  table_t *table,
+  unsigned int target_length,
+  aliases_t *aliases,
+  table_t *inserted,
+  table_t *deleted
+)
+{
+  unsigned int previous_size = table->size;
+  table_t updated;
+  if (!_oc_update(table, aliases, inserted, deleted, false, &updated))
+  {
+    return false;
+  }
+  FREE(table->entries);
+  *table = updated;
+  oc_minimise(table, target_length, aliases);
+
+  // If there is no memory to start again the table is still valid
+  table_t none = {0, NULL};
+  if (table->size > target_length &&
+      table->size > previous_size + inserted->size &&
+      _oc_update(table, aliases, &none, &none, true, &updated))
+  {
+    aliases_t rebuilt = aliases_init();
+    oc_minimise(&updated, target_length, &rebuilt);
+
+    if (updated.size < table->size)
+    {
+      FREE(table->entries);
+      *table = updated;
+      aliases_clear(aliases);
+      *aliases = rebuilt;
+    }
+    else
+    {
+      FREE(updated.entries);
+      aliases_clear(&rebuilt);
+    }
+  }
+  return true;
+}
+
 #define __ORDERED_COVERING_H__
 #endif  // __ORDERED_COVERING_H__
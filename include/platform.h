@@ -27,8 +27,27 @@
 #else
   #include <stdlib.h>
 
-  #define MALLOC malloc
-  #define FREE   free
+  #ifdef CONTEXT_ALLOCATOR
+    // Allocate from the free lists of the current minimiser context (see
+    // lib/rig_rt.c)
+    void *context_malloc(size_t bytes);
+    void context_free(void *ptr);
+
+    #define MALLOC context_malloc
+    #define FREE   context_free
+  #elif defined(PROFILED)
+    // Record every allocation against the file which made it (see
+    // lib/profile.h)
+    void profile_init(void);
+    void *profiled_malloc(size_t bytes, const char *site);
+    void profiled_free(void *ptr);
+
+    #define MALLOC(bytes) profiled_malloc(bytes, __FILE__)
+    #define FREE          profiled_free
+  #else
+    #define MALLOC malloc
+    #define FREE   free
+  #endif
 #endif
 
 #define __PLATFORM_H__
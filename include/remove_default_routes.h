@@ -2,15 +2,54 @@
 #include <stdbool.h>
 #include "bitset.h"
 #include "routing_table.h"
+#include "ternary_index.h"
 
 #ifndef __REMOVE_DEFAULT_ROUTES_H__
 
-static inline void remove_default_routes_minimise(table_t *table)
+// Entries which could be removed are checked against the entries below them
+// which are being kept. Off-chip these are held in a ternary index, at a cost
+// of about two heap nodes per kept entry. On SpiNNaker, where DTCM is scarce
+// and running out of it is fatal, every kept entry below is scanned instead
+// so that only the bitset of removed entries is allocated.
+#ifdef SPINNAKER
+  #define REMOVE_DEFAULT_ROUTES_INDEXED false
+#else
+  #define REMOVE_DEFAULT_ROUTES_INDEXED true
+#endif
+
+
+// Determine if an entry intersects with any entry further down the table
+// which is not being removed.
+static inline bool _remove_default_routes_intersects_below(table_t *table,
+                                                           bitset_t *remove,
+                                                           unsigned int i)
+{
+  for (unsigned int j = i + 1; j < table->size; j++)
+  {
+    if (!bitset_contains(remove, j) &&
+        keymask_intersect(table->entries[i].keymask,
+                          table->entries[j].keymask))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Remove default routes, using an index of the entries being kept if
+// `indexed`. If memory for the index cannot be allocated the remaining
+// entries are checked by scanning instead.
+static inline void _remove_default_routes_minimise(table_t *table,
+                                                   bool indexed)
 {
   // Mark the entries to be removed from the table
   bitset_t remove;
   bitset_init(&remove, table->size);
 
+  // Index of the entries below the current entry which are being kept
+  tindex_t below = tindex_init();
+
   // Work up the table from the bottom, marking entries to remove
   for (unsigned int i = table->size - 1; i < table->size; i--)
   {
@@ -26,34 +65,26 @@ static inline void remove_default_routes_minimise(table_t *table)
         (entry.source >> 3) == (entry.route & 0x7))    // Source is opposite to sink
     {
       // The entry can be removed iff. it doesn't intersect with any entry
-      // further down the table.
-      bool remove_entry = true;
-      for (unsigned int j = i + 1; j < table->size; j++)
-      {
-        // If entry we're comparing with is already going to be removed, ignore
-        // it.
-        if (bitset_contains(&remove, j))
-        {
-          continue;
-        }
-
-        keymask_t a = entry.keymask;
-        keymask_t b = table->entries[j].keymask;
-
-        if (keymask_intersect(a, b))
-        {
-          remove_entry = false;
-          break;
-        }
-      }
-
-      if (remove_entry)
+      // further down the table which is being kept.
+      bool intersects = indexed ?
+        tindex_intersects(&below, entry.keymask) :
+        _remove_default_routes_intersects_below(table, &remove, i);
+      if (!intersects)
       {
         // Mark this entry as being removed
         bitset_add(&remove, i);
+        continue;
       }
     }
+
+    // The entry is being kept, so add it to the index of entries below
+    if (indexed && !tindex_insert(&below, entry.keymask))
+    {
+      tindex_delete(&below);
+      indexed = false;
+    }
   }
+  tindex_delete(&below);
 
   // Remove the selected entries from the table
   for (unsigned int insert = 0, read = 0; read < table->size; read++)
@@ -75,5 +106,11 @@ static inline void remove_default_routes_minimise(table_t *table)
   bitset_delete(&remove);
 }
 
+
+static inline void remove_default_routes_minimise(table_t *table)
+{
+  _remove_default_routes_minimise(table, REMOVE_DEFAULT_ROUTES_INDEXED);
+}
+
 #define __REMOVE_DEFAULT_ROUTES_H__
 #endif  // __REMOVE_DEFAULT_ROUTES_H__
@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include "platform.h"
 
 #ifndef __ROUTING_TABLE_H__
 
@@ -59,5 +60,82 @@ typedef struct _table_t
 } table_t;
 
 
+// Number of different generalities a keymask may have (0 to 32 Xs)
+#define N_GENERALITIES 33
+
+
+// Count the number of entries of each generality
+static inline void table_get_generality_histogram(
+  const entry_t *entries,
+  unsigned int n_entries,
+  unsigned int histogram[N_GENERALITIES]
+)
+{
+  for (unsigned int g = 0; g < N_GENERALITIES; g++)
+  {
+    histogram[g] = 0;
+  }
+
+  for (unsigned int i = 0; i < n_entries; i++)
+  {
+    histogram[keymask_count_xs(entries[i].keymask)]++;
+  }
+}
+
+
+// Copy entries from `src` into `dest` in ascending order of generality. The
+// sort is stable: entries of equal generality retain their relative order.
+static inline void table_sort_by_generality_into(
+  entry_t *dest,
+  const entry_t *src,
+  unsigned int n_entries
+)
+{
+  // Count the entries of each generality
+  unsigned int counts[N_GENERALITIES];
+  table_get_generality_histogram(src, n_entries, counts);
+
+  // Determine where the entries of each generality start
+  unsigned int next[N_GENERALITIES];
+  for (unsigned int g = 0, start = 0; g < N_GENERALITIES; g++)
+  {
+    next[g] = start;
+    start += counts[g];
+  }
+
+  // Place each entry into its position
+  for (unsigned int i = 0; i < n_entries; i++)
+  {
+    dest[next[keymask_count_xs(src[i].keymask)]++] = src[i];
+  }
+}
+
+
+// Sort a table in ascending order of generality using a scratch copy of the
+// entries, returns false if the scratch space could not be allocated.
+static inline bool table_sort_by_generality(table_t *table)
+{
+  // An empty table needs no scratch space (and has nothing to copy into it)
+  if (table->size == 0)
+  {
+    return true;
+  }
+
+  entry_t *scratch = MALLOC(sizeof(entry_t) * table->size);
+  if (scratch == NULL)
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    scratch[i] = table->entries[i];
+  }
+  table_sort_by_generality_into(table->entries, scratch, table->size);
+
+  FREE(scratch);
+  return true;
+}
+
 #define __ROUTING_TABLE_H__
 #endif  // __ROUTING_TABLE_H__
@@ -0,0 +1,190 @@
+/* Snapshots of the state of Ordered Covering.
+ *
+ * The state of a minimisation in progress is the partially minimised table
+ * and the aliases of each merged entry. A snapshot stores both in a flat
+ * block of words:
+ *
+ *    SNAPSHOT_MAGIC
+ *    Number of entries in the table
+ *    Entries (key, mask, route, source)
+ *    Number of alias lists
+ *    For each alias list:
+ *      Keymask of the merged entry (key, mask)
+ *      Number of elements
+ *      Elements (key, mask, source)
+ *
+ * Taking a snapshot is a single pass over the table and the aliases tree, so
+ * it is cheap enough to do frequently.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "platform.h"
+#include "routing_table.h"
+#include "aliases.h"
+
+#ifndef __SNAPSHOT_H__
+
+// Magic number at the start of snapshots, "RTBS"
+#define SNAPSHOT_MAGIC 0x53425452
+
+
+// Count the alias lists in a tree and the words required to store them
+static inline void _snapshot_count_aliases(node_t *n, unsigned int *n_lists,
+                                           unsigned int *n_words)
+{
+  if (n == NULL)
+  {
+    return;
+  }
+
+  _snapshot_count_aliases(n->left, n_lists, n_words);
+  _snapshot_count_aliases(n->right, n_lists, n_words);
+
+  // Nodes which have been removed from the tree have no value
+  if (n->val != NULL)
+  {
+    (*n_lists)++;
+    *n_words += 3;
+    for (alias_list_t *l = n->val; l != NULL; l = l->next)
+    {
+      *n_words += 3 * l->n_elements;
+    }
+  }
+}
+
+
+// Get the number of words required to store a snapshot
+static inline unsigned int snapshot_size(table_t *table, aliases_t *aliases)
+{
+  unsigned int n_lists = 0, n_words = 3 + 4 * table->size;
+  _snapshot_count_aliases(aliases->root, &n_lists, &n_words);
+  return n_words;
+}
+
+
+// Write the alias lists in a tree, returns the next word to write
+static inline uint32_t* _snapshot_write_aliases(node_t *n, uint32_t *data)
+{
+  if (n == NULL)
+  {
+    return data;
+  }
+
+  data = _snapshot_write_aliases(n->left, data);
+  data = _snapshot_write_aliases(n->right, data);
+
+  if (n->val != NULL)
+  {
+    *(data++) = n->key.km.key;
+    *(data++) = n->key.km.mask;
+
+    uint32_t *n_elements = data++;
+    *n_elements = 0;
+    for (alias_list_t *l = n->val; l != NULL; l = l->next)
+    {
+      for (unsigned int i = 0; i < l->n_elements; i++)
+      {
+        alias_element_t e = alias_list_get(l, i);
+        *(data++) = e.keymask.key;
+        *(data++) = e.keymask.mask;
+        *(data++) = e.source;
+      }
+      *n_elements += l->n_elements;
+    }
+  }
+
+  return data;
+}
+
+
+// Write a snapshot of a table and its aliases into `data`, which must have
+// space for `snapshot_size` words.
+static inline void snapshot_write(uint32_t *data, table_t *table,
+                                  aliases_t *aliases)
+{
+  *(data++) = SNAPSHOT_MAGIC;
+
+  *(data++) = table->size;
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    *(data++) = table->entries[i].keymask.key;
+    *(data++) = table->entries[i].keymask.mask;
+    *(data++) = table->entries[i].route;
+    *(data++) = table->entries[i].source;
+  }
+
+  unsigned int n_lists = 0, n_words = 0;
+  _snapshot_count_aliases(aliases->root, &n_lists, &n_words);
+  *(data++) = n_lists;
+  _snapshot_write_aliases(aliases->root, data);
+}
+
+
+// Restore a table and its aliases from a snapshot of `n_words` words. The
+// entries are written into the table, which must have space for `capacity`
+// entries, and the alias lists are added to `aliases` (which should be
+// empty). Returns false if the snapshot is malformed or too large, in which
+// case neither the table nor the aliases are changed.
+static inline bool snapshot_read(uint32_t *data, unsigned int n_words,
+                                 table_t *table, unsigned int capacity,
+                                 aliases_t *aliases)
+{
+  uint32_t *end = data + n_words;
+
+  // Check the header and the table
+  if (n_words < 3 || data[0] != SNAPSHOT_MAGIC || data[1] > capacity ||
+      data[1] > (n_words - 3) / 4)
+  {
+    return false;
+  }
+  unsigned int size = data[1];
+  uint32_t *entries = data + 2;
+  uint32_t *lists = entries + 4 * size;
+
+  // Check that the alias lists fit
+  unsigned int n_lists = *(lists++);
+  uint32_t *l = lists;
+  for (unsigned int i = 0; i < n_lists; i++)
+  {
+    if (end - l < 3 || (uint32_t) (end - l - 3) / 3 < l[2])
+    {
+      return false;
+    }
+    l += 3 + 3 * l[2];
+  }
+  if (l != end)
+  {
+    return false;
+  }
+
+  // Restore the table
+  table->size = size;
+  for (unsigned int i = 0; i < size; i++, entries += 4)
+  {
+    table->entries[i].keymask.key = entries[0];
+    table->entries[i].keymask.mask = entries[1];
+    table->entries[i].route = entries[2];
+    table->entries[i].source = entries[3];
+  }
+
+  // Restore the aliases
+  for (unsigned int i = 0; i < n_lists; i++)
+  {
+    keymask_t km = {lists[0], lists[1]};
+    unsigned int n_elements = lists[2];
+    lists += 3;
+
+    alias_list_t *list = alias_list_new(n_elements ? n_elements : 1);
+    for (unsigned int j = 0; j < n_elements; j++, lists += 3)
+    {
+      keymask_t e = {lists[0], lists[1]};
+      alias_list_append(list, e, lists[2]);
+    }
+    aliases_insert(aliases, km, list);
+  }
+
+  return true;
+}
+
+#define __SNAPSHOT_H__
+#endif  // __SNAPSHOT_H__
@@ -0,0 +1,422 @@
+/* Generation of synthetic SpiNNaker routing tables.
+ *
+ * A machine of `width` x `height` chips, connected as a hexagonal torus, is
+ * filled with populations of neurons, each occupying one or more
+ * consecutive cores (one slice of the population per core). Every
+ * population projects to a few others, mostly nearby, and every slice sends
+ * its packets along a multicast tree to all the cores of the populations it
+ * projects to.
+ *
+ * Keys are population-structured: the key of a slice is its population
+ * number, followed by the slice number, followed by GENERATOR_NEURON_BITS
+ * bits for the neuron (which are masked out). Slices of the same population
+ * share a route on every chip they pass through, which is what the
+ * minimisers exploit.
+ *
+ * Routes and sources use the SpiNNaker layout: bits 0-5 are links (east,
+ * north-east, north, west, south-west, south) and bits 6 upwards are cores.
+ * Link `l` is opposite link `(l + 3) % 6`, so an entry whose packets arrive
+ * on one link and leave only on the opposite link is default-routable and
+ * may be removed by `remove_default_routes_minimise`.
+ *
+ * The same parameters (including the seed) always generate the same tables.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "platform.h"
+#include "routing_table.h"
+
+#ifndef __TABLE_GENERATOR_H__
+
+// Number of bits of a key used to identify neurons within a slice
+#define GENERATOR_NEURON_BITS 8
+
+// Largest number of application cores on a chip (route bits 6 to 23)
+#define GENERATOR_MAX_CORES 18
+
+
+typedef struct _generator_params_t
+{
+  unsigned int width, height;    // Size of the machine in chips
+  unsigned int cores_per_chip;   // Application cores on each chip
+  unsigned int max_slices;       // Largest population, in cores
+  unsigned int max_projections;  // Most populations a population targets
+  unsigned int radius;           // Distance, in chips, of local projections
+  unsigned int local_percent;    // Percentage of projections which are local
+  uint32_t seed;                 // Seed of the random number generator
+} generator_params_t;
+
+
+// Get parameters for a machine of the given size
+static inline generator_params_t generator_params_init(unsigned int width,
+                                                       unsigned int height,
+                                                       uint32_t seed)
+{
+  generator_params_t p = {width, height, 16, 8, 4, 4, 80, seed};
+  return p;
+}
+
+
+// Offsets of the chip connected to each link
+static const int _generator_link_dx[6] = {1, 1, 0, -1, -1, 0};
+static const int _generator_link_dy[6] = {0, 1, 1, 0, -1, -1};
+
+
+// State of a generator
+typedef struct _generator_t
+{
+  generator_params_t p;
+  uint64_t rng;             // State of the random number generator
+
+  table_t *tables;          // Table of each chip, indexed by `y*width + x`
+  unsigned int *capacity;   // Number of entries each table has space for
+
+  uint32_t *stamp;          // Last tree to reach each chip (from 1)
+  unsigned int *entry;      // Entry of the tree on each chip
+} generator_t;
+
+
+// Get a random number (xorshift64*)
+static inline uint32_t _generator_random(generator_t *g)
+{
+  g->rng ^= g->rng >> 12;
+  g->rng ^= g->rng << 25;
+  g->rng ^= g->rng >> 27;
+  return (g->rng * 2685821657736338717ull) >> 32;
+}
+
+
+// Get a random number less than n
+static inline unsigned int _generator_below(generator_t *g, unsigned int n)
+{
+  return (uint64_t) _generator_random(g) * n >> 32;
+}
+
+
+// Get the number of hops between chips `(dx, dy)` apart
+static inline unsigned int _generator_hops(int dx, int dy)
+{
+  unsigned int ax = (dx < 0) ? -dx : dx;
+  unsigned int ay = (dy < 0) ? -dy : dy;
+
+  if ((dx > 0 && dy > 0) || (dx < 0 && dy < 0))
+  {
+    // Diagonal links cover one step in each direction
+    return (ax > ay) ? ax : ay;
+  }
+  return ax + ay;
+}
+
+
+// Get the shortest offset, around the torus, between two co-ordinates
+static inline void _generator_offset(generator_t *g,
+                                     unsigned int x0, unsigned int y0,
+                                     unsigned int x1, unsigned int y1,
+                                     int *dx, int *dy)
+{
+  int w = g->p.width, h = g->p.height;
+  unsigned int best = UINT32_MAX;
+
+  for (int i = -1; i <= 1; i++)
+  {
+    for (int j = -1; j <= 1; j++)
+    {
+      int cx = (int) x1 - (int) x0 + i*w;
+      int cy = (int) y1 - (int) y0 + j*h;
+      unsigned int hops = _generator_hops(cx, cy);
+      if (hops < best)
+      {
+        best = hops;
+        *dx = cx;
+        *dy = cy;
+      }
+    }
+  }
+}
+
+
+// Get the entry of the current tree on a chip, adding it if it is not yet
+// part of the tree.
+static inline entry_t* _generator_entry(generator_t *g, unsigned int chip,
+                                        uint32_t tree, keymask_t km,
+                                        uint32_t source)
+{
+  table_t *t = &g->tables[chip];
+  if (g->stamp[chip] == tree)
+  {
+    return &t->entries[g->entry[chip]];
+  }
+
+  if (t->size == g->capacity[chip])
+  {
+    // Double the space available to the table
+    g->capacity[chip] = g->capacity[chip] ? g->capacity[chip] * 2 : 16;
+    entry_t *entries = MALLOC(sizeof(entry_t) * g->capacity[chip]);
+    if (t->entries != NULL)
+    {
+      memcpy(entries, t->entries, sizeof(entry_t) * t->size);
+      FREE(t->entries);
+    }
+    t->entries = entries;
+  }
+
+  g->stamp[chip] = tree;
+  g->entry[chip] = t->size;
+
+  entry_t *e = &t->entries[t->size++];
+  e->keymask = km;
+  e->route = 0;
+  e->source = source;
+  return e;
+}
+
+
+// Extend the current tree from a chip to a core on another chip, moving
+// diagonally and then along x and y.
+static inline void _generator_route(generator_t *g, unsigned int from,
+                                    unsigned int to, unsigned int core,
+                                    uint32_t tree, keymask_t km)
+{
+  unsigned int w = g->p.width, h = g->p.height;
+  unsigned int x = from % w, y = from / w;
+  int dx, dy;
+  _generator_offset(g, x, y, to % w, to / w, &dx, &dy);
+
+  unsigned int chip = from;
+  while (dx != 0 || dy != 0)
+  {
+    unsigned int link;
+    if (dx > 0 && dy > 0)
+    {
+      link = 1;
+    }
+    else if (dx < 0 && dy < 0)
+    {
+      link = 4;
+    }
+    else if (dx != 0)
+    {
+      link = (dx > 0) ? 0 : 3;
+    }
+    else
+    {
+      link = (dy > 0) ? 2 : 5;
+    }
+    dx -= _generator_link_dx[link];
+    dy -= _generator_link_dy[link];
+
+    x = (x + w + _generator_link_dx[link]) % w;
+    y = (y + h + _generator_link_dy[link]) % h;
+    unsigned int next = y*w + x;
+
+    // Only chips not yet in the tree are added to it, so that no chip
+    // receives the same packet twice.
+    if (g->stamp[next] != tree)
+    {
+      _generator_entry(g, chip, tree, km, 0)->route |= 1 << link;
+      _generator_entry(g, next, tree, km, 1 << ((link + 3) % 6));
+    }
+    chip = next;
+  }
+
+  _generator_entry(g, chip, tree, km, 0)->route |= 1 << (6 + core);
+}
+
+
+// Free the tables produced by `generator_run`
+static inline void generator_tables_delete(table_t *tables,
+                                           unsigned int n_tables)
+{
+  for (unsigned int i = 0; i < n_tables; i++)
+  {
+    if (tables[i].entries != NULL)
+    {
+      FREE(tables[i].entries);
+    }
+  }
+  FREE(tables);
+}
+
+
+// Generate the routing tables of a machine, returns an array of
+// `width*height` tables (the table of chip (x, y) is at `y*width + x`) which
+// should be freed with `generator_tables_delete`, or NULL if the parameters
+// are invalid or there are too many populations to be given keys.
+static inline table_t* generator_run(const generator_params_t *params)
+{
+  generator_t g;
+  g.p = *params;
+  g.rng = params->seed * 0x9e3779b97f4a7c15ull + 1;  // Never zero
+
+  if (g.p.width == 0 || g.p.height == 0 || g.p.cores_per_chip == 0 ||
+      g.p.cores_per_chip > GENERATOR_MAX_CORES || g.p.max_slices == 0)
+  {
+    return NULL;
+  }
+
+  unsigned int n_chips = g.p.width * g.p.height;
+  unsigned int n_cores = n_chips * g.p.cores_per_chip;
+
+  // Bits of the key used for the slice and for the population
+  unsigned int slice_bits = 0;
+  while ((1u << slice_bits) < g.p.max_slices)
+  {
+    slice_bits++;
+  }
+  unsigned int pop_shift = GENERATOR_NEURON_BITS + slice_bits;
+  if (pop_shift >= 32)
+  {
+    return NULL;
+  }
+  uint64_t max_pops = 1ull << (32 - pop_shift);
+
+  // Divide the cores into populations, each population being identified by
+  // its first core.
+  unsigned int *pop_of_core = MALLOC(sizeof(unsigned int) * n_cores);
+  unsigned int *first_cores = MALLOC(sizeof(unsigned int) * (n_cores + 1));
+  unsigned int n_pops = 0;
+  for (unsigned int core = 0; core < n_cores; n_pops++)
+  {
+    unsigned int n_slices = 1 + _generator_below(&g, g.p.max_slices);
+    first_cores[n_pops] = core;
+    for (unsigned int s = 0; s < n_slices && core < n_cores; s++)
+    {
+      pop_of_core[core++] = n_pops;
+    }
+  }
+  first_cores[n_pops] = n_cores;
+
+  if (n_pops > max_pops)
+  {
+    FREE(pop_of_core);
+    FREE(first_cores);
+    return NULL;
+  }
+
+  g.tables = MALLOC(sizeof(table_t) * n_chips);
+  g.capacity = MALLOC(sizeof(unsigned int) * n_chips);
+  g.stamp = MALLOC(sizeof(uint32_t) * n_chips);
+  g.entry = MALLOC(sizeof(unsigned int) * n_chips);
+  for (unsigned int i = 0; i < n_chips; i++)
+  {
+    g.tables[i].size = 0;
+    g.tables[i].entries = NULL;
+    g.capacity[i] = 0;
+    g.stamp[i] = 0;
+  }
+
+  unsigned int max_projections = g.p.max_projections;
+  unsigned int *targets = MALLOC(sizeof(unsigned int) *
+                                 (max_projections ? max_projections : 1));
+  unsigned int span = 2*g.p.radius + 1;
+
+  uint32_t tree = 0;
+  for (unsigned int pop = 0; pop < n_pops; pop++)
+  {
+    // Choose the populations this population projects to
+    unsigned int n_targets = max_projections ?
+                             1 + _generator_below(&g, max_projections) : 0;
+    unsigned int chip = first_cores[pop] / g.p.cores_per_chip;
+    for (unsigned int t = 0; t < n_targets; t++)
+    {
+      unsigned int core;
+      if (_generator_below(&g, 100) < g.p.local_percent)
+      {
+        // A core on a chip nearby
+        unsigned int x = chip % g.p.width, y = chip / g.p.width;
+        x = (x + _generator_below(&g, span) +
+             g.p.width - g.p.radius % g.p.width) % g.p.width;
+        y = (y + _generator_below(&g, span) +
+             g.p.height - g.p.radius % g.p.height) % g.p.height;
+        core = (y*g.p.width + x) * g.p.cores_per_chip +
+               _generator_below(&g, g.p.cores_per_chip);
+      }
+      else
+      {
+        // Any core in the machine
+        core = _generator_below(&g, n_cores);
+      }
+      targets[t] = pop_of_core[core];
+    }
+
+    // Build a tree from each slice to every core of the target populations
+    for (unsigned int core = first_cores[pop];
+         n_targets > 0 && core < first_cores[pop + 1]; core++)
+    {
+      uint32_t slice = core - first_cores[pop];
+      keymask_t km = {
+        (pop << pop_shift) | (slice << GENERATOR_NEURON_BITS),
+        0xffffffff << GENERATOR_NEURON_BITS,
+      };
+
+      unsigned int from = core / g.p.cores_per_chip;
+      tree++;
+      _generator_entry(&g, from, tree, km,
+                       1 << (6 + core % g.p.cores_per_chip));
+
+      for (unsigned int t = 0; t < n_targets; t++)
+      {
+        for (unsigned int c = first_cores[targets[t]];
+             c < first_cores[targets[t] + 1]; c++)
+        {
+          _generator_route(&g, from, c / g.p.cores_per_chip,
+                           c % g.p.cores_per_chip, tree, km);
+        }
+      }
+    }
+  }
+
+  FREE(targets);
+  FREE(pop_of_core);
+  FREE(first_cores);
+  FREE(g.capacity);
+  FREE(g.stamp);
+  FREE(g.entry);
+
+  return g.tables;
+}
+
+
+// Generate a single table of `n_entries` entries, for benchmarks and tests
+// which need tables of a particular size. The tables of the chips of 8 x 8
+// machines (generated from successive seeds) are concatenated, with the
+// keys of each chip given a different value in their top bits (unused by
+// machines of this size) so that no two entries overlap. Returns false if
+// that many entries cannot be generated.
+static inline bool generator_table(table_t *table, unsigned int n_entries,
+                                   uint32_t seed)
+{
+  const unsigned int w = 8, h = 8;
+  const unsigned int tag_shift = 21;  // Highest key bit used by the machine
+
+  table->size = 0;
+  table->entries = MALLOC(sizeof(entry_t) * (n_entries ? n_entries : 1));
+
+  unsigned int tag = 0;
+  while (table->size < n_entries && tag < (1u << (32 - tag_shift)))
+  {
+    generator_params_t p = generator_params_init(w, h, seed++);
+    table_t *tables = generator_run(&p);
+
+    for (unsigned int chip = 0; chip < w*h &&
+         table->size < n_entries && tag < (1u << (32 - tag_shift)); chip++)
+    {
+      for (unsigned int i = 0; i < tables[chip].size &&
+           table->size < n_entries; i++)
+      {
+        entry_t e = tables[chip].entries[i];
+        e.keymask.key |= tag << tag_shift;
+        table->entries[table->size++] = e;
+      }
+      tag++;
+    }
+
+    generator_tables_delete(tables, w*h);
+  }
+
+  return table->size == n_entries;
+}
+
+#define __TABLE_GENERATOR_H__
+#endif  // __TABLE_GENERATOR_H__
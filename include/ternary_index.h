@@ -0,0 +1,258 @@
+/* Ternary index of keymasks.
+ *
+ * A path-compressed trie over the ternary (0, 1, X) digits of keymasks, most
+ * significant bit first, which can quickly answer "does this keymask intersect
+ * any keymask in the index?". Internal nodes are only created where the
+ * keymasks beneath them diverge so there are fewer than two nodes per
+ * distinct keymask.
+ *
+ * Keymasks can be removed from the index; nodes are not freed until the index
+ * is deleted but every node keeps a count of the keymasks beneath it so that
+ * empty sub-tries are skipped during searches.
+ *
+ * NOTE: Keymasks are stored with any `!` digits (key bit set, mask bit clear)
+ * treated as Xs.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "platform.h"
+#include "routing_table.h"
+
+#ifndef __TERNARY_INDEX_H__
+
+typedef struct _tindex_node_t
+{
+  keymask_t keymask;   // Keymask whose leading `depth` digits are shared by
+                       // every keymask beneath this node
+  unsigned int depth;  // Number of leading digits fixed at this node, 32 for
+                       // leaves.
+  unsigned int count;  // Number of keymasks in the index beneath this node
+
+  // Children for each value of the next digit
+  struct _tindex_node_t *child_0, *child_1, *child_X;
+} tindex_node_t;
+
+typedef struct _tindex_t
+{
+  tindex_node_t *root;
+} tindex_t;
+
+
+// Create a new, empty, index
+static inline tindex_t tindex_init(void)
+{
+  tindex_t index = {NULL};
+  return index;
+}
+
+
+static inline void _tindex_delete(tindex_node_t *node)
+{
+  if (node != NULL)
+  {
+    _tindex_delete(node->child_0);
+    _tindex_delete(node->child_1);
+    _tindex_delete(node->child_X);
+    FREE(node);
+  }
+}
+
+
+// Remove all keymasks from an index and free its memory
+static inline void tindex_delete(tindex_t *index)
+{
+  _tindex_delete(index->root);
+  index->root = NULL;
+}
+
+
+// Get a mask of the `depth` most significant bits
+static inline uint32_t _tindex_prefix(unsigned int depth)
+{
+  return (depth == 0) ? 0x0 : 0xffffffff << (32 - depth);
+}
+
+
+// Get the child of a node which a keymask would be stored beneath
+static inline tindex_node_t** _tindex_child(tindex_node_t *node, keymask_t km)
+{
+  uint32_t bit = 1 << (31 - node->depth);
+
+  if (!(km.mask & bit))
+  {
+    return &(node->child_X);
+  }
+  else if (km.key & bit)
+  {
+    return &(node->child_1);
+  }
+  else
+  {
+    return &(node->child_0);
+  }
+}
+
+
+// Create a new node, returns NULL if memory could not be allocated
+static inline tindex_node_t* _tindex_new_node(keymask_t km, unsigned int depth,
+                                              unsigned int count)
+{
+  tindex_node_t *node = MALLOC(sizeof(tindex_node_t));
+  if (node != NULL)
+  {
+    node->keymask = km;
+    node->depth = depth;
+    node->count = count;
+    node->child_0 = node->child_1 = node->child_X = NULL;
+  }
+  return node;
+}
+
+
+// Add a keymask to an index, returns false (leaving the index unchanged) if
+// memory could not be allocated.
+static inline bool tindex_insert(tindex_t *index, keymask_t km)
+{
+  km.key &= km.mask;  // Treat `!`s as Xs
+
+  // Find where the keymask leaves the trie, or the leaf which already holds
+  // it.
+  tindex_node_t **node = &(index->root);
+  unsigned int depth = 32;
+  while (*node != NULL)
+  {
+    // Find the first digit at which the keymask differs from the node
+    tindex_node_t *n = *node;
+    uint32_t diff = (n->keymask.key ^ km.key) | (n->keymask.mask ^ km.mask);
+    depth = (diff == 0) ? 32 : __builtin_clz(diff);
+    if (depth < n->depth || n->depth == 32)
+    {
+      break;
+    }
+
+    // Descend to the child for the next digit
+    node = _tindex_child(n, km);
+  }
+
+  tindex_node_t *n = *node;
+  tindex_node_t *leaf = NULL, *split = NULL;
+  if (n == NULL || depth < n->depth)
+  {
+    // Create a new leaf for the keymask. If the keymask diverges from a node
+    // part-way along its prefix a new node is also needed at the point of
+    // divergence, with the existing node and the new leaf beneath it. Both
+    // are allocated before the index is modified.
+    leaf = _tindex_new_node(km, 32, 1);
+    if (leaf != NULL && n != NULL)
+    {
+      split = _tindex_new_node(n->keymask, depth, n->count + 1);
+      if (split == NULL)
+      {
+        FREE(leaf);
+        leaf = NULL;
+      }
+    }
+
+    if (leaf == NULL)
+    {
+      return false;
+    }
+  }
+
+  // Count the keymask in every node above where it is inserted
+  for (tindex_node_t **m = &(index->root); m != node;
+       m = _tindex_child(*m, km))
+  {
+    (*m)->count++;
+  }
+
+  if (split != NULL)
+  {
+    *_tindex_child(split, n->keymask) = n;
+    *_tindex_child(split, km) = leaf;
+    *node = split;
+  }
+  else if (leaf != NULL)
+  {
+    *node = leaf;
+  }
+  else
+  {
+    n->count++;  // The keymask is already present in this leaf
+  }
+  return true;
+}
+
+
+// Remove a keymask from an index, returns false if it wasn't present
+static inline bool tindex_remove(tindex_t *index, keymask_t km)
+{
+  km.key &= km.mask;  // Treat `!`s as Xs
+
+  // Find the leaf which holds the keymask
+  tindex_node_t *node = index->root;
+  while (node != NULL && node->depth < 32)
+  {
+    node = *_tindex_child(node, km);
+  }
+
+  if (node == NULL || node->count == 0 ||
+      node->keymask.key != km.key || node->keymask.mask != km.mask)
+  {
+    return false;
+  }
+
+  // Decrement the count of every node along the path to the leaf
+  for (node = index->root; node->depth < 32; node = *_tindex_child(node, km))
+  {
+    node->count--;
+  }
+  node->count--;
+
+  return true;
+}
+
+
+static inline bool _tindex_intersects(tindex_node_t *node, keymask_t km)
+{
+  // Skip sub-tries from which every keymask has been removed or whose prefix
+  // does not intersect with the keymask.
+  if (node == NULL || node->count == 0 ||
+      ((node->keymask.key & km.mask) ^ (km.key & node->keymask.mask)) &
+      _tindex_prefix(node->depth))
+  {
+    return false;
+  }
+
+  if (node->depth == 32)
+  {
+    return true;  // A leaf which intersects with the keymask
+  }
+
+  // If the keymask has a 0 or 1 at the next digit then only the children for
+  // that digit and for an X need be searched, otherwise all children must be.
+  uint32_t bit = 1 << (31 - node->depth);
+  if (km.mask & bit)
+  {
+    tindex_node_t *child = (km.key & bit) ? node->child_1 : node->child_0;
+    return _tindex_intersects(child, km) ||
+           _tindex_intersects(node->child_X, km);
+  }
+  else
+  {
+    return _tindex_intersects(node->child_0, km) ||
+           _tindex_intersects(node->child_1, km) ||
+           _tindex_intersects(node->child_X, km);
+  }
+}
+
+
+// Determine if a keymask intersects with any keymask in the index
+static inline bool tindex_intersects(tindex_t *index, keymask_t km)
+{
+  km.key &= km.mask;  // Treat `!`s as Xs
+  return _tindex_intersects(index->root, km);
+}
+
+#define __TERNARY_INDEX_H__
+#endif  // __TERNARY_INDEX_H__
@@ -0,0 +1,156 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+
+// Header preceding every block, padded so that blocks are suitably aligned
+// for any type.
+typedef union _header_t
+{
+  struct
+  {
+    size_t bytes;       // Size of the block
+    unsigned int site;  // Index of the site which allocated the block
+  } block;
+  uint64_t _align[2];
+} header_t;
+
+
+// Profile of this thread
+static __thread profile_t profile;
+
+
+void profile_init(void)
+{
+  memset(&profile, 0, sizeof(profile));
+}
+
+
+const profile_t* profile_get(void)
+{
+  return &profile;
+}
+
+
+void profile_reset_peak(void)
+{
+  profile.peak_bytes = profile.live_bytes;
+  for (unsigned int i = 0; i < profile.n_sites; i++)
+  {
+    profile.sites[i].peak_bytes = profile.sites[i].live_bytes;
+  }
+}
+
+
+// Get the name of a site from the path of the file
+static const char* _site_name(const char *file)
+{
+  const char *name = strrchr(file, '/');
+  return (name != NULL) ? name + 1 : file;
+}
+
+
+const profile_site_t* profile_get_site(const char *name)
+{
+  for (unsigned int i = 0; i < profile.n_sites; i++)
+  {
+    if (strcmp(profile.sites[i].name, name) == 0)
+    {
+      return &profile.sites[i];
+    }
+  }
+  return NULL;
+}
+
+
+// Get the index of the site for a file, adding it if necessary
+static unsigned int _site_index(const char *file)
+{
+  const char *name = _site_name(file);
+  for (unsigned int i = 0; i < profile.n_sites; i++)
+  {
+    if (profile.sites[i].name == name ||
+        strcmp(profile.sites[i].name, name) == 0)
+    {
+      return i;
+    }
+  }
+
+  if (profile.n_sites == PROFILE_MAX_SITES)
+  {
+    return PROFILE_MAX_SITES - 1;
+  }
+
+  profile.sites[profile.n_sites].name = name;
+  return profile.n_sites++;
+}
+
+
+void *profiled_malloc(size_t bytes, const char *site)
+{
+  header_t *h = malloc(sizeof(header_t) + bytes);
+  if (h == NULL)
+  {
+    return NULL;
+  }
+
+  h->block.bytes = bytes;
+  h->block.site = _site_index(site);
+
+  // Update the totals
+  profile.n_allocations++;
+  profile.live_bytes += bytes;
+  if (profile.live_bytes > profile.peak_bytes)
+  {
+    profile.peak_bytes = profile.live_bytes;
+  }
+
+  // Update the site
+  profile_site_t *s = &profile.sites[h->block.site];
+  s->n_allocations++;
+  s->bytes += bytes;
+  s->live_bytes += bytes;
+  if (s->live_bytes > s->peak_bytes)
+  {
+    s->peak_bytes = s->live_bytes;
+  }
+
+  return h + 1;
+}
+
+
+void profiled_free(void *ptr)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  header_t *h = ((header_t *) ptr) - 1;
+  profile.n_frees++;
+  profile.live_bytes -= h->block.bytes;
+  profile.sites[h->block.site].live_bytes -= h->block.bytes;
+
+  free(h);
+}
+
+
+void profile_report(FILE *f)
+{
+  fprintf(f, "Heap: %zu bytes peak, %zu bytes live, "
+             "%llu allocations, %llu frees\n",
+          profile.peak_bytes, profile.live_bytes,
+          (unsigned long long) profile.n_allocations,
+          (unsigned long long) profile.n_frees);
+
+  for (unsigned int i = 0; i < profile.n_sites; i++)
+  {
+    profile_site_t *s = &profile.sites[i];
+    fprintf(f, "  %-20s %10zu bytes peak %10llu allocations "
+               "%12llu bytes\n",
+            s->name, s->peak_bytes, (unsigned long long) s->n_allocations,
+            (unsigned long long) s->bytes);
+  }
+}
@@ -0,0 +1,64 @@
+/* Profiled memory allocation for host builds.
+ *
+ * Code compiled with PROFILED defined allocates through `profiled_malloc`
+ * (see platform.h), which records the bytes allocated, the bytes live and
+ * the peak number of bytes live, both overall and for each call site (the
+ * source file which made the allocation, e.g., bitset.h or aliases.h).
+ *
+ * Every thread has its own profile which `profile_init` resets; memory
+ * should be freed by the thread which allocated it.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef __PROFILE_H__
+
+// Maximum number of call sites which are recorded separately, allocations
+// from any further sites are recorded against the last site.
+#define PROFILE_MAX_SITES 16
+
+
+typedef struct _profile_site_t
+{
+  const char *name;        // Name of the file which made the allocations
+  uint64_t n_allocations;  // Number of allocations made
+  uint64_t bytes;          // Total bytes allocated
+  size_t live_bytes;       // Bytes currently allocated
+  size_t peak_bytes;       // Largest value of `live_bytes`
+} profile_site_t;
+
+
+typedef struct _profile_t
+{
+  uint64_t n_allocations;  // Number of allocations made
+  uint64_t n_frees;        // Number of allocations freed
+  size_t live_bytes;       // Bytes currently allocated
+  size_t peak_bytes;       // Largest value of `live_bytes`
+
+  unsigned int n_sites;
+  profile_site_t sites[PROFILE_MAX_SITES];
+} profile_t;
+
+
+// Reset the profile of the calling thread
+void profile_init(void);
+
+// Get the profile of the calling thread
+const profile_t* profile_get(void);
+
+// Reset the peak number of bytes to the number currently live, so that the
+// peak of a following operation can be measured.
+void profile_reset_peak(void);
+
+// Get a site from the profile of the calling thread by name, or NULL
+const profile_site_t* profile_get_site(const char *name);
+
+// Print the profile of the calling thread
+void profile_report(FILE *f);
+
+void *profiled_malloc(size_t bytes, const char *site);
+void profiled_free(void *ptr);
+
+#define __PROFILE_H__
+#endif  // __PROFILE_H__
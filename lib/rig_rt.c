@@ -0,0 +1,185 @@
+// Route all of the allocations made by the minimisers through the context
+// allocator (see platform.h).
+#define CONTEXT_ALLOCATOR
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "rig_rt.h"
+#include "platform.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "constant_columns.h"
+
+// Blocks are grouped into size classes of 16 << n bytes, requests too large
+// for any class are passed straight to the system.
+#define N_SIZE_CLASSES 28
+#define MIN_BLOCK_BITS 4
+#define NO_SIZE_CLASS N_SIZE_CLASSES
+
+
+// Header preceding every block, padded so that blocks are suitably aligned
+// for any type.
+typedef union _block_t
+{
+  struct
+  {
+    union _block_t *next;     // Next free block in the same size class
+    unsigned int size_class;  // Size class of the block
+  } header;
+  uint64_t _align[2];
+} block_t;
+
+
+struct _rig_rt_context_t
+{
+  block_t *free_lists[N_SIZE_CLASSES];  // Free blocks of each size class
+  uint64_t n_allocations;               // Blocks requested from the system
+};
+
+
+// Context being used by this thread, or NULL
+static __thread rig_rt_context_t *current = NULL;
+
+
+// Get the smallest size class which can hold a block
+static inline unsigned int _size_class(size_t bytes)
+{
+  unsigned int c = 0;
+  while (c < N_SIZE_CLASSES && ((size_t) 1 << (c + MIN_BLOCK_BITS)) < bytes)
+  {
+    c++;
+  }
+  return c;
+}
+
+
+void *context_malloc(size_t bytes)
+{
+  unsigned int c = _size_class(bytes);
+  rig_rt_context_t *ctx = current;
+
+  // Reuse a free block if there is one
+  if (ctx != NULL && c != NO_SIZE_CLASS && ctx->free_lists[c] != NULL)
+  {
+    block_t *b = ctx->free_lists[c];
+    ctx->free_lists[c] = b->header.next;
+    return b + 1;
+  }
+
+  // Otherwise get a new block from the system, rounded up to the size of its
+  // class so that it may be reused for any request in the class.
+  size_t size = (c == NO_SIZE_CLASS) ? bytes :
+                                       (size_t) 1 << (c + MIN_BLOCK_BITS);
+  block_t *b = malloc(sizeof(block_t) + size);
+  if (b == NULL)
+  {
+    return NULL;
+  }
+
+  b->header.size_class = c;
+  if (ctx != NULL)
+  {
+    ctx->n_allocations++;
+  }
+  return b + 1;
+}
+
+
+void context_free(void *ptr)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  block_t *b = ((block_t *) ptr) - 1;
+  rig_rt_context_t *ctx = current;
+  if (ctx != NULL && b->header.size_class != NO_SIZE_CLASS)
+  {
+    // Keep the block for reuse
+    b->header.next = ctx->free_lists[b->header.size_class];
+    ctx->free_lists[b->header.size_class] = b;
+  }
+  else
+  {
+    free(b);
+  }
+}
+
+
+rig_rt_context_t* rig_rt_context_new(void)
+{
+  rig_rt_context_t *ctx = malloc(sizeof(rig_rt_context_t));
+  if (ctx != NULL)
+  {
+    for (unsigned int c = 0; c < N_SIZE_CLASSES; c++)
+    {
+      ctx->free_lists[c] = NULL;
+    }
+    ctx->n_allocations = 0;
+  }
+  return ctx;
+}
+
+
+void rig_rt_context_delete(rig_rt_context_t *ctx)
+{
+  for (unsigned int c = 0; c < N_SIZE_CLASSES; c++)
+  {
+    while (ctx->free_lists[c] != NULL)
+    {
+      block_t *b = ctx->free_lists[c];
+      ctx->free_lists[c] = b->header.next;
+      free(b);
+    }
+  }
+  free(ctx);
+}
+
+
+uint64_t rig_rt_context_n_allocations(rig_rt_context_t *ctx)
+{
+  return ctx->n_allocations;
+}
+
+
+bool rig_rt_oc_minimise(rig_rt_context_t *ctx, table_t *table,
+                        unsigned int target_length)
+{
+  rig_rt_context_t *previous = current;
+  current = ctx;
+
+  bool sorted = table_sort_by_generality(table);
+  if (sorted)
+  {
+    aliases_t aliases = aliases_init();
+    columns_oc_minimise(table, target_length, &aliases);
+    aliases_clear(&aliases);
+  }
+
+  current = previous;
+  return sorted;
+}
+
+
+void rig_rt_mtrie_minimise(rig_rt_context_t *ctx, table_t *table)
+{
+  rig_rt_context_t *previous = current;
+  current = ctx;
+
+  columns_mtrie_minimise(table);
+
+  current = previous;
+}
+
+
+void rig_rt_mtrie_minimise_shared(rig_rt_context_t *ctx, table_t *table)
+{
+  rig_rt_context_t *previous = current;
+  current = ctx;
+
+  columns_mtrie_minimise_shared(table);
+
+  current = previous;
+}
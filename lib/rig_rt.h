@@ -0,0 +1,49 @@
+/* Compiled routing table minimisation library.
+ *
+ * `librig_rt` contains the minimisers from `include/` compiled once, for use
+ * by programs which minimise many tables. Every call is made with a context
+ * which keeps the memory freed while minimising one table (bitsets, merges,
+ * aliases and tries) in free lists, sorted by size, ready to be reused for
+ * the next. After the first few tables minimising a table of a similar size
+ * requires no further memory from the system.
+ *
+ * A context may only be used by one thread at a time; each thread which
+ * minimises tables should have its own.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "routing_table.h"
+
+#ifndef __RIG_RT_H__
+
+// Minimiser context, the contents are private to the library
+typedef struct _rig_rt_context_t rig_rt_context_t;
+
+
+// Create a new context, returns NULL if memory could not be allocated
+rig_rt_context_t* rig_rt_context_new(void);
+
+// Free a context and all the memory it holds
+void rig_rt_context_delete(rig_rt_context_t *ctx);
+
+// Get the number of blocks of memory the context has requested from the
+// system, this stops increasing once the context has reached a steady state.
+uint64_t rig_rt_context_n_allocations(rig_rt_context_t *ctx);
+
+
+// Sort a table and minimise it with Ordered Covering, ignoring any bits
+// which are the same in every entry. Returns false, leaving the table
+// unchanged, if there was no memory to sort it.
+bool rig_rt_oc_minimise(rig_rt_context_t *ctx, table_t *table,
+                        unsigned int target_length);
+
+// Minimise a table with m-Trie, ignoring any bits which are the same in every
+// entry.
+void rig_rt_mtrie_minimise(rig_rt_context_t *ctx, table_t *table);
+
+// As `rig_rt_mtrie_minimise`, sharing structurally identical subtries to
+// reduce the peak memory used (see `mtrie_minimise_shared`).
+void rig_rt_mtrie_minimise_shared(rig_rt_context_t *ctx, table_t *table);
+
+#define __RIG_RT_H__
+#endif  // __RIG_RT_H__
@@ -80,6 +80,23 @@ void read_table(table_t *table, header_t *header)
 }
 /*****************************************************************************/
 
+/*****************************************************************************/
+/* Read a new copy of the routing table from SDRAM, sorted in ascending order
+ * of generality.                                                            */
+void read_sorted_table(table_t *table, header_t *header)
+{
+  // Copy the size of the table
+  table->size = header->table_size;
+
+  // Allocate space for the routing table entries
+  table->entries = MALLOC(table->size * sizeof(entry_t));
+
+  // Sort the routing table entries directly out of SDRAM, this avoids needing
+  // any additional scratch space.
+  table_sort_by_generality_into(table->entries, header->entries, table->size);
+}
+/*****************************************************************************/
+
 /*****************************************************************************/
 /* Load a routing table to the router.                                       */
 bool load_routing_table(table_t *table, uint32_t app_id)
@@ -106,19 +123,6 @@ bool load_routing_table(table_t *table, uint32_t app_id)
 };
 /*****************************************************************************/
 
-/*****************************************************************************/
-/* Method used to sort routing table entries.                                */
-int compare_rte(const void *va, const void *vb)
-{
-  // Grab the keys and masks
-  keymask_t a = ((entry_t *) va)->keymask;
-  keymask_t b = ((entry_t *) vb)->keymask;
-
-  // Perform the comparison
-  return ((int) keymask_count_xs(a)) - ((int) keymask_count_xs(b));
-}
-/*****************************************************************************/
-
 /*****************************************************************************/
 void c_main(void)
 {
@@ -147,8 +151,7 @@ void c_main(void)
       // that the table be reloaded from memory and that it be sorted in
       // ascending order of generality.
       FREE(table.entries);
-      read_table(&table, header);
-      qsort(table.entries, table.size, sizeof(entry_t), compare_rte);
+      read_sorted_table(&table, header);
 
       // Get the target length of the routing table
       uint32_t target_length = rtr_alloc_max();
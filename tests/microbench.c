@@ -0,0 +1,532 @@
+/* Microbenchmarks of the primitives used by the minimisers.
+ *
+ * Each benchmark times batches of operations on a fixed data structure. The
+ * number of operations in a batch is doubled until a batch takes at least
+ * the target time, and then a number of batches are timed. The report gives
+ * the median time per operation with a distribution-free 95% confidence
+ * interval (from the order statistics), as well as the mean, standard
+ * deviation and the number of outlying batches (more than 3 scaled median
+ * absolute deviations from the median). Changes to a primitive are
+ * significant when the confidence intervals before and after do not overlap.
+ *
+ * Usage: microbenchmarks [-s samples] [-t target_ms] [filter]
+ *
+ * Only benchmarks whose name contains `filter` are run. The report is
+ * tab-separated so that runs can be compared with `diff` or `paste` (see
+ * README.md).
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "routing_table.h"
+#include "merge.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "mtrie.h"
+
+
+// Prevents the results of operations from being optimised away
+static volatile uint32_t sink;
+
+// Random number generator (xorshift32)
+static uint32_t rng = 1;
+
+static uint32_t random32(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+
+static keymask_t random_keymask(void)
+{
+  keymask_t km;
+  km.mask = random32() | random32();  // Mostly 1s
+  km.key = random32() & km.mask;
+  return km;
+}
+
+
+/*****************************************************************************/
+/* Keymasks ******************************************************************/
+
+#define N_KEYMASKS 1024  // Power of two
+static keymask_t keymasks[2][N_KEYMASKS];
+
+static void keymask_setup(unsigned int param)
+{
+  (void) param;
+  for (unsigned int i = 0; i < N_KEYMASKS; i++)
+  {
+    keymasks[0][i] = random_keymask();
+    keymasks[1][i] = random_keymask();
+  }
+}
+
+static void keymask_teardown(void)
+{
+}
+
+static void run_keymask_intersect(unsigned int n_ops)
+{
+  uint32_t n = 0;
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    n += keymask_intersect(keymasks[0][i % N_KEYMASKS],
+                           keymasks[1][(i + i / N_KEYMASKS) % N_KEYMASKS]);
+  }
+  sink = n;
+}
+
+static void run_keymask_merge(unsigned int n_ops)
+{
+  uint32_t n = 0;
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    n ^= keymask_merge(keymasks[0][i % N_KEYMASKS],
+                       keymasks[1][(i + i / N_KEYMASKS) % N_KEYMASKS]).key;
+  }
+  sink = n;
+}
+
+
+/*****************************************************************************/
+/* Insertion points **********************************************************/
+
+#define INSERTION_TABLE_SIZE 4096
+static table_t insertion_table;
+static unsigned int queries[N_KEYMASKS];
+
+// Histograms of generality
+enum {UNIFORM, SKEWED, SINGLE};
+
+static void insertion_setup(unsigned int histogram)
+{
+  insertion_table.size = INSERTION_TABLE_SIZE;
+  insertion_table.entries = malloc(sizeof(entry_t) * INSERTION_TABLE_SIZE);
+
+  // Entries are in order of increasing generality
+  for (unsigned int i = 0; i < INSERTION_TABLE_SIZE; i++)
+  {
+    unsigned int g;
+    if (histogram == UNIFORM)
+    {
+      g = i * N_GENERALITIES / INSERTION_TABLE_SIZE;
+    }
+    else if (histogram == SKEWED)
+    {
+      // Half of the entries have no Xs, a quarter one X and so on
+      g = 0;
+      while (g < 32 &&
+             i >= INSERTION_TABLE_SIZE - (INSERTION_TABLE_SIZE >> g))
+      {
+        g++;
+      }
+      g--;
+    }
+    else
+    {
+      g = 8;
+    }
+
+    entry_t *e = &insertion_table.entries[i];
+    e->keymask.mask = (g < 32) ? ~((1u << g) - 1) : 0;
+    e->keymask.key = 0;
+    e->route = e->source = 0;
+  }
+
+  for (unsigned int i = 0; i < N_KEYMASKS; i++)
+  {
+    queries[i] = 1 + random32() % 32;
+  }
+}
+
+static void insertion_teardown(void)
+{
+  free(insertion_table.entries);
+}
+
+static void run_oc_get_insertion_point(unsigned int n_ops)
+{
+  uint32_t n = 0;
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    n += oc_get_insertion_point(&insertion_table, queries[i % N_KEYMASKS]);
+  }
+  sink = n;
+}
+
+
+/*****************************************************************************/
+/* Merges ********************************************************************/
+
+static table_t merge_table;
+static merge_t merge;
+
+static void merge_setup(unsigned int size)
+{
+  merge_table.size = size;
+  merge_table.entries = malloc(sizeof(entry_t) * size);
+  for (unsigned int i = 0; i < size; i++)
+  {
+    merge_table.entries[i].keymask = random_keymask();
+    merge_table.entries[i].route = 1 << (random32() % 24);
+    merge_table.entries[i].source = 0;
+  }
+
+  merge_init(&merge, &merge_table);
+  for (unsigned int i = 0; i < size; i++)
+  {
+    merge_add(&merge, i);
+  }
+}
+
+static void merge_teardown(void)
+{
+  merge_delete(&merge);
+  free(merge_table.entries);
+}
+
+// Add every entry of the table in turn, clearing the merge when full
+static void run_merge_add(unsigned int n_ops)
+{
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    unsigned int j = i % merge_table.size;
+    if (j == 0)
+    {
+      merge_clear(&merge);
+    }
+    merge_add(&merge, j);
+  }
+  sink = merge.keymask.key;
+}
+
+// Remove (and then add back) each entry of a full merge in turn
+static void run_merge_remove(unsigned int n_ops)
+{
+  for (unsigned int i = 0; i < merge_table.size; i++)
+  {
+    merge_add(&merge, i);
+  }
+
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    unsigned int j = i % merge_table.size;
+    merge_remove(&merge, j);
+    merge_add(&merge, j);
+  }
+  sink = merge.keymask.key;
+}
+
+
+/*****************************************************************************/
+/* Aliases *******************************************************************/
+
+static keymask_t *alias_keys;
+static unsigned int n_alias_keys;
+static unsigned int alias_queries[N_KEYMASKS];  // Indices of keys to find
+static aliases_t aliases;
+
+static void aliases_setup(unsigned int size)
+{
+  n_alias_keys = size;
+  alias_keys = malloc(sizeof(keymask_t) * size);
+  aliases = aliases_init();
+  for (unsigned int i = 0; i < size; i++)
+  {
+    alias_keys[i] = random_keymask();
+    aliases_insert(&aliases, alias_keys[i], NULL);
+  }
+
+  for (unsigned int i = 0; i < N_KEYMASKS; i++)
+  {
+    alias_queries[i] = random32() % size;
+  }
+}
+
+static void aliases_teardown(void)
+{
+  aliases_clear(&aliases);
+  free(alias_keys);
+}
+
+// Look up keys in a tree of the given size
+static void run_aliases_find(unsigned int n_ops)
+{
+  uint32_t n = 0;
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    keymask_t km = alias_keys[alias_queries[i % N_KEYMASKS]];
+    n += aliases_find(&aliases, km) == NULL;
+  }
+  sink = n;
+}
+
+// Build trees of the given size, clearing them when full
+static void run_aliases_insert(unsigned int n_ops)
+{
+  aliases_t a = aliases_init();
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    unsigned int j = i % n_alias_keys;
+    if (j == 0)
+    {
+      aliases_clear(&a);
+    }
+    aliases_insert(&a, alias_keys[j], NULL);
+  }
+  sink = a.count;
+  aliases_clear(&a);
+}
+
+
+/*****************************************************************************/
+/* m-Tries *******************************************************************/
+
+#define MTRIE_SIZE 1024
+static uint32_t mtrie_keys[MTRIE_SIZE];
+
+// Dense keys are consecutive, sparse keys are random
+enum {DENSE, SPARSE};
+
+static void mtrie_setup(unsigned int keyset)
+{
+  for (unsigned int i = 0; i < MTRIE_SIZE; i++)
+  {
+    mtrie_keys[i] = (keyset == DENSE) ? i : random32();
+  }
+}
+
+static void mtrie_teardown(void)
+{
+}
+
+// Build tries of MTRIE_SIZE keys, deleting them when full
+static void run_mtrie_insert(unsigned int n_ops)
+{
+  mtrie_t *root = mtrie_new();
+  for (unsigned int i = 0; i < n_ops; i++)
+  {
+    unsigned int j = i % MTRIE_SIZE;
+    if (j == 0 && i > 0)
+    {
+      mtrie_delete(root);
+      root = mtrie_new();
+    }
+    mtrie_insert(root, mtrie_keys[j], 0xffffffff, 1 << (j % 6));
+  }
+  sink = root->bit;
+  mtrie_delete(root);
+}
+
+
+/*****************************************************************************/
+/* Harness *******************************************************************/
+
+typedef struct _benchmark_t
+{
+  const char *name;
+  const char *param;      // Description of the parameter
+  unsigned int value;     // Parameter passed to setup
+  unsigned int min_ops;   // Fewest operations in a batch
+  void (*setup)(unsigned int value);
+  void (*run)(unsigned int n_ops);
+  void (*teardown)(void);
+} benchmark_t;
+
+
+// Benchmarks which build a structure of `n` elements have batches of at
+// least `n` operations, so that the structure is always built completely.
+#define KEYMASK(name, run) \
+  {name, "-", 0, 1, keymask_setup, run, keymask_teardown}
+#define INSERTION(histogram, value) \
+  {"oc_get_insertion_point", histogram, value, 1, \
+   insertion_setup, run_oc_get_insertion_point, insertion_teardown}
+#define MERGE(name, run, n) \
+  {name, "n=" #n, n, n, merge_setup, run, merge_teardown}
+#define ALIASES(name, run, n) \
+  {name, "n=" #n, n, n, aliases_setup, run, aliases_teardown}
+#define MTRIE(keyset, value) \
+  {"mtrie_insert", keyset, value, MTRIE_SIZE, \
+   mtrie_setup, run_mtrie_insert, mtrie_teardown}
+
+static const benchmark_t benchmarks[] = {
+  KEYMASK("keymask_intersect", run_keymask_intersect),
+  KEYMASK("keymask_merge", run_keymask_merge),
+
+  INSERTION("uniform", UNIFORM),
+  INSERTION("skewed", SKEWED),
+  INSERTION("single", SINGLE),
+
+  MERGE("merge_add", run_merge_add, 64),
+  MERGE("merge_add", run_merge_add, 1024),
+  MERGE("merge_add", run_merge_add, 16384),
+  MERGE("merge_remove", run_merge_remove, 64),
+  MERGE("merge_remove", run_merge_remove, 1024),
+  MERGE("merge_remove", run_merge_remove, 16384),
+
+  ALIASES("aliases_find", run_aliases_find, 16),
+  ALIASES("aliases_find", run_aliases_find, 256),
+  ALIASES("aliases_find", run_aliases_find, 4096),
+  ALIASES("aliases_find", run_aliases_find, 65536),
+  ALIASES("aliases_insert", run_aliases_insert, 16),
+  ALIASES("aliases_insert", run_aliases_insert, 256),
+  ALIASES("aliases_insert", run_aliases_insert, 4096),
+  ALIASES("aliases_insert", run_aliases_insert, 65536),
+
+  MTRIE("dense", DENSE),
+  MTRIE("sparse", SPARSE),
+};
+#define N_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+
+static uint64_t time_batch(const benchmark_t *b, unsigned int n_ops)
+{
+  uint64_t t = now_ns();
+  b->run(n_ops);
+  return now_ns() - t;
+}
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+
+// Get the median of sorted samples
+static double median(double *samples, unsigned int n)
+{
+  return (n % 2) ? samples[n / 2]
+                 : (samples[n/2 - 1] + samples[n / 2]) / 2.0;
+}
+
+
+static void run_benchmark(const benchmark_t *b, unsigned int n_samples,
+                          uint64_t target_ns)
+{
+  rng = 1;  // Every benchmark sees the same data
+  b->setup(b->value);
+
+  // Find a batch size which takes at least the target time (this also warms
+  // up the caches and branch predictors).
+  unsigned int n_ops = b->min_ops;
+  while (time_batch(b, n_ops) < target_ns && n_ops < (1u << 30))
+  {
+    n_ops *= 2;
+  }
+
+  double *samples = malloc(sizeof(double) * n_samples);
+  for (unsigned int i = 0; i < n_samples; i++)
+  {
+    samples[i] = (double) time_batch(b, n_ops) / n_ops;
+  }
+  b->teardown();
+
+  qsort(samples, n_samples, sizeof(double), compare_doubles);
+  double med = median(samples, n_samples);
+
+  // Mean and standard deviation
+  double mean = 0.0, var = 0.0;
+  for (unsigned int i = 0; i < n_samples; i++)
+  {
+    mean += samples[i];
+  }
+  mean /= n_samples;
+  for (unsigned int i = 0; i < n_samples; i++)
+  {
+    var += (samples[i] - mean) * (samples[i] - mean);
+  }
+  double sd = (n_samples > 1) ? sqrt(var / (n_samples - 1)) : 0.0;
+
+  // Confidence interval of the median: the ranks between which the median
+  // lies with 95% probability (normal approximation to the binomial).
+  double half = 1.96 * sqrt(n_samples) / 2.0;
+  int lo = (int) floor(n_samples / 2.0 - half);
+  int hi = (int) ceil(n_samples / 2.0 + half);
+  lo = (lo < 0) ? 0 : lo;
+  hi = (hi > (int) n_samples - 1) ? (int) n_samples - 1 : hi;
+
+  // Count outliers by the scaled median absolute deviation
+  double *deviations = malloc(sizeof(double) * n_samples);
+  for (unsigned int i = 0; i < n_samples; i++)
+  {
+    deviations[i] = fabs(samples[i] - med);
+  }
+  qsort(deviations, n_samples, sizeof(double), compare_doubles);
+  double mad = 1.4826 * median(deviations, n_samples);
+  unsigned int n_outliers = 0;
+  for (unsigned int i = 0; i < n_samples; i++)
+  {
+    n_outliers += fabs(samples[i] - med) > 3.0 * mad;
+  }
+
+  printf("%s\t%s\t%u\t%u\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%u\n", b->name,
+         b->param, n_ops, n_samples, med, samples[lo], samples[hi], mean, sd,
+         n_outliers);
+  fflush(stdout);
+
+  free(deviations);
+  free(samples);
+}
+
+
+int main(int argc, char *argv[])
+{
+  unsigned int n_samples = 31;
+  double target_ms = 2.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:")) != -1)
+  {
+    if (opt == 's')
+    {
+      n_samples = atoi(optarg);
+    }
+    else if (opt == 't')
+    {
+      target_ms = atof(optarg);
+    }
+    else
+    {
+      argc = 0;  // Force the usage message to be printed
+      break;
+    }
+  }
+
+  if (argc == 0 || n_samples == 0 || optind + 1 < argc)
+  {
+    fprintf(stderr, "Usage: microbenchmarks [-s samples] [-t target_ms] "
+                    "[filter]\n");
+    return EXIT_FAILURE;
+  }
+  const char *filter = (optind < argc) ? argv[optind] : "";
+
+  printf("benchmark\tparam\tops_per_sample\tsamples\tmedian_ns\t"
+         "ci95_low_ns\tci95_high_ns\tmean_ns\tsd_ns\toutliers\n");
+  for (unsigned int i = 0; i < N_BENCHMARKS; i++)
+  {
+    if (strstr(benchmarks[i].name, filter) != NULL)
+    {
+      run_benchmark(&benchmarks[i], n_samples, target_ms * 1e6);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -79,15 +79,27 @@ START_TEST(test_aliases_insert)
 
   ck_assert(aliases_contains(&aliases, km3));
   ck_assert(aliases_find(&aliases, km3) == al3);
+  ck_assert_int_eq(aliases.count, 4);
 
   // Check that removing elements works
   aliases_remove(&aliases, km3);
   ck_assert(!aliases_contains(&aliases, km3));
   ck_assert(aliases_find(&aliases, km3) == NULL);
+  ck_assert_int_eq(aliases.count, 3);
+
+  // Removing an element twice makes no difference to the count, reinserting
+  // it or overwriting an element is counted correctly.
+  aliases_remove(&aliases, km3);
+  ck_assert_int_eq(aliases.count, 3);
+  aliases_insert(&aliases, km3, al3);
+  ck_assert_int_eq(aliases.count, 4);
+  aliases_insert(&aliases, km3, al3);
+  ck_assert_int_eq(aliases.count, 4);
 
   // Tidy up
   aliases_clear(&aliases);
-  alias_list_delete(al3);
+  ck_assert_int_eq(aliases.count, 0);
+  ck_assert(aliases.root == NULL);
 }
 END_TEST
 
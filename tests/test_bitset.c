@@ -23,6 +23,10 @@ START_TEST(test_bitset_use)
   ck_assert_int_eq(b.count, 1);
   ck_assert(bitset_contains(&b, 0));
 
+  // Adding the same element again shouldn't change the count
+  ck_assert(bitset_add(&b, 0));
+  ck_assert_int_eq(b.count, 1);
+
   // Add the last element to the set
   ck_assert(bitset_add(&b, 99));
   ck_assert_int_eq(b.count, 2);
@@ -63,6 +67,138 @@ START_TEST(test_bitset_use)
 END_TEST
 
 
+START_TEST(test_bitset_next_set)
+{
+  bitset_t b;
+  bitset_init(&b, 100);
+
+  // An empty set has no members
+  ck_assert_int_eq(bitset_next_set(&b, 0), 100);
+
+  // Add some elements across word boundaries
+  unsigned int members[] = {0, 5, 31, 32, 63, 64, 99};
+  unsigned int n_members = sizeof(members) / sizeof(unsigned int);
+  for (unsigned int i = 0; i < n_members; i++)
+  {
+    bitset_add(&b, members[i]);
+  }
+
+  // Iterate over the members
+  unsigned int n = 0;
+  for (unsigned int i = bitset_next_set(&b, 0);
+       i < b.n_elements;
+       i = bitset_next_set(&b, i + 1))
+  {
+    ck_assert(n < n_members);
+    ck_assert_int_eq(i, members[n++]);
+  }
+  ck_assert_int_eq(n, n_members);
+
+  // Searching from a member returns that member, searching beyond the end
+  // returns the number of elements.
+  ck_assert_int_eq(bitset_next_set(&b, 32), 32);
+  ck_assert_int_eq(bitset_next_set(&b, 33), 63);
+  ck_assert_int_eq(bitset_next_set(&b, 100), 100);
+  ck_assert_int_eq(bitset_next_set(&b, 1000), 100);
+
+  bitset_delete(&b);
+}
+END_TEST
+
+
+START_TEST(test_bitset_prev_set)
+{
+  bitset_t b;
+  bitset_init(&b, 100);
+
+  // An empty set has no members
+  ck_assert_int_eq(bitset_prev_set(&b, 100), 100);
+
+  // Add some elements across word boundaries
+  unsigned int members[] = {0, 5, 31, 32, 63, 64, 99};
+  unsigned int n_members = sizeof(members) / sizeof(unsigned int);
+  for (unsigned int i = 0; i < n_members; i++)
+  {
+    bitset_add(&b, members[i]);
+  }
+
+  // Iterate over the members, last first
+  unsigned int n = n_members;
+  for (unsigned int i = bitset_prev_set(&b, b.n_elements);
+       i < b.n_elements;
+       i = bitset_prev_set(&b, i))
+  {
+    ck_assert(n > 0);
+    ck_assert_int_eq(i, members[--n]);
+  }
+  ck_assert_int_eq(n, 0);
+
+  // Searching excludes the element searched from, searching before the first
+  // element returns the number of elements.
+  ck_assert_int_eq(bitset_prev_set(&b, 64), 63);
+  ck_assert_int_eq(bitset_prev_set(&b, 63), 32);
+  ck_assert_int_eq(bitset_prev_set(&b, 1000), 99);
+  ck_assert_int_eq(bitset_prev_set(&b, 0), 100);
+
+  bitset_delete(&b);
+}
+END_TEST
+
+
+START_TEST(test_bitset_algebra)
+{
+  bitset_t a, b, c, d;
+  bitset_init(&a, 70);
+  bitset_init(&b, 70);
+  bitset_init(&c, 70);
+  bitset_init(&d, 10);
+
+  // a = {1, 40, 69}, b = {40, 50}
+  bitset_add(&a, 1);
+  bitset_add(&a, 40);
+  bitset_add(&a, 69);
+  bitset_add(&b, 40);
+  bitset_add(&b, 50);
+
+  ck_assert(bitset_and(&c, &a, &b));
+  ck_assert_int_eq(c.count, 1);
+  ck_assert(bitset_contains(&c, 40));
+
+  ck_assert(bitset_or(&c, &a, &b));
+  ck_assert_int_eq(c.count, 4);
+  ck_assert(bitset_contains(&c, 1));
+  ck_assert(bitset_contains(&c, 40));
+  ck_assert(bitset_contains(&c, 50));
+  ck_assert(bitset_contains(&c, 69));
+
+  ck_assert(bitset_andnot(&c, &a, &b));
+  ck_assert_int_eq(c.count, 2);
+  ck_assert(bitset_contains(&c, 1));
+  ck_assert(!bitset_contains(&c, 40));
+  ck_assert(bitset_contains(&c, 69));
+
+  // The destination may also be an operand
+  ck_assert(bitset_and(&a, &a, &b));
+  ck_assert_int_eq(a.count, 1);
+  ck_assert(bitset_contains(&a, 40));
+
+  // Bitsets of different sizes can't be combined
+  ck_assert(!bitset_or(&d, &a, &b));
+  ck_assert(!bitset_and(&a, &d, &b));
+
+  // Recounting after modifying the data directly
+  a._data[0] = 0xf;
+  ck_assert_int_eq(bitset_recount(&a), 5);
+  ck_assert_int_eq(a.count, 5);
+
+  bitset_delete(&a);
+  bitset_delete(&b);
+  bitset_delete(&c);
+  bitset_delete(&d);
+}
+END_TEST
+
+
 Suite* bitset_suite(void)
 {
   Suite *s;
@@ -74,6 +210,9 @@ Suite* bitset_suite(void)
 
   // Add the tests
   tcase_add_test(tests, test_bitset_use);
+  tcase_add_test(tests, test_bitset_next_set);
+  tcase_add_test(tests, test_bitset_prev_set);
+  tcase_add_test(tests, test_bitset_algebra);
 
   return s;
 }
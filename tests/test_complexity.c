@@ -0,0 +1,205 @@
+// Count the operations and allocations of the code in this file
+#define OC_STATS
+#define PROFILED
+
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "mtrie.h"
+#include "remove_default_routes.h"
+#include "table_generator.h"
+#include "oc_stats.h"
+#include "profile.h"
+#include <math.h>
+#include <string.h>
+
+
+// Number of tables measured, each twice the size of the last
+#define N_SIZES 4
+
+// Seed of the generated tables
+#define SEED 1
+
+
+// Get the exponent of the growth of a count with the size of the table (the
+// least-squares slope of log(count) against log(size)).
+static double growth_exponent(const unsigned int *sizes,
+                              const uint64_t *counts)
+{
+  double mean_x = 0.0, mean_y = 0.0;
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    mean_x += log(sizes[i]) / N_SIZES;
+    mean_y += log(counts[i] ? counts[i] : 1) / N_SIZES;
+  }
+
+  double xy = 0.0, xx = 0.0;
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    double x = log(sizes[i]) - mean_x;
+    xy += x * (log(counts[i] ? counts[i] : 1) - mean_y);
+    xx += x * x;
+  }
+  return xy / xx;
+}
+
+
+// Assert that a count grows no faster than size^budget
+static void check_growth(const char *name, const unsigned int *sizes,
+                         const uint64_t *counts, double budget)
+{
+  double exponent = growth_exponent(sizes, counts);
+  if (exponent > budget)
+  {
+    fprintf(stderr, "%s grows as n^%.2f, more than n^%.2f:\n", name,
+            exponent, budget);
+    for (unsigned int i = 0; i < N_SIZES; i++)
+    {
+      fprintf(stderr, "  %6u entries: %llu\n", sizes[i],
+              (unsigned long long) counts[i]);
+    }
+  }
+  ck_assert(exponent <= budget);
+}
+
+
+// Generate a table, allocated outside of the profile
+static table_t generate(unsigned int size)
+{
+  table_t generated;
+  ck_assert(generator_table(&generated, size, SEED));
+
+  table_t table = {size, malloc(sizeof(entry_t) * size)};
+  memcpy(table.entries, generated.entries, sizeof(entry_t) * size);
+  FREE(generated.entries);
+  return table;
+}
+
+
+START_TEST(test_growth_exponent)
+{
+  // Exponents are recovered from exact powers
+  unsigned int sizes[N_SIZES] = {100, 200, 400, 800};
+  uint64_t linear[N_SIZES], quadratic[N_SIZES];
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    linear[i] = 3 * sizes[i];
+    quadratic[i] = sizes[i] * sizes[i];
+  }
+  ck_assert(fabs(growth_exponent(sizes, linear) - 1.0) < 1e-9);
+  ck_assert(fabs(growth_exponent(sizes, quadratic) - 2.0) < 1e-9);
+}
+END_TEST
+
+
+START_TEST(test_oc_complexity)
+{
+  // Both the number of merges and the cost of checking each grow with the
+  // table, so Ordered Covering is super-quadratic. The exponents measured for
+  // these tables are 2.64 (intersect_tests), 2.48 (alias_elements_scanned),
+  // 1.97 (bytes_moved) and 1.86 (allocations); each budget is 0.35-0.45
+  // above, so a change which adds even half a factor of the table size fails.
+  unsigned int sizes[N_SIZES];
+  uint64_t intersect_tests[N_SIZES], alias_elements_scanned[N_SIZES];
+  uint64_t bytes_moved[N_SIZES], allocations[N_SIZES];
+
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    sizes[i] = 128 << i;
+    table_t table = generate(sizes[i]);
+
+    profile_init();
+    oc_stats_reset();
+    table_sort_by_generality(&table);
+    aliases_t aliases = aliases_init();
+    oc_minimise(&table, 0, &aliases);
+    aliases_clear(&aliases);
+    ck_assert(table.size < sizes[i]);
+
+    intersect_tests[i] = oc_stats.intersect_tests;
+    alias_elements_scanned[i] = oc_stats.alias_elements_scanned;
+    bytes_moved[i] = oc_stats.bytes_moved;
+    allocations[i] = profile_get()->n_allocations;
+    free(table.entries);
+  }
+
+  check_growth("oc intersect_tests", sizes, intersect_tests, 3.0);
+  check_growth("oc alias_elements_scanned", sizes, alias_elements_scanned,
+               2.9);
+  check_growth("oc bytes_moved", sizes, bytes_moved, 2.4);
+  check_growth("oc allocations", sizes, allocations, 2.25);
+}
+END_TEST
+
+
+START_TEST(test_mtrie_complexity)
+{
+  // m-Trie builds a trie of the entries, which should grow linearly
+  unsigned int sizes[N_SIZES];
+  uint64_t allocations[N_SIZES], peak_bytes[N_SIZES];
+
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    sizes[i] = 512 << i;
+    table_t table = generate(sizes[i]);
+
+    profile_init();
+    mtrie_minimise(&table);
+    ck_assert(table.size < sizes[i]);
+
+    allocations[i] = profile_get()->n_allocations;
+    peak_bytes[i] = profile_get()->peak_bytes;
+    free(table.entries);
+  }
+
+  check_growth("mtrie allocations", sizes, allocations, 1.25);
+  check_growth("mtrie peak_bytes", sizes, peak_bytes, 1.25);
+}
+END_TEST
+
+
+START_TEST(test_remove_default_routes_complexity)
+{
+  // Default route removal indexes the entries it keeps, which should grow
+  // linearly
+  unsigned int sizes[N_SIZES];
+  uint64_t allocations[N_SIZES], peak_bytes[N_SIZES];
+
+  for (unsigned int i = 0; i < N_SIZES; i++)
+  {
+    sizes[i] = 512 << i;
+    table_t table = generate(sizes[i]);
+
+    profile_init();
+    remove_default_routes_minimise(&table);
+    ck_assert(table.size < sizes[i]);
+
+    allocations[i] = profile_get()->n_allocations;
+    peak_bytes[i] = profile_get()->peak_bytes;
+    free(table.entries);
+  }
+
+  check_growth("rdr allocations", sizes, allocations, 1.25);
+  check_growth("rdr peak_bytes", sizes, peak_bytes, 1.25);
+}
+END_TEST
+
+
+Suite* complexity_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Complexity");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_growth_exponent);
+  tcase_add_test(tests, test_oc_complexity);
+  tcase_add_test(tests, test_mtrie_complexity);
+  tcase_add_test(tests, test_remove_default_routes_complexity);
+
+  return s;
+}
@@ -0,0 +1,194 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "constant_columns.h"
+
+
+START_TEST(test_get_map)
+{
+  // Bit 3 is always 1, bit 2 is always 0, bit 1 varies, bit 0 is always X
+  // and the remaining bits are always 0.
+  entry_t entries[] = {
+    {{0xf0000008, 0xfffffffe}, 0b001},
+    {{0xf000000a, 0xfffffffe}, 0b010},
+    {{0xf0000008, 0xfffffffc}, 0b100},
+  };
+  table_t table = {3, entries};
+
+  column_map_t map = columns_get_map(&table);
+  ck_assert(map.varying == 0b0010);
+  ck_assert(map.fixed == 0xfffffffc);
+  ck_assert(map.ones == 0xf0000008);
+  ck_assert_int_eq(map.n_bits, 1);
+}
+END_TEST
+
+
+START_TEST(test_compress_and_expand)
+{
+  entry_t entries[] = {
+    {{0x00010000, 0xffff0003}, 0b001},  // 0x0001 <X...X> 00
+    {{0x00010002, 0xffff0003}, 0b010},  // 0x0001 <X...X> 10
+    {{0x00010001, 0xffff0001}, 0b100},  // 0x0001 <X...X> X1
+  };
+  table_t table = {3, entries};
+
+  column_map_t map = columns_get_map(&table);
+  ck_assert(map.varying == 0b11);
+  ck_assert_int_eq(map.n_bits, 2);
+
+  // Compressed keys only contain the two least significant bits and the
+  // generality of each entry is unchanged.
+  columns_compress(&table, &map);
+  ck_assert(entries[0].keymask.key == 0b00);
+  ck_assert(entries[0].keymask.mask == 0xffffffff);
+  ck_assert(entries[1].keymask.key == 0b10);
+  ck_assert(entries[1].keymask.mask == 0xffffffff);
+  ck_assert(entries[2].keymask.key == 0b01);
+  ck_assert(entries[2].keymask.mask == 0xfffffffd);
+
+  // Expanding should restore the original entries
+  columns_expand(&table, &map);
+  ck_assert(entries[0].keymask.key == 0x00010000);
+  ck_assert(entries[0].keymask.mask == 0xffff0003);
+  ck_assert(entries[1].keymask.key == 0x00010002);
+  ck_assert(entries[1].keymask.mask == 0xffff0003);
+  ck_assert(entries[2].keymask.key == 0x00010001);
+  ck_assert(entries[2].keymask.mask == 0xffff0001);
+}
+END_TEST
+
+
+START_TEST(test_columns_oc_minimise)
+{
+  // The same table as used to test Ordered Covering but with a constant
+  // prefix added to every key.
+  entry_t entries[] = {
+    {{0xab00 | 0b0000, 0xff0f}, 0b000110, 0b100000},
+    {{0xab00 | 0b0001, 0xff0f}, 0b000001, 0b000010},
+    {{0xab00 | 0b0101, 0xff0f}, 0b010000, 0b000010},
+    {{0xab00 | 0b1000, 0xff0f}, 0b000110, 0b100000},
+    {{0xab00 | 0b1001, 0xff0f}, 0b000001, 0b000010},
+    {{0xab00 | 0b1110, 0xff0f}, 0b010000, 0b100000},
+    {{0xab00 | 0b1100, 0xff0f}, 0b000110, 1 << (15 + 6)},
+    {{0xab00 | 0b0100, 0xff0f}, 0b110000, 0b000100}
+  };
+  table_t table = {8, entries};
+
+  // Minimise
+  aliases_t aliases = aliases_init();
+  columns_oc_minimise(&table, 0, &aliases);
+
+  // Check the returned table
+  ck_assert_int_eq(table.size, 4);
+
+  ck_assert_int_eq(table.entries[0].keymask.key, 0xab04);
+  ck_assert_int_eq(table.entries[0].keymask.mask, 0xff0f);
+  ck_assert_int_eq(table.entries[0].route, 0b110000);
+
+  ck_assert_int_eq(table.entries[1].keymask.key, 0xab01);
+  ck_assert_int_eq(table.entries[1].keymask.mask, 0xff07);
+  ck_assert_int_eq(table.entries[1].route, 0b000001);
+
+  ck_assert_int_eq(table.entries[2].keymask.key, 0xab00);
+  ck_assert_int_eq(table.entries[2].keymask.mask, 0xff03);
+  ck_assert_int_eq(table.entries[2].route, 0b000110);
+  ck_assert_int_eq(table.entries[2].source, 1 << (15 + 6) | 0b100000);
+
+  ck_assert_int_eq(table.entries[3].keymask.key, 0xab04);
+  ck_assert_int_eq(table.entries[3].keymask.mask, 0xff04);
+  ck_assert_int_eq(table.entries[3].route, 0b010000);
+
+  // The aliases should be keyed by the expanded keymasks
+  ck_assert(aliases_contains(&aliases, table.entries[2].keymask));
+  alias_list_t *l = aliases_find(&aliases, table.entries[2].keymask);
+  ck_assert_int_eq(alias_list_get(l, 0).keymask.mask, 0xff0f);
+  ck_assert_int_eq(alias_list_get(l, 0).keymask.key & 0xff00, 0xab00);
+
+  // Tidy up
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
+static void trace_generality(oc_trace_record_t *record, void *arg)
+{
+  unsigned int *generality = arg;
+  *generality = record->generality;
+}
+
+
+START_TEST(test_columns_oc_minimise_traced)
+{
+  // The table from `test_columns_oc_minimise`
+  entry_t entries[] = {
+    {{0xab00 | 0b0000, 0xff0f}, 0b000110, 0b100000},
+    {{0xab00 | 0b0001, 0xff0f}, 0b000001, 0b000010},
+    {{0xab00 | 0b0101, 0xff0f}, 0b010000, 0b000010},
+    {{0xab00 | 0b1000, 0xff0f}, 0b000110, 0b100000},
+    {{0xab00 | 0b1001, 0xff0f}, 0b000001, 0b000010},
+    {{0xab00 | 0b1110, 0xff0f}, 0b010000, 0b100000},
+    {{0xab00 | 0b1100, 0xff0f}, 0b000110, 1 << (15 + 6)},
+    {{0xab00 | 0b0100, 0xff0f}, 0b110000, 0b000100}
+  };
+  table_t table = {8, entries};
+
+  aliases_t aliases = aliases_init();
+  unsigned int generality = 0;
+  columns_oc_minimise_traced(&table, 0, &aliases, trace_generality,
+                             &generality);
+  ck_assert_int_eq(table.size, 4);
+
+  // The generality of the last merge, 0xab04/0xff04, should include the
+  // columns which are always X.
+  ck_assert_int_eq(generality, 16 + 4 + 3);
+
+  // Tidy up
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
+START_TEST(test_columns_mtrie_minimise)
+{
+  // m-Trie minimisation of a table with a constant prefix
+  entry_t entries[] = {
+    {{0x12340000, 0xffffffff}, 0b01, 0b10},
+    {{0x12340001, 0xffffffff}, 0b01, 0b01},
+    {{0x12340002, 0xffffffff}, 0b10, 0b01},
+  };
+  table_t table = {3, entries};
+
+  columns_mtrie_minimise(&table);
+
+  ck_assert_int_eq(table.size, 2);
+  ck_assert_int_eq(table.entries[0].keymask.key, 0x12340000);
+  ck_assert_int_eq(table.entries[0].keymask.mask, 0xfffffffe);
+  ck_assert_int_eq(table.entries[0].route, 0b01);
+  ck_assert_int_eq(table.entries[0].source, 0b11);
+
+  ck_assert_int_eq(table.entries[1].keymask.key, 0x12340002);
+  ck_assert_int_eq(table.entries[1].keymask.mask, 0xffffffff);
+  ck_assert_int_eq(table.entries[1].route, 0b10);
+}
+END_TEST
+
+
+Suite* constant_columns_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Constant Columns");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_get_map);
+  tcase_add_test(tests, test_compress_and_expand);
+  tcase_add_test(tests, test_columns_oc_minimise);
+  tcase_add_test(tests, test_columns_oc_minimise_traced);
+  tcase_add_test(tests, test_columns_mtrie_minimise);
+
+  return s;
+}
@@ -0,0 +1,225 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "mtrie.h"
+#include "remove_default_routes.h"
+#include "table_generator.h"
+#include "equivalence.h"
+
+
+// Find the first entry of a table which matches a key, or NULL
+static entry_t* lookup(table_t *table, uint32_t key)
+{
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    keymask_t km = table->entries[i].keymask;
+    if ((key & km.mask) == km.key)
+    {
+      return &table->entries[i];
+    }
+  }
+  return NULL;
+}
+
+
+// Copy a table so that it can be minimised
+static table_t copy_table(table_t *table)
+{
+  table_t copy = {table->size, malloc(sizeof(entry_t) * table->size)};
+  memcpy(copy.entries, table->entries, sizeof(entry_t) * table->size);
+  return copy;
+}
+
+
+START_TEST(test_identical_tables)
+{
+  entry_t entries[] = {
+    {{0b0000, 0b1111}, 0b001, 0},
+    {{0b0001, 0b1111}, 0b010, 0},
+    {{0b0000, 0b1100}, 0b100, 0},  // Partially hidden by the entries above
+    {{0b0000, 0b0000}, 0b011, 0},  // Catch-all
+  };
+  table_t table = {4, entries};
+
+  equivalence_t e = equivalence_check(&table, &table);
+  ck_assert(e.equivalent);
+
+  // Every key is a don't-care for an empty table, but an empty table drops
+  // every key of any other (unless they are default-routable).
+  table_t empty = {0, NULL};
+  ck_assert(equivalence_check(&empty, &empty).equivalent);
+  ck_assert(equivalence_check(&empty, &table).equivalent);
+  ck_assert(!equivalence_check(&table, &empty).equivalent);
+}
+END_TEST
+
+
+START_TEST(test_minimised_tables)
+{
+  // Tables minimised by every algorithm are equivalent to the originals
+  table_t original;
+  generator_table(&original, 1000, 3);
+
+  table_t oc = copy_table(&original);
+  table_sort_by_generality(&oc);
+  aliases_t aliases = aliases_init();
+  oc_minimise(&oc, 0, &aliases);
+  aliases_clear(&aliases);
+  ck_assert(oc.size < original.size);
+  ck_assert(equivalence_check(&original, &oc).equivalent);
+
+  table_t mtrie = copy_table(&original);
+  mtrie_minimise(&mtrie);
+  ck_assert(mtrie.size < original.size);
+  ck_assert(equivalence_check(&original, &mtrie).equivalent);
+
+  table_t rdr = copy_table(&original);
+  remove_default_routes_minimise(&rdr);
+  ck_assert(rdr.size < original.size);
+  ck_assert(equivalence_check(&original, &rdr).equivalent);
+
+  free(oc.entries);
+  free(mtrie.entries);
+  free(rdr.entries);
+  FREE(original.entries);
+}
+END_TEST
+
+
+START_TEST(test_changed_route)
+{
+  entry_t original[] = {
+    {{0b0000, 0b1110}, 0b001, 0},  // 000X
+    {{0b0010, 0b1110}, 0b001, 0},  // 001X
+    {{0b0100, 0b1100}, 0b010, 0},  // 01XX
+  };
+  entry_t minimised[] = {
+    {{0b0000, 0b1100}, 0b001, 0},  // 00XX
+    {{0b0100, 0b1100}, 0b010, 0},  // 01XX
+    {{0b0000, 0b0000}, 0b100, 0},  // Catch-all, only matches don't-cares
+  };
+  table_t t_original = {3, original}, t_minimised = {3, minimised};
+  ck_assert(equivalence_check(&t_original, &t_minimised).equivalent);
+
+  // Change the route of a single key
+  entry_t changed[] = {
+    {{0b0110, 0b1111}, 0b100, 0},  // 0110
+    {{0b0000, 0b1100}, 0b001, 0},  // 00XX
+    {{0b0100, 0b1100}, 0b010, 0},  // 01XX
+  };
+  table_t t_changed = {3, changed};
+  equivalence_t e = equivalence_check(&t_original, &t_changed);
+  ck_assert(!e.equivalent);
+  ck_assert_int_eq(e.key, 0b0110);
+  ck_assert_int_eq(e.original, 0b010);
+  ck_assert(e.matched);
+  ck_assert_int_eq(e.route, 0b100);
+}
+END_TEST
+
+
+START_TEST(test_missing_entry)
+{
+  entry_t original[] = {
+    {{0b0000, 0b1111}, 0b001, 0},
+    {{0b1000, 0b1000}, 0b010, 0},  // 1XXX
+  };
+  entry_t minimised[] = {
+    {{0b0000, 0b1111}, 0b001, 0},
+    {{0b1000, 0b1100}, 0b010, 0},  // 10XX
+  };
+  table_t t_original = {2, original}, t_minimised = {2, minimised};
+
+  // Keys 11XX are not routed by the minimised table
+  equivalence_t e = equivalence_check(&t_original, &t_minimised);
+  ck_assert(!e.equivalent);
+  ck_assert_int_eq(e.key & 0b1100, 0b1100);
+  ck_assert_int_eq(e.original, 0b010);
+  ck_assert(!e.matched);
+  ck_assert(lookup(&t_minimised, e.key) == NULL);
+
+  // Unless the entry was default-routable (arriving from the west, leaving
+  // to the east).
+  original[1].source = 1 << 3;
+  original[1].route = 1 << 0;
+  minimised[1].route = 1 << 0;
+  ck_assert(equivalence_check(&t_original, &t_minimised).equivalent);
+}
+END_TEST
+
+
+START_TEST(test_order_matters)
+{
+  entry_t original[] = {
+    {{0b0000, 0b1111}, 0b001, 0},  // 0000
+    {{0b0000, 0b1100}, 0b010, 0},  // 00XX
+  };
+  entry_t swapped[] = {
+    {{0b0000, 0b1100}, 0b010, 0},  // 00XX
+    {{0b0000, 0b1111}, 0b001, 0},  // 0000, hidden
+  };
+  table_t t_original = {2, original}, t_swapped = {2, swapped};
+
+  equivalence_t e = equivalence_check(&t_original, &t_swapped);
+  ck_assert(!e.equivalent);
+  ck_assert_int_eq(e.key, 0b0000);
+  ck_assert_int_eq(e.original, 0b001);
+  ck_assert_int_eq(e.route, 0b010);
+}
+END_TEST
+
+
+START_TEST(test_counterexamples_are_real)
+{
+  // Corrupt single entries of a minimised table, any counterexample must be
+  // routed differently by the two tables.
+  table_t original;
+  generator_table(&original, 500, 5);
+  table_t minimised = copy_table(&original);
+  mtrie_minimise(&minimised);
+
+  for (unsigned int i = 0; i < minimised.size; i += 7)
+  {
+    uint32_t route = minimised.entries[i].route;
+    minimised.entries[i].route ^= 1 << 7;
+
+    equivalence_t e = equivalence_check(&original, &minimised);
+    ck_assert(!e.equivalent);
+    entry_t *o = lookup(&original, e.key);
+    entry_t *m = lookup(&minimised, e.key);
+    ck_assert(o != NULL);
+    ck_assert_int_eq(o->route, e.original);
+    ck_assert(e.matched == (m != NULL));
+    ck_assert(m == NULL || m->route == e.route);
+    ck_assert(m == NULL || m->route != o->route);
+
+    minimised.entries[i].route = route;
+  }
+  ck_assert(equivalence_check(&original, &minimised).equivalent);
+
+  free(minimised.entries);
+  FREE(original.entries);
+}
+END_TEST
+
+
+Suite* equivalence_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Equivalence");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_identical_tables);
+  tcase_add_test(tests, test_minimised_tables);
+  tcase_add_test(tests, test_changed_route);
+  tcase_add_test(tests, test_missing_entry);
+  tcase_add_test(tests, test_order_matters);
+  tcase_add_test(tests, test_counterexamples_are_real);
+
+  return s;
+}
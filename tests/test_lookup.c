@@ -0,0 +1,238 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "mtrie.h"
+#include "table_generator.h"
+#include "lookup.h"
+
+
+// Get the index of the first entry of a table which matches a key by
+// scanning every entry
+static uint32_t scan(table_t *table, uint32_t key)
+{
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    keymask_t km = table->entries[i].keymask;
+    if ((key & km.mask) == (km.key & km.mask))
+    {
+      return i;
+    }
+  }
+  return LOOKUP_MISS;
+}
+
+
+// Check that lookups, one at a time and in batches, agree with a scan of the
+// table for keys matching its entries and for arbitrary keys
+static void check_lookups(table_t *table, unsigned int n_keys)
+{
+  lookup_t l = lookup_init(table);
+
+  uint32_t *keys = malloc(sizeof(uint32_t) * n_keys);
+  uint32_t *indices = malloc(sizeof(uint32_t) * n_keys);
+  uint64_t x = 88172645463325252ull;
+  for (unsigned int i = 0; i < n_keys; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    keys[i] = x >> 32;
+
+    if (table->size > 0 && (i % 4) != 0)
+    {
+      // Fill the Xs of an entry at random
+      keymask_t km = table->entries[x % table->size].keymask;
+      keys[i] = (km.key & km.mask) | (keys[i] & ~km.mask);
+    }
+  }
+
+  lookup_batch(&l, keys, n_keys, indices);
+  for (unsigned int i = 0; i < n_keys; i++)
+  {
+    uint32_t expected = scan(table, keys[i]);
+    ck_assert_int_eq(lookup(&l, keys[i]), expected);
+    ck_assert_int_eq(indices[i], expected);
+  }
+
+  free(keys);
+  free(indices);
+  lookup_delete(&l);
+}
+
+
+START_TEST(test_lookup_empty)
+{
+  table_t table = {0, NULL};
+  lookup_t l = lookup_init(&table);
+  ck_assert(!l.linear);
+  ck_assert_int_eq(l.depth, 0);
+  ck_assert_int_eq(lookup(&l, 0x0), LOOKUP_MISS);
+  ck_assert_int_eq(lookup(&l, 0xffffffff), LOOKUP_MISS);
+  lookup_delete(&l);
+
+  check_lookups(&table, 100);
+}
+END_TEST
+
+
+START_TEST(test_lookup_first_match)
+{
+  entry_t entries[] = {
+    {{0b0000, 0b1111}, 0b001, 0},
+    {{0b0001, 0b1111}, 0b010, 0},
+    {{0b0000, 0b1100}, 0b100, 0},  // Partially hidden by the entries above
+    {{0b1000, 0b1000}, 0b011, 0},
+    {{0b1000, 0b1100}, 0b101, 0},  // Hidden by the entry above
+  };
+  table_t table = {5, entries};
+
+  lookup_t l = lookup_init(&table);
+  ck_assert_int_eq(lookup(&l, 0b0000), 0);
+  ck_assert_int_eq(lookup(&l, 0b0001), 1);
+  ck_assert_int_eq(lookup(&l, 0b0010), 2);
+  ck_assert_int_eq(lookup(&l, 0b1010), 3);
+  ck_assert_int_eq(lookup(&l, 0b0100), LOOKUP_MISS);
+  lookup_delete(&l);
+
+  check_lookups(&table, 1000);
+}
+END_TEST
+
+
+START_TEST(test_lookup_tree)
+{
+  // Tables too large for a single leaf are compiled into a tree
+  table_t original;
+  generator_table(&original, 5000, 11);
+
+  lookup_t l = lookup_init(&original);
+  ck_assert(!l.linear);
+  ck_assert(l.depth > 0);
+  lookup_delete(&l);
+
+  check_lookups(&original, 20000);
+
+  // Including once minimised, when entries overlap
+  table_t minimised = {original.size, malloc(sizeof(entry_t) * original.size)};
+  memcpy(minimised.entries, original.entries,
+         sizeof(entry_t) * original.size);
+  mtrie_minimise(&minimised);
+  ck_assert(minimised.size < original.size);
+
+  l = lookup_init(&minimised);
+  ck_assert(!l.linear);
+  lookup_delete(&l);
+
+  check_lookups(&minimised, 20000);
+
+  free(minimised.entries);
+  FREE(original.entries);
+}
+END_TEST
+
+
+START_TEST(test_lookup_catch_all)
+{
+  // Entries after a catch-all are never reached
+  entry_t entries[100];
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    entries[i].keymask.key = i << 4;
+    entries[i].keymask.mask = 0xfffffff0;
+    entries[i].route = i;
+    entries[i].source = 0;
+  }
+  entries[10].keymask.key = entries[10].keymask.mask = 0;
+  table_t table = {100, entries};
+
+  lookup_t l = lookup_init(&table);
+  ck_assert_int_eq(l.depth, 1);
+  ck_assert_int_eq(lookup(&l, 50 << 4), 10);
+  lookup_delete(&l);
+
+  check_lookups(&table, 1000);
+}
+END_TEST
+
+
+START_TEST(test_lookup_uneven)
+{
+  // Leaves of a tree may be at different depths, and batches of keys are
+  // still walked through the shallower leaves until the deepest is reached.
+  entry_t entries[32];
+  for (unsigned int i = 0; i < 16; i++)
+  {
+    entries[i].keymask.key = i << 4;
+    entries[i].keymask.mask = 0xfffffff0;
+    entries[i].route = i;
+    entries[i].source = 0;
+
+    entries[16 + i].keymask.key = 0x80000000 | (i << 24);
+    entries[16 + i].keymask.mask = 0xff000000;
+    entries[16 + i].route = 16 + i;
+    entries[16 + i].source = 0;
+  }
+  table_t table = {32, entries};
+
+  lookup_t l = lookup_init(&table);
+  ck_assert(!l.linear);
+  ck_assert_int_eq(l.depth, 2);
+
+  // Some leaves are children of the root
+  bool shallow_leaf = false;
+  lookup_node_t *root = &l.nodes[l.root];
+  for (unsigned int i = 0; i < (1u << __builtin_popcount(root->bits)); i++)
+  {
+    shallow_leaf |= l.nodes[root->children + i].leaf != _LOOKUP_INTERNAL;
+  }
+  ck_assert(shallow_leaf);
+  lookup_delete(&l);
+
+  check_lookups(&table, 1000);
+}
+END_TEST
+
+
+START_TEST(test_lookup_linear)
+{
+  // Entries which each fix a different single bit would be copied into
+  // nearly every leaf of a tree, so are scanned instead.
+  entry_t entries[32];
+  for (unsigned int i = 0; i < 32; i++)
+  {
+    entries[i].keymask.key = entries[i].keymask.mask = 1u << i;
+    entries[i].route = i;
+    entries[i].source = 0;
+  }
+  table_t table = {32, entries};
+
+  lookup_t l = lookup_init(&table);
+  ck_assert(l.linear);
+  ck_assert_int_eq(lookup(&l, 0x0), LOOKUP_MISS);
+  ck_assert_int_eq(lookup(&l, 0x80000000), 31);
+  ck_assert_int_eq(lookup(&l, 0x80000100), 8);
+  lookup_delete(&l);
+
+  check_lookups(&table, 1000);
+}
+END_TEST
+
+
+Suite* lookup_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Lookup");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_lookup_empty);
+  tcase_add_test(tests, test_lookup_first_match);
+  tcase_add_test(tests, test_lookup_tree);
+  tcase_add_test(tests, test_lookup_catch_all);
+  tcase_add_test(tests, test_lookup_uneven);
+  tcase_add_test(tests, test_lookup_linear);
+
+  return s;
+}
@@ -0,0 +1,215 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "merge_history.h"
+#include "ordered_covering.h"
+#include <string.h>
+
+
+START_TEST(test_merge_history_append)
+{
+  merge_history_t h = merge_history_init();
+  ck_assert_int_eq(h.n_merges, 0);
+
+  // Add enough merges that the history must grow
+  for (unsigned int i = 0; i < 40; i++)
+  {
+    keymask_t km = {i, 0xff};
+    merge_history_append(&h, km, 1 << (i % 6));
+  }
+
+  ck_assert_int_eq(h.n_merges, 40);
+  for (unsigned int i = 0; i < 40; i++)
+  {
+    ck_assert_int_eq(h.merges[i].keymask.key, i);
+    ck_assert_int_eq(h.merges[i].keymask.mask, 0xff);
+    ck_assert_int_eq(h.merges[i].route, 1 << (i % 6));
+  }
+
+  merge_history_clear(&h);
+  ck_assert_int_eq(h.n_merges, 0);
+
+  merge_history_delete(&h);
+}
+END_TEST
+
+
+START_TEST(test_merge_record_covers)
+{
+  merge_record_t r = {{0b0100, 0b0110}, 0x1};  // X10X
+
+  keymask_t km_a = {0b0100, 0b1111};  // 0100
+  keymask_t km_b = {0b1101, 0b1111};  // 1101
+  keymask_t km_c = {0b0100, 0b0100};  // X1XX
+  keymask_t km_d = {0b0110, 0b1111};  // 0110
+
+  ck_assert(merge_record_covers(&r, km_a));
+  ck_assert(merge_record_covers(&r, km_b));
+  ck_assert(!merge_record_covers(&r, km_c));
+  ck_assert(!merge_record_covers(&r, km_d));
+}
+END_TEST
+
+
+// Table used to test Ordered Covering (see `test_ordered_covering_full`)
+static entry_t oc_entries[] = {
+  {{0b0000, 0xf}, 0b000110, 0b100000},
+  {{0b0001, 0xf}, 0b000001, 0b000010},
+  {{0b0101, 0xf}, 0b010000, 0b000010},
+  {{0b1000, 0xf}, 0b000110, 0b100000},
+  {{0b1001, 0xf}, 0b000001, 0b000010},
+  {{0b1110, 0xf}, 0b010000, 0b100000},
+  {{0b1100, 0xf}, 0b000110, 1 << (15 + 6)},
+  {{0b0100, 0xf}, 0b110000, 0b000100}
+};
+
+
+START_TEST(test_replay_identical_table)
+{
+  // Minimise the table, recording the merges
+  entry_t entries_a[8];
+  memcpy(entries_a, oc_entries, sizeof(oc_entries));
+  table_t table_a = {8, entries_a};
+  aliases_t aliases_a = aliases_init();
+  merge_history_t history = merge_history_init();
+
+  oc_minimise_warm(&table_a, 0, &aliases_a, NULL, &history);
+  ck_assert_int_eq(table_a.size, 4);
+  ck_assert_int_eq(history.n_merges, 3);
+
+  // Replaying the history against the same table should apply every merge
+  // and give the same result.
+  entry_t entries_b[8];
+  memcpy(entries_b, oc_entries, sizeof(oc_entries));
+  table_t table_b = {8, entries_b};
+  aliases_t aliases_b = aliases_init();
+  merge_history_t replayed = merge_history_init();
+
+  oc_replay(&table_b, 0, &aliases_b, &history, &replayed);
+  ck_assert_int_eq(table_b.size, 4);
+  ck_assert_int_eq(replayed.n_merges, 3);
+  ck_assert(memcmp(entries_a, entries_b, sizeof(entry_t) * 4) == 0);
+
+  // Continuing minimisation makes no difference
+  oc_minimise_warm(&table_b, 0, &aliases_b, NULL, &replayed);
+  ck_assert_int_eq(table_b.size, 4);
+  ck_assert_int_eq(replayed.n_merges, 3);
+
+  // Tidy up
+  aliases_clear(&aliases_a);
+  aliases_clear(&aliases_b);
+  merge_history_delete(&history);
+  merge_history_delete(&replayed);
+}
+END_TEST
+
+
+START_TEST(test_replay_drops_invalid_merges)
+{
+  // A merge of 0000 and 0011 to form 00XX was valid for a previous table
+  merge_history_t history = merge_history_init();
+  keymask_t merged = {0b0000, 0b1100};
+  merge_history_append(&history, merged, 0b01);
+
+  // But in this table 00XX would cover the keys 0001 and 0010 which should
+  // be routed by 0XXX.
+  entry_t entries[] = {
+    {{0b0000, 0xf}, 0b01, 0x0},
+    {{0b0011, 0xf}, 0b01, 0x0},
+    {{0b0000, 0x8}, 0b10, 0x0},
+  };
+  table_t table = {3, entries};
+  aliases_t aliases = aliases_init();
+  merge_history_t record = merge_history_init();
+
+  oc_minimise_warm(&table, 0, &aliases, &history, &record);
+
+  // No merge should have been made
+  ck_assert_int_eq(table.size, 3);
+  ck_assert_int_eq(record.n_merges, 0);
+  ck_assert_int_eq(entries[0].keymask.key, 0b0000);
+  ck_assert_int_eq(entries[1].keymask.key, 0b0011);
+  ck_assert_int_eq(entries[2].keymask.mask, 0x8);
+
+  // Tidy up
+  aliases_clear(&aliases);
+  merge_history_delete(&history);
+  merge_history_delete(&record);
+}
+END_TEST
+
+
+START_TEST(test_replay_similar_table)
+{
+  // The OC test table with one entry removed, the merges which involved it
+  // should be adapted and minimisation should then continue as normal.
+  entry_t entries_a[8];
+  memcpy(entries_a, oc_entries, sizeof(oc_entries));
+  table_t table_a = {8, entries_a};
+  aliases_t aliases_a = aliases_init();
+  merge_history_t history = merge_history_init();
+  oc_minimise_warm(&table_a, 0, &aliases_a, NULL, &history);
+
+  entry_t entries_b[7], entries_c[7];
+  memcpy(entries_b, oc_entries, sizeof(entry_t) * 7);
+  memcpy(entries_c, oc_entries, sizeof(entry_t) * 7);
+  table_t table_b = {7, entries_b}, table_c = {7, entries_c};
+  aliases_t aliases_b = aliases_init(), aliases_c = aliases_init();
+
+  oc_minimise_warm(&table_b, 0, &aliases_b, &history, NULL);
+  oc_minimise(&table_c, 0, &aliases_c);
+
+  // Every key matched by the original table must be routed the same way
+  for (uint32_t key = 0; key < 16; key++)
+  {
+    keymask_t km = {key, 0xffffffff};
+    int route = -1, route_b = -1;
+    for (unsigned int i = 0; i < 7 && route < 0; i++)
+    {
+      if (keymask_intersect(oc_entries[i].keymask, km))
+      {
+        route = oc_entries[i].route;
+      }
+    }
+    for (unsigned int i = 0; i < table_b.size && route_b < 0; i++)
+    {
+      if (keymask_intersect(entries_b[i].keymask, km))
+      {
+        route_b = entries_b[i].route;
+      }
+    }
+
+    if (route >= 0)
+    {
+      ck_assert_int_eq(route_b, route);
+    }
+  }
+  ck_assert_int_eq(table_b.size, table_c.size);
+
+  // Tidy up
+  aliases_clear(&aliases_a);
+  aliases_clear(&aliases_b);
+  aliases_clear(&aliases_c);
+  merge_history_delete(&history);
+}
+END_TEST
+
+
+Suite* merge_history_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Merge History");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_merge_history_append);
+  tcase_add_test(tests, test_merge_record_covers);
+  tcase_add_test(tests, test_replay_identical_table);
+  tcase_add_test(tests, test_replay_drops_invalid_merges);
+  tcase_add_test(tests, test_replay_similar_table);
+
+  return s;
+}
@@ -1,5 +1,7 @@
 #include "tests.h"
 #include "mtrie.h"
+#include "table_generator.h"
+#include <string.h>
 
 
 START_TEST(test_insert_and_count)
@@ -236,6 +238,123 @@ START_TEST(test_mtrie_minimise)
 END_TEST
 
 
+// Count the number of nodes in a (mutable) m-Trie
+static unsigned int count_nodes(mtrie_t *node)
+{
+  if (node == NULL)
+  {
+    return 0;
+  }
+
+  return 1 + count_nodes(node->child_0) +
+             count_nodes(node->child_1) +
+             count_nodes(node->child_X);
+}
+
+
+START_TEST(test_share_identical_subtries)
+{
+  // Two populations (0x1_ and 0x2_) with the same pattern of entries should
+  // result in their subtries being shared.
+  uint32_t keys[] = {0x10, 0x13, 0x20, 0x23};
+  mtrie_t *root = mtrie_new();
+  mtrie_pool_t pool;
+  mtrie_pool_init(&pool);
+  mtrie_shared_t *shared = NULL;
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    mtrie_insert(root, keys[i], 0xff, 0b1);
+    shared = mtrie_shared_insert(&pool, shared, 1u << 31, keys[i], 0xff, 0b1);
+  }
+
+  unsigned int n_entries = mtrie_count(root);
+  ck_assert_int_eq(n_entries, 4);
+
+  mtrie_entry_t expected[4];
+  mtrie_get_entries(root, expected);
+
+  // Fewer nodes should be required, even while the trie is being built, but
+  // the entries should be the same
+  ck_assert(pool.n_nodes < count_nodes(root));
+  ck_assert_int_eq(mtrie_shared_count(shared), n_entries);
+
+  mtrie_entry_t entries[4];
+  mtrie_shared_get_entries(shared, entries);
+  for (unsigned int i = 0; i < n_entries; i++)
+  {
+    ck_assert_int_eq(entries[i].keymask.key, expected[i].keymask.key);
+    ck_assert_int_eq(entries[i].keymask.mask, expected[i].keymask.mask);
+    ck_assert_int_eq(entries[i].source, expected[i].source);
+  }
+
+  // Releasing the root should empty the pool
+  mtrie_pool_release(&pool, shared);
+  ck_assert_int_eq(pool.n_nodes, 0);
+  mtrie_pool_delete(&pool);
+  mtrie_delete(root);
+}
+END_TEST
+
+
+START_TEST(test_mtrie_minimise_shared)
+{
+  // Test that minimising with shared nodes gives the same result as without
+  entry_t entries[] = {
+    {{0b0000, 0xf}, 0b000110, 0b100000},
+    {{0b0001, 0xf}, 0b000110, 0b010000},
+    {{0b0010, 0xf}, 0b000001, 0b000100},
+    {{0b0011, 0xf}, 0b000001, 0b100000},
+    {{0b0100, 0xe}, 0b010000, 0b000100},
+    {{0b0110, 0xf}, 0b010000, 0b000100},
+    {{0b0111, 0xf}, 0b010000, 0b000100},
+    {{0b1010, 0xf}, 0b000100, 0b001000},
+    {{0b1001, 0xf}, 0b000100, 0b001000},
+  };
+  entry_t shared_entries[sizeof(entries) / sizeof(entry_t)];
+  for (unsigned int i = 0; i < sizeof(entries) / sizeof(entry_t); i++)
+  {
+    shared_entries[i] = entries[i];
+  }
+
+  table_t table = {sizeof(entries) / sizeof(entry_t), entries};
+  table_t shared = {sizeof(entries) / sizeof(entry_t), shared_entries};
+
+  // Minimise the tables
+  mtrie_minimise(&table);
+  mtrie_minimise_shared(&shared);
+
+  // Check the tables are the same
+  ck_assert_int_eq(shared.size, table.size);
+  for (unsigned int i = 0; i < table.size; i++)
+  {
+    ck_assert_int_eq(shared.entries[i].keymask.key, table.entries[i].keymask.key);
+    ck_assert_int_eq(shared.entries[i].keymask.mask,
+                     table.entries[i].keymask.mask);
+    ck_assert_int_eq(shared.entries[i].route, table.entries[i].route);
+    ck_assert_int_eq(shared.entries[i].source, table.entries[i].source);
+  }
+
+  // Including for larger tables, in which many entries are merged
+  for (unsigned int seed = 1; seed <= 4; seed++)
+  {
+    table_t original;
+    ck_assert(generator_table(&original, 2000, seed));
+    table_t copy = {original.size, malloc(sizeof(entry_t) * original.size)};
+    memcpy(copy.entries, original.entries, sizeof(entry_t) * original.size);
+
+    mtrie_minimise(&original);
+    mtrie_minimise_shared(&copy);
+    ck_assert_int_eq(copy.size, original.size);
+    ck_assert(memcmp(copy.entries, original.entries,
+                     sizeof(entry_t) * original.size) == 0);
+
+    free(copy.entries);
+    FREE(original.entries);
+  }
+}
+END_TEST
+
+
 Suite* mtrie_suite(void)
 {
   Suite *s;
@@ -258,5 +377,8 @@ Suite* mtrie_suite(void)
 
   tcase_add_test(tests, test_mtrie_minimise);
 
+  tcase_add_test(tests, test_share_identical_subtries);
+  tcase_add_test(tests, test_mtrie_minimise_shared);
+
   return s;
 }
@@ -0,0 +1,86 @@
+// Gather statistics from the Ordered Covering in this file
+#define OC_STATS
+
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "oc_stats.h"
+#include <string.h>
+
+
+START_TEST(test_oc_stats_reset)
+{
+  oc_stats.merges_applied = 5;
+  oc_stats.phase_ns[OC_PHASE_APPLY] = 10;
+  oc_stats_reset();
+
+  ck_assert_int_eq(oc_stats.merges_applied, 0);
+  ck_assert_int_eq(oc_stats.phase_ns[OC_PHASE_APPLY], 0);
+}
+END_TEST
+
+
+START_TEST(test_oc_stats_minimise)
+{
+  // Table used to test Ordered Covering (see `test_ordered_covering_full`)
+  entry_t entries[] = {
+    {{0b0000, 0xf}, 0b000110, 0b100000},
+    {{0b0001, 0xf}, 0b000001, 0b000010},
+    {{0b0101, 0xf}, 0b010000, 0b000010},
+    {{0b1000, 0xf}, 0b000110, 0b100000},
+    {{0b1001, 0xf}, 0b000001, 0b000010},
+    {{0b1110, 0xf}, 0b010000, 0b100000},
+    {{0b1100, 0xf}, 0b000110, 1 << (15 + 6)},
+    {{0b0100, 0xf}, 0b110000, 0b000100}
+  };
+  table_t table = {8, entries};
+  aliases_t aliases = aliases_init();
+
+  oc_stats_reset();
+  oc_minimise(&table, 0, &aliases);
+  ck_assert_int_eq(table.size, 4);
+
+  // Three merges were applied, each of which rewrote the table
+  ck_assert_int_eq(oc_stats.merges_applied, 3);
+  ck_assert(oc_stats.bytes_moved >= 3 * 4 * sizeof(entry_t));
+  ck_assert(oc_stats.bytes_moved <= 3 * 8 * sizeof(entry_t));
+
+  // Every merge was checked
+  ck_assert(oc_stats.intersect_tests > 0);
+  ck_assert(oc_stats.downcheck_rounds >= 3);
+
+  // Each alias element scanned is tested for intersection
+  ck_assert(oc_stats.alias_elements_scanned <= oc_stats.intersect_tests);
+
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
+START_TEST(test_oc_phase_name)
+{
+  ck_assert_str_eq(oc_phase_name(OC_PHASE_GROUP), "group");
+  ck_assert_str_eq(oc_phase_name(OC_PHASE_DOWNCHECK), "downcheck");
+  ck_assert_str_eq(oc_phase_name(OC_PHASE_UPCHECK), "upcheck");
+  ck_assert_str_eq(oc_phase_name(OC_PHASE_APPLY), "apply");
+}
+END_TEST
+
+
+Suite* oc_stats_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Ordered Covering Statistics");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_oc_stats_reset);
+  tcase_add_test(tests, test_oc_stats_minimise);
+  tcase_add_test(tests, test_oc_phase_name);
+
+  return s;
+}
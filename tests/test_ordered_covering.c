@@ -4,6 +4,9 @@
 #include "aliases.h"
 
 #include "ordered_covering.h"
+#include "table_generator.h"
+#include "equivalence.h"
+#include <string.h>
 
 
 START_TEST(test_get_insertion_point_at_beginning_of_table)
@@ -764,6 +767,245 @@ START_TEST(test_ordered_covering_terminates_early)
 END_TEST
 
 
+START_TEST(test_ordered_covering_reminimise)
+{
+  // The table from `test_ordered_covering_full`
+  entry_t original[] = {
+    {{0b0000, 0xf}, 0b000110, 0b100000},
+    {{0b0001, 0xf}, 0b000001, 0b000010},
+    {{0b0101, 0xf}, 0b010000, 0b000010},
+    {{0b1000, 0xf}, 0b000110, 0b100000},
+    {{0b1001, 0xf}, 0b000001, 0b000010},
+    {{0b1110, 0xf}, 0b010000, 0b100000},
+    {{0b1100, 0xf}, 0b000110, 1 << (15 + 6)},
+    {{0b0100, 0xf}, 0b110000, 0b000100}
+  };
+  table_t table = {8, MALLOC(sizeof(original))};
+  memcpy(table.entries, original, sizeof(original));
+
+  aliases_t aliases = aliases_init();
+  oc_minimise(&table, 0, &aliases);
+  ck_assert_int_eq(table.size, 4);
+
+  // Remove 0101 (which was merged to form X1XX) and add 0111 (which
+  // intersects X1XX).
+  entry_t deleted_entries[] = {{{0b0101, 0xf}, 0b010000, 0b000010}};
+  entry_t inserted_entries[] = {{{0b0111, 0xf}, 0b000001, 0b000010}};
+  table_t deleted = {1, deleted_entries};
+  table_t inserted = {1, inserted_entries};
+
+  ck_assert(oc_reminimise(&table, 0, &aliases, &inserted, &deleted));
+  ck_assert(table.size <= 5);
+
+  // Every key matched by the updated original table must be routed in the
+  // same way by the minimised table.
+  original[2] = inserted_entries[0];
+  for (uint32_t key = 0; key < 16; key++)
+  {
+    keymask_t km = {key, 0xffffffff};
+    int expected = -1, actual = -1;
+    for (unsigned int i = 0; i < 8 && expected < 0; i++)
+    {
+      if (keymask_intersect(original[i].keymask, km))
+      {
+        expected = original[i].route;
+      }
+    }
+    for (unsigned int i = 0; i < table.size && actual < 0; i++)
+    {
+      if (keymask_intersect(table.entries[i].keymask, km))
+      {
+        actual = table.entries[i].route;
+      }
+    }
+
+    if (expected >= 0)
+    {
+      ck_assert_int_eq(actual, expected);
+    }
+  }
+
+  // Tidy up
+  FREE(table.entries);
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
+// Get the next number from a xorshift generator
+static uint32_t reminimise_random(uint64_t *x)
+{
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x >> 32;
+}
+
+
+// Order entries by generality, key and then mask
+static int reminimise_compare(const void *a, const void *b)
+{
+  keymask_t x = ((const entry_t *) a)->keymask;
+  keymask_t y = ((const entry_t *) b)->keymask;
+  unsigned int gx = keymask_count_xs(x), gy = keymask_count_xs(y);
+  if (gx != gy)
+  {
+    return (gx > gy) - (gx < gy);
+  }
+  if (x.key != y.key)
+  {
+    return (x.key > y.key) - (x.key < y.key);
+  }
+  return (x.mask > y.mask) - (x.mask < y.mask);
+}
+
+
+// Sort and minimise a MALLOCed copy of a table, recording the aliases of
+// merged entries
+static table_t reminimise_fresh(table_t *table, aliases_t *aliases)
+{
+  table_t copy = {table->size, MALLOC(sizeof(entry_t) * (table->size + 1))};
+  memcpy(copy.entries, table->entries, sizeof(entry_t) * table->size);
+  qsort(copy.entries, copy.size, sizeof(entry_t), reminimise_compare);
+  oc_minimise(&copy, 0, aliases);
+  return copy;
+}
+
+
+START_TEST(test_ordered_covering_reminimise_generated)
+{
+  // Generated tables have entries deleted and re-inserted with new routes.
+  // Every re-minimised table must be equivalent to the updated table. It
+  // must also be no larger than the updated table minimised from scratch
+  // (in the same order as here) unless it is no larger than the table before
+  // the update plus the inserted entries: only then does `oc_reminimise` not
+  // also start again.
+  for (uint32_t seed = 1; seed <= 16; seed++)
+  {
+    uint64_t x = 88172645463325252ull * seed;
+
+    // The original table is kept up to date alongside the minimised table,
+    // it never grows as only deleted entries are inserted.
+    table_t original;
+    ck_assert(generator_table(&original, 300, seed));
+    aliases_t aliases = aliases_init();
+    table_t table = reminimise_fresh(&original, &aliases);
+
+    // Entries which have been deleted, and which may be inserted again
+    entry_t removed[4 * 8];
+    unsigned int n_removed = 0;
+
+    for (unsigned int round = 0; round < 4; round++)
+    {
+      // Delete some entries from the original table
+      entry_t deleted_entries[8], inserted_entries[8];
+      table_t deleted = {1 + reminimise_random(&x) % 8, deleted_entries};
+      for (unsigned int i = 0; i < deleted.size; i++)
+      {
+        unsigned int j = reminimise_random(&x) % original.size;
+        deleted_entries[i] = removed[n_removed++] = original.entries[j];
+        original.entries[j] = original.entries[--original.size];
+      }
+
+      // Insert some of the deleted entries again, with the route of another
+      // entry (as if their routes had been changed).
+      table_t inserted = {0, inserted_entries};
+      unsigned int n_inserts = 1 + reminimise_random(&x) % 8;
+      while (inserted.size < n_inserts && n_removed > 0)
+      {
+        unsigned int j = reminimise_random(&x) % n_removed;
+        entry_t e = removed[j];
+        removed[j] = removed[--n_removed];
+        e.route = original.entries[reminimise_random(&x) %
+                                   original.size].route;
+
+        inserted_entries[inserted.size++] = e;
+        original.entries[original.size++] = e;
+      }
+
+      unsigned int previous_size = table.size;
+      ck_assert(oc_reminimise(&table, 0, &aliases, &inserted, &deleted));
+      ck_assert(equivalence_check(&original, &table).equivalent);
+
+      aliases_t fresh_aliases = aliases_init();
+      table_t fresh = reminimise_fresh(&original, &fresh_aliases);
+      ck_assert(table.size <= fresh.size ||
+                table.size <= previous_size + inserted.size);
+      aliases_clear(&fresh_aliases);
+      FREE(fresh.entries);
+    }
+
+    // Tidy up
+    aliases_clear(&aliases);
+    FREE(table.entries);
+    FREE(original.entries);
+  }
+}
+END_TEST
+
+
+// Store the records of a trace
+typedef struct
+{
+  unsigned int n_records;
+  oc_trace_record_t records[8];
+} trace_test_t;
+
+
+static void trace_test(oc_trace_record_t *record, void *arg)
+{
+  trace_test_t *t = arg;
+  ck_assert(t->n_records < 8);
+  t->records[t->n_records++] = *record;
+}
+
+
+START_TEST(test_ordered_covering_traced)
+{
+  // The table from `test_ordered_covering_full`
+  entry_t entries[] = {
+    {{0b0000, 0xf}, 0b000110, 0b100000},
+    {{0b0001, 0xf}, 0b000001, 0b000010},
+    {{0b0101, 0xf}, 0b010000, 0b000010},
+    {{0b1000, 0xf}, 0b000110, 0b100000},
+    {{0b1001, 0xf}, 0b000001, 0b000010},
+    {{0b1110, 0xf}, 0b010000, 0b100000},
+    {{0b1100, 0xf}, 0b000110, 1 << (15 + 6)},
+    {{0b0100, 0xf}, 0b110000, 0b000100}
+  };
+  table_t table = {8, entries};
+  aliases_t aliases = aliases_init();
+
+  trace_test_t t = {0};
+  oc_minimise_traced(&table, 0, &aliases, trace_test, &t);
+  ck_assert_int_eq(table.size, 4);
+
+  // There should be a record for each of the three merges
+  ck_assert_int_eq(t.n_records, 3);
+  unsigned int size = 8;
+  for (unsigned int i = 0; i < t.n_records; i++)
+  {
+    oc_trace_record_t *r = &t.records[i];
+    ck_assert_int_eq(r->iteration, i);
+    ck_assert_int_eq(r->table_size, size - r->goodness);
+    ck_assert(r->goodness > 0);
+    ck_assert(r->generality > 0 && r->generality <= 32);
+    ck_assert_int_eq(r->n_aliases, i + 1);
+    ck_assert_int_eq(r->elapsed_ns, 0);
+    size = r->table_size;
+  }
+
+  // The final merge formed the entry NE S -> X1XX -> SW (the top 28 bits of
+  // every entry are also X)
+  ck_assert_int_eq(t.records[2].route, 0b010000);
+  ck_assert_int_eq(t.records[2].generality, 28 + 3);
+
+  // Tidy up
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
 Suite* ordered_covering_suite(void)
 {
   Suite *s;
@@ -795,6 +1037,9 @@ Suite* ordered_covering_suite(void)
 
   tcase_add_test(tests, test_ordered_covering_full);
   tcase_add_test(tests, test_ordered_covering_terminates_early);
+  tcase_add_test(tests, test_ordered_covering_reminimise);
+  tcase_add_test(tests, test_ordered_covering_reminimise_generated);
+  tcase_add_test(tests, test_ordered_covering_traced);
 
   return s;
 }
@@ -0,0 +1,169 @@
+// Profile the allocations made by the code in this file
+#define PROFILED
+
+#include "tests.h"
+#include "routing_table.h"
+#include "bitset.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "mtrie.h"
+#include "profile.h"
+#include <string.h>
+
+
+// Fill a table with entries with distinct keys and a few different routes
+static void make_table(entry_t *entries, unsigned int size)
+{
+  uint32_t seed = 1;
+  for (unsigned int i = 0; i < size; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    entries[i].keymask.key = i * 7;
+    entries[i].keymask.mask = 0xffffffff;
+    entries[i].route = 1 << ((seed >> 16) % 3);
+    entries[i].source = 0x0;
+  }
+}
+
+
+START_TEST(test_profile_counts)
+{
+  profile_init();
+
+  bitset_t a, b;
+  bitset_init(&a, 100);  // 4 words
+  bitset_init(&b, 32);   // 1 word
+
+  const profile_t *p = profile_get();
+  ck_assert_int_eq(p->n_allocations, 2);
+  ck_assert_int_eq(p->live_bytes, 5 * sizeof(uint32_t));
+  ck_assert_int_eq(p->peak_bytes, 5 * sizeof(uint32_t));
+
+  bitset_delete(&a);
+  ck_assert_int_eq(p->n_frees, 1);
+  ck_assert_int_eq(p->live_bytes, 1 * sizeof(uint32_t));
+  ck_assert_int_eq(p->peak_bytes, 5 * sizeof(uint32_t));
+
+  // Allocations are recorded against the file which made them
+  const profile_site_t *s = profile_get_site("bitset.h");
+  ck_assert(s != NULL);
+  ck_assert_int_eq(s->n_allocations, 2);
+  ck_assert_int_eq(s->bytes, 5 * sizeof(uint32_t));
+  ck_assert(profile_get_site("mtrie.h") == NULL);
+
+  // Resetting the peak allows the peak of the next operation to be found
+  profile_reset_peak();
+  ck_assert_int_eq(p->peak_bytes, 1 * sizeof(uint32_t));
+  ck_assert_int_eq(s->peak_bytes, 1 * sizeof(uint32_t));
+
+  bitset_delete(&b);
+  ck_assert_int_eq(p->live_bytes, 0);
+}
+END_TEST
+
+
+START_TEST(test_oc_memory_budget)
+{
+  entry_t entries[200];
+  make_table(entries, 200);
+  table_t table = {200, entries};
+
+  profile_init();
+  aliases_t aliases = aliases_init();
+  oc_minimise(&table, 0, &aliases);
+  aliases_clear(&aliases);
+
+  // Minimising the table should fit comfortably within 4 KiB of heap, most
+  // of which is used by the aliases.
+  const profile_t *p = profile_get();
+  ck_assert(p->peak_bytes <= 4096);
+  ck_assert(profile_get_site("aliases.h")->peak_bytes <= 4096);
+  ck_assert(profile_get_site("bitset.h")->peak_bytes <= 128);
+
+  // Everything which was allocated has been freed
+  ck_assert_int_eq(p->live_bytes, 0);
+  ck_assert_int_eq(p->n_frees, p->n_allocations);
+}
+END_TEST
+
+
+START_TEST(test_mtrie_memory_budget)
+{
+  entry_t entries[200];
+  make_table(entries, 200);
+  table_t table = {200, entries};
+
+  profile_init();
+  mtrie_minimise(&table);
+
+  // The trie should fit within 32 KiB of heap (half of DTCM)
+  const profile_t *p = profile_get();
+  ck_assert(p->peak_bytes <= 32 * 1024);
+  ck_assert(profile_get_site("mtrie.h")->peak_bytes <= 32 * 1024);
+
+  ck_assert_int_eq(p->live_bytes, 0);
+  ck_assert_int_eq(p->n_frees, p->n_allocations);
+}
+END_TEST
+
+
+START_TEST(test_mtrie_shared_memory)
+{
+  // The same pattern of entries under many prefixes, no two of which differ
+  // in a single bit (so the patterns are never merged)
+  static entry_t entries[32 * 50];
+  unsigned int size = 0;
+  for (uint32_t prefix = 0; prefix < 64; prefix++)
+  {
+    if (__builtin_parity(prefix))
+    {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < 50; i++)
+    {
+      entries[size].keymask.key = (prefix << 16) | (i * 37);
+      entries[size].keymask.mask = 0xffffffff;
+      entries[size].route = 0b1;
+      entries[size].source = 0x0;
+      size++;
+    }
+  }
+  table_t table = {size, entries};
+
+  profile_init();
+  mtrie_minimise(&table);
+  size_t peak_bytes = profile_get()->peak_bytes;
+
+  // Sharing the subtries of each prefix as the trie is built should need
+  // only a fraction of the memory
+  table.size = size;
+  profile_init();
+  mtrie_minimise_shared(&table);
+  const profile_t *p = profile_get();
+  ck_assert_int_eq(table.size, size);
+  ck_assert(p->peak_bytes * 4 < peak_bytes);
+
+  ck_assert_int_eq(p->live_bytes, 0);
+  ck_assert_int_eq(p->n_frees, p->n_allocations);
+}
+END_TEST
+
+
+Suite* profile_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Profiled Allocator");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_profile_counts);
+  tcase_add_test(tests, test_oc_memory_budget);
+  tcase_add_test(tests, test_mtrie_memory_budget);
+  tcase_add_test(tests, test_mtrie_shared_memory);
+
+  return s;
+}
@@ -100,6 +100,68 @@ START_TEST(test_removal)
 END_TEST
 
 
+START_TEST(test_removal_matches_pairwise)
+{
+  // Compare removing default routes from a random table, with (_i = 1) and
+  // without (_i = 0) the index, against checking each candidate entry against
+  // every entry beneath it.
+  srand(4321);
+
+  const unsigned int n = 500;
+  entry_t entries[n];
+  for (unsigned int i = 0; i < n; i++)
+  {
+    // Keys over a small number of bits so that entries often intersect
+    entries[i].keymask.mask = 0xff0 | (rand() & 0xf);
+    entries[i].keymask.key = rand() & entries[i].keymask.mask;
+
+    // Most entries go straight through the router
+    unsigned int link = rand() % 6;
+    entries[i].route = 1 << link;
+    entries[i].source = 1 << ((link + (rand() % 4 ? 3 : 1)) % 6);
+  }
+
+  // Determine which entries should be removed
+  bool removed[n];
+  unsigned int n_expected = 0;
+  for (unsigned int i = n - 1; i < n; i--)
+  {
+    entry_t e = entries[i];
+    removed[i] = ((e.route >> 3) == (e.source & 0x7) &&
+                  (e.source >> 3) == (e.route & 0x7));
+    for (unsigned int j = i + 1; removed[i] && j < n; j++)
+    {
+      removed[i] = removed[j] || !keymask_intersect(e.keymask,
+                                                    entries[j].keymask);
+    }
+    n_expected += removed[i] ? 0 : 1;
+  }
+
+  entry_t expected[n];
+  for (unsigned int i = 0, j = 0; i < n; i++)
+  {
+    if (!removed[i])
+    {
+      expected[j++] = entries[i];
+    }
+  }
+
+  // Minimise and compare
+  table_t table = {n, entries};
+  _remove_default_routes_minimise(&table, _i);
+
+  ck_assert_int_eq(table.size, n_expected);
+  for (unsigned int i = 0; i < table.size; i++)
+  {
+    ck_assert_int_eq(table.entries[i].keymask.key, expected[i].keymask.key);
+    ck_assert_int_eq(table.entries[i].keymask.mask, expected[i].keymask.mask);
+    ck_assert_int_eq(table.entries[i].route, expected[i].route);
+    ck_assert_int_eq(table.entries[i].source, expected[i].source);
+  }
+}
+END_TEST
+
+
 Suite* remove_default_suite(void)
 {
   Suite *s;
@@ -112,6 +174,7 @@ Suite* remove_default_suite(void)
   // Add the tests
   tcase_add_loop_test(tests, test_removal,
                       0, sizeof(test_tables) / sizeof(table_t));
+  tcase_add_loop_test(tests, test_removal_matches_pairwise, 0, 2);
 
   return s;
 }
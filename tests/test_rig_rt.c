@@ -0,0 +1,124 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "constant_columns.h"
+#include "rig_rt.h"
+#include <string.h>
+
+
+// Fill a table with entries with distinct keys and a few different routes
+static void make_table(entry_t *entries, unsigned int size, uint32_t seed)
+{
+  for (unsigned int i = 0; i < size; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    entries[i].keymask.key = 0x00ab0000 | (i * 7);
+    entries[i].keymask.mask = 0xffffffff;
+    entries[i].route = 1 << ((seed >> 16) % 3);
+    entries[i].source = 0x0;
+  }
+}
+
+
+START_TEST(test_rig_rt_oc_minimise)
+{
+  entry_t entries_a[200], entries_b[200];
+  make_table(entries_a, 200, 1);
+  memcpy(entries_b, entries_a, sizeof(entries_a));
+  table_t table_a = {200, entries_a}, table_b = {200, entries_b};
+
+  // Minimise with the headers
+  table_sort_by_generality(&table_a);
+  aliases_t aliases = aliases_init();
+  columns_oc_minimise(&table_a, 0, &aliases);
+  aliases_clear(&aliases);
+
+  // Minimise with the library, which should give the same table
+  rig_rt_context_t *ctx = rig_rt_context_new();
+  ck_assert(rig_rt_oc_minimise(ctx, &table_b, 0));
+
+  ck_assert_int_eq(table_b.size, table_a.size);
+  ck_assert(memcmp(entries_a, entries_b, sizeof(entry_t) * table_a.size) == 0);
+
+  rig_rt_context_delete(ctx);
+}
+END_TEST
+
+
+START_TEST(test_rig_rt_mtrie_minimise)
+{
+  entry_t entries_a[200], entries_b[200], entries_c[200];
+  make_table(entries_a, 200, 2);
+  memcpy(entries_b, entries_a, sizeof(entries_a));
+  memcpy(entries_c, entries_a, sizeof(entries_a));
+  table_t table_a = {200, entries_a}, table_b = {200, entries_b};
+  table_t table_c = {200, entries_c};
+
+  columns_mtrie_minimise(&table_a);
+
+  rig_rt_context_t *ctx = rig_rt_context_new();
+  rig_rt_mtrie_minimise(ctx, &table_b);
+
+  ck_assert_int_eq(table_b.size, table_a.size);
+  ck_assert(memcmp(entries_a, entries_b, sizeof(entry_t) * table_a.size) == 0);
+
+  // Sharing subtries gives the same table
+  rig_rt_mtrie_minimise_shared(ctx, &table_c);
+  ck_assert_int_eq(table_c.size, table_a.size);
+  ck_assert(memcmp(entries_a, entries_c, sizeof(entry_t) * table_a.size) == 0);
+
+  rig_rt_context_delete(ctx);
+}
+END_TEST
+
+
+START_TEST(test_rig_rt_steady_state)
+{
+  rig_rt_context_t *ctx = rig_rt_context_new();
+  ck_assert_int_eq(rig_rt_context_n_allocations(ctx), 0);
+
+  // Minimising the first table requires memory from the system
+  entry_t entries[200];
+  make_table(entries, 200, 3);
+  table_t table = {200, entries};
+  rig_rt_oc_minimise(ctx, &table, 0);
+
+  uint64_t n_allocations = rig_rt_context_n_allocations(ctx);
+  ck_assert(n_allocations > 0);
+
+  // Minimising further tables of the same size should reuse that memory
+  for (uint32_t seed = 3; seed < 10; seed++)
+  {
+    make_table(entries, 200, seed);
+    table.size = 200;
+    rig_rt_oc_minimise(ctx, &table, 0);
+    rig_rt_mtrie_minimise(ctx, &table);
+  }
+
+  make_table(entries, 200, 3);
+  table.size = 200;
+  uint64_t n_steady = rig_rt_context_n_allocations(ctx);
+  rig_rt_oc_minimise(ctx, &table, 0);
+  ck_assert_int_eq(rig_rt_context_n_allocations(ctx), n_steady);
+
+  rig_rt_context_delete(ctx);
+}
+END_TEST
+
+
+Suite* rig_rt_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("librig_rt");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_rig_rt_oc_minimise);
+  tcase_add_test(tests, test_rig_rt_mtrie_minimise);
+  tcase_add_test(tests, test_rig_rt_steady_state);
+
+  return s;
+}
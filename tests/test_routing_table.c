@@ -100,6 +100,52 @@ START_TEST(test_keymask_merge)
 END_TEST
 
 
+START_TEST(test_table_sort_by_generality)
+{
+  // Entries are identified by their routes
+  entry_t entries[] = {
+    {{0x0, 0x0}, 0},  // Generality 32
+    {{0x0, 0xfffffffe}, 1},  // Generality 1
+    {{0x1, 0xffffffff}, 2},  // Generality 0
+    {{0x0, 0xfffffffd}, 3},  // Generality 1
+    {{0x0, 0xffffffff}, 4},  // Generality 0
+    {{0x0, 0xfffffffc}, 5},  // Generality 2
+  };
+  table_t table = {6, entries};
+
+  ck_assert(table_sort_by_generality(&table));
+
+  // Entries should be sorted with equal generality entries left in the same
+  // order.
+  uint32_t expected[] = {2, 4, 1, 3, 5, 0};
+  for (unsigned int i = 0; i < table.size; i++)
+  {
+    ck_assert_int_eq(table.entries[i].route, expected[i]);
+  }
+
+  // Check the histogram of generalities
+  unsigned int histogram[N_GENERALITIES];
+  table_get_generality_histogram(table.entries, table.size, histogram);
+  for (unsigned int g = 0; g < N_GENERALITIES; g++)
+  {
+    switch (g)
+    {
+      case 0:
+      case 1:
+        ck_assert_int_eq(histogram[g], 2);
+        break;
+      case 2:
+      case 32:
+        ck_assert_int_eq(histogram[g], 1);
+        break;
+      default:
+        ck_assert_int_eq(histogram[g], 0);
+    }
+  }
+}
+END_TEST
+
+
 Suite* routing_table_suite(void)
 {
   Suite *s;
@@ -114,5 +160,9 @@ Suite* routing_table_suite(void)
   tcase_add_test(tests, test_keymask_intersect);
   tcase_add_test(tests, test_keymask_merge);
 
+  tests = tcase_create("Table");
+  suite_add_tcase(s, tests);
+  tcase_add_test(tests, test_table_sort_by_generality);
+
   return s;
 }
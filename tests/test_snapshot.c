@@ -0,0 +1,206 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "aliases.h"
+#include "ordered_covering.h"
+#include "snapshot.h"
+#include <string.h>
+
+
+// Table used to test Ordered Covering (see `test_ordered_covering_full`)
+static entry_t oc_entries[] = {
+  {{0b0000, 0xf}, 0b000110, 0b100000},
+  {{0b0001, 0xf}, 0b000001, 0b000010},
+  {{0b0101, 0xf}, 0b010000, 0b000010},
+  {{0b1000, 0xf}, 0b000110, 0b100000},
+  {{0b1001, 0xf}, 0b000001, 0b000010},
+  {{0b1110, 0xf}, 0b010000, 0b100000},
+  {{0b1100, 0xf}, 0b000110, 1 << (15 + 6)},
+  {{0b0100, 0xf}, 0b110000, 0b000100}
+};
+
+
+START_TEST(test_snapshot_round_trip)
+{
+  // Build a table and some aliases
+  entry_t entries[] = {
+    {{0x0, 0xc}, 0b01, 0x1},
+    {{0x4, 0xf}, 0b10, 0x2},
+  };
+  table_t table = {2, entries};
+
+  aliases_t aliases = aliases_init();
+  alias_list_t *l = alias_list_new(2);
+  alias_list_append(l, (keymask_t) {0x0, 0xf}, 0x3);
+  alias_list_append(l, (keymask_t) {0x3, 0xf}, 0x4);
+  alias_list_t *m = alias_list_new(1);
+  alias_list_append(m, (keymask_t) {0x1, 0xf}, 0x5);
+  alias_list_join(l, m);
+  aliases_insert(&aliases, entries[0].keymask, l);
+
+  // Insert and then remove another entry, which should not be stored
+  aliases_insert(&aliases, (keymask_t) {0x8, 0x8}, alias_list_new(1));
+  alias_list_delete(aliases_find(&aliases, (keymask_t) {0x8, 0x8}));
+  aliases_remove(&aliases, (keymask_t) {0x8, 0x8});
+
+  unsigned int n_words = snapshot_size(&table, &aliases);
+  ck_assert_int_eq(n_words, 3 + 2*4 + 3 + 3*3);
+
+  uint32_t data[n_words];
+  snapshot_write(data, &table, &aliases);
+
+  // Restore the snapshot into a new table
+  entry_t restored_entries[4];
+  table_t restored = {0, restored_entries};
+  aliases_t restored_aliases = aliases_init();
+  ck_assert(snapshot_read(data, n_words, &restored, 4, &restored_aliases));
+
+  ck_assert_int_eq(restored.size, 2);
+  ck_assert(memcmp(entries, restored_entries, sizeof(entries)) == 0);
+
+  ck_assert(!aliases_contains(&restored_aliases, (keymask_t) {0x8, 0x8}));
+  alias_list_t *r = aliases_find(&restored_aliases, entries[0].keymask);
+  ck_assert(r != NULL);
+  ck_assert_int_eq(r->n_elements, 3);
+  ck_assert(r->next == NULL);
+  ck_assert_int_eq(alias_list_get(r, 0).keymask.key, 0x0);
+  ck_assert_int_eq(alias_list_get(r, 0).source, 0x3);
+  ck_assert_int_eq(alias_list_get(r, 1).keymask.key, 0x3);
+  ck_assert_int_eq(alias_list_get(r, 1).source, 0x4);
+  ck_assert_int_eq(alias_list_get(r, 2).keymask.key, 0x1);
+  ck_assert_int_eq(alias_list_get(r, 2).source, 0x5);
+
+  // Tidy up
+  aliases_clear(&aliases);
+  aliases_clear(&restored_aliases);
+}
+END_TEST
+
+
+START_TEST(test_snapshot_read_rejects_malformed)
+{
+  entry_t entries[] = {
+    {{0x0, 0xf}, 0b01, 0x1},
+    {{0x1, 0xf}, 0b01, 0x1},
+  };
+  table_t table = {2, entries};
+  aliases_t aliases = aliases_init();
+  alias_list_t *l = alias_list_new(1);
+  alias_list_append(l, (keymask_t) {0x0, 0xf}, 0x1);
+  aliases_insert(&aliases, (keymask_t) {0x2, 0xf}, l);
+
+  unsigned int n_words = snapshot_size(&table, &aliases);
+  uint32_t data[n_words];
+  snapshot_write(data, &table, &aliases);
+
+  entry_t restored_entries[2] = {{{0xa, 0xa}, 0xa, 0xa}};
+  table_t restored = {1, restored_entries};
+  aliases_t restored_aliases = aliases_init();
+
+  // Truncated snapshots, snapshots with extra data and snapshots of tables
+  // which are too large should be rejected without changing anything.
+  ck_assert(!snapshot_read(data, n_words - 1, &restored, 2,
+                           &restored_aliases));
+  ck_assert(!snapshot_read(data, 2, &restored, 2, &restored_aliases));
+  ck_assert(!snapshot_read(data, n_words, &restored, 1, &restored_aliases));
+
+  uint32_t longer[n_words + 1];
+  memcpy(longer, data, sizeof(data));
+  longer[n_words] = 0;
+  ck_assert(!snapshot_read(longer, n_words + 1, &restored, 2,
+                           &restored_aliases));
+
+  data[0] = 0;
+  ck_assert(!snapshot_read(data, n_words, &restored, 2, &restored_aliases));
+
+  ck_assert_int_eq(restored.size, 1);
+  ck_assert_int_eq(restored_entries[0].keymask.key, 0xa);
+  ck_assert(restored_aliases.root == NULL);
+
+  aliases_clear(&aliases);
+}
+END_TEST
+
+
+// Take a snapshot after the first merge
+typedef struct
+{
+  unsigned int n_merges;
+  unsigned int n_words;
+  uint32_t data[256];
+} checkpoint_test_t;
+
+
+static void checkpoint_first(table_t *table, aliases_t *aliases, void *arg)
+{
+  checkpoint_test_t *c = arg;
+  if (c->n_merges++ == 0)
+  {
+    c->n_words = snapshot_size(table, aliases);
+    ck_assert(c->n_words <= 256);
+    snapshot_write(c->data, table, aliases);
+  }
+}
+
+
+START_TEST(test_oc_minimise_resume)
+{
+  // Minimise the table without interruption
+  entry_t entries_a[8];
+  memcpy(entries_a, oc_entries, sizeof(oc_entries));
+  table_t table_a = {8, entries_a};
+  aliases_t aliases_a = aliases_init();
+  oc_minimise(&table_a, 0, &aliases_a);
+
+  // Minimise the table, taking a snapshot after the first merge
+  entry_t entries_b[8];
+  memcpy(entries_b, oc_entries, sizeof(oc_entries));
+  table_t table_b = {8, entries_b};
+  aliases_t aliases_b = aliases_init();
+  checkpoint_test_t c = {0, 0, {0}};
+  oc_minimise_checkpointed(&table_b, 0, &aliases_b, checkpoint_first, &c);
+  ck_assert_int_eq(c.n_merges, 3);
+  ck_assert_int_eq(table_b.size, table_a.size);
+
+  // Resuming from the snapshot should give the same table and aliases
+  entry_t entries_c[8];
+  table_t table_c = {0, entries_c};
+  aliases_t aliases_c = aliases_init();
+  ck_assert(snapshot_read(c.data, c.n_words, &table_c, 8, &aliases_c));
+  ck_assert(table_c.size < 8 && table_c.size > table_a.size);
+  oc_minimise(&table_c, 0, &aliases_c);
+
+  ck_assert_int_eq(table_c.size, table_a.size);
+  ck_assert(memcmp(entries_a, entries_c,
+                   sizeof(entry_t) * table_a.size) == 0);
+
+  unsigned int n_words = snapshot_size(&table_a, &aliases_a);
+  ck_assert_int_eq(snapshot_size(&table_c, &aliases_c), n_words);
+  uint32_t data_a[n_words], data_c[n_words];
+  snapshot_write(data_a, &table_a, &aliases_a);
+  snapshot_write(data_c, &table_c, &aliases_c);
+  ck_assert(memcmp(data_a, data_c, sizeof(data_a)) == 0);
+
+  // Tidy up
+  aliases_clear(&aliases_a);
+  aliases_clear(&aliases_b);
+  aliases_clear(&aliases_c);
+}
+END_TEST
+
+
+Suite* snapshot_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Snapshot");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_snapshot_round_trip);
+  tcase_add_test(tests, test_snapshot_read_rejects_malformed);
+  tcase_add_test(tests, test_oc_minimise_resume);
+
+  return s;
+}
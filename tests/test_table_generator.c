@@ -0,0 +1,213 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "remove_default_routes.h"
+#include "table_generator.h"
+
+
+// Find the entry of a table with the given key, or NULL
+static entry_t* find_key(table_t *table, uint32_t key)
+{
+  for (unsigned int i = 0; i < table->size; i++)
+  {
+    if (table->entries[i].keymask.key == key)
+    {
+      return &table->entries[i];
+    }
+  }
+  return NULL;
+}
+
+
+START_TEST(test_generator_is_seeded)
+{
+  generator_params_t p = generator_params_init(4, 3, 7);
+  table_t *a = generator_run(&p);
+  table_t *b = generator_run(&p);
+  p.seed = 8;
+  table_t *c = generator_run(&p);
+
+  bool differs = false;
+  for (unsigned int i = 0; i < 4*3; i++)
+  {
+    // The same seed generates the same tables
+    ck_assert_int_eq(a[i].size, b[i].size);
+    ck_assert(memcmp(a[i].entries, b[i].entries,
+                     sizeof(entry_t) * a[i].size) == 0);
+
+    // A different seed does not
+    differs |= a[i].size != c[i].size ||
+               memcmp(a[i].entries, c[i].entries,
+                      sizeof(entry_t) * a[i].size) != 0;
+  }
+  ck_assert(differs);
+
+  generator_tables_delete(a, 4*3);
+  generator_tables_delete(b, 4*3);
+  generator_tables_delete(c, 4*3);
+}
+END_TEST
+
+
+START_TEST(test_generator_trees)
+{
+  const unsigned int w = 6, h = 5;
+  generator_params_t p = generator_params_init(w, h, 1);
+  table_t *tables = generator_run(&p);
+  ck_assert(tables != NULL);
+
+  for (unsigned int chip = 0; chip < w*h; chip++)
+  {
+    table_t *t = &tables[chip];
+    ck_assert(t->size > 0);
+
+    for (unsigned int i = 0; i < t->size; i++)
+    {
+      entry_t *e = &t->entries[i];
+
+      // Every entry sends packets somewhere and receives them from a single
+      // link or core.
+      ck_assert(e->route != 0);
+      ck_assert_int_eq(__builtin_popcount(e->source), 1);
+      ck_assert_int_eq(e->keymask.mask, 0xffffff00);
+
+      // No two entries match the same keys
+      for (unsigned int j = i + 1; j < t->size; j++)
+      {
+        ck_assert(!keymask_intersect(e->keymask, t->entries[j].keymask));
+      }
+
+      // The chip on each link the entry routes to receives the packets on
+      // the opposite link.
+      for (unsigned int link = 0; link < 6; link++)
+      {
+        if (e->route & (1 << link))
+        {
+          unsigned int x = (chip % w + w + _generator_link_dx[link]) % w;
+          unsigned int y = (chip / w + h + _generator_link_dy[link]) % h;
+          entry_t *n = find_key(&tables[y*w + x], e->keymask.key);
+          ck_assert(n != NULL);
+          ck_assert_int_eq(n->source, 1 << ((link + 3) % 6));
+        }
+      }
+    }
+  }
+
+  generator_tables_delete(tables, w*h);
+}
+END_TEST
+
+
+START_TEST(test_generator_default_routes)
+{
+  const unsigned int w = 8, h = 8;
+  generator_params_t p = generator_params_init(w, h, 3);
+  table_t *tables = generator_run(&p);
+
+  // Every entry which continues straight on through a chip can be removed,
+  // since no entries overlap.
+  unsigned int n_straight = 0, n_removed = 0;
+  for (unsigned int chip = 0; chip < w*h; chip++)
+  {
+    table_t *t = &tables[chip];
+    unsigned int size = t->size;
+    for (unsigned int i = 0; i < size; i++)
+    {
+      uint32_t route = t->entries[i].route;
+      uint32_t source = t->entries[i].source;
+      for (unsigned int link = 0; link < 6; link++)
+      {
+        n_straight += route == (1u << link) &&
+                      source == (1u << ((link + 3) % 6));
+      }
+    }
+
+    remove_default_routes_minimise(t);
+    n_removed += size - t->size;
+  }
+  ck_assert(n_straight > 0);
+  ck_assert_int_eq(n_removed, n_straight);
+
+  generator_tables_delete(tables, w*h);
+}
+END_TEST
+
+
+START_TEST(test_generator_single_chip)
+{
+  generator_params_t p = generator_params_init(1, 1, 0);
+  p.cores_per_chip = GENERATOR_MAX_CORES;
+  table_t *tables = generator_run(&p);
+
+  // Every core sends packets only to other cores
+  ck_assert_int_eq(tables[0].size, GENERATOR_MAX_CORES);
+  for (unsigned int i = 0; i < tables[0].size; i++)
+  {
+    ck_assert_int_eq(tables[0].entries[i].route & 0x3f, 0);
+    ck_assert_int_eq(tables[0].entries[i].source & 0x3f, 0);
+  }
+
+  generator_tables_delete(tables, 1);
+}
+END_TEST
+
+
+START_TEST(test_generator_table)
+{
+  table_t table;
+  ck_assert(generator_table(&table, 5000, 1));
+  ck_assert_int_eq(table.size, 5000);
+
+  // Entries from different chips are kept apart by their keys
+  for (unsigned int i = 0; i < table.size; i++)
+  {
+    for (unsigned int j = i + 1; j < table.size; j++)
+    {
+      ck_assert(!keymask_intersect(table.entries[i].keymask,
+                                   table.entries[j].keymask));
+    }
+  }
+  FREE(table.entries);
+
+  // There are only so many chips which can be told apart
+  ck_assert(!generator_table(&table, 1 << 22, 1));
+  FREE(table.entries);
+}
+END_TEST
+
+
+START_TEST(test_generator_invalid)
+{
+  generator_params_t p = generator_params_init(0, 4, 0);
+  ck_assert(generator_run(&p) == NULL);
+
+  p = generator_params_init(4, 4, 0);
+  p.cores_per_chip = GENERATOR_MAX_CORES + 1;
+  ck_assert(generator_run(&p) == NULL);
+
+  // Too many slices in a population to be given keys
+  p = generator_params_init(4, 4, 0);
+  p.max_slices = 1 << 24;
+  ck_assert(generator_run(&p) == NULL);
+}
+END_TEST
+
+
+Suite* table_generator_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Table Generator");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_generator_is_seeded);
+  tcase_add_test(tests, test_generator_trees);
+  tcase_add_test(tests, test_generator_default_routes);
+  tcase_add_test(tests, test_generator_single_chip);
+  tcase_add_test(tests, test_generator_table);
+  tcase_add_test(tests, test_generator_invalid);
+
+  return s;
+}
@@ -0,0 +1,143 @@
+#include "tests.h"
+#include "routing_table.h"
+#include "ternary_index.h"
+
+
+START_TEST(test_tindex_intersects)
+{
+  tindex_t index = tindex_init();
+
+  // An empty index intersects with nothing
+  keymask_t all = {0x0, 0x0};
+  ck_assert(!tindex_intersects(&index, all));
+
+  // Add some keymasks
+  keymask_t a = {0b0000, 0xf};  // 0000
+  keymask_t b = {0b1000, 0xc};  // 10XX
+  keymask_t c = {0b0010, 0xe};  // 001X
+  tindex_insert(&index, a);
+  tindex_insert(&index, b);
+  tindex_insert(&index, c);
+
+  // Check for intersections
+  keymask_t q1 = {0b0000, 0xf};  // 0000 (== a)
+  keymask_t q2 = {0b0001, 0xf};  // 0001
+  keymask_t q3 = {0b1011, 0xf};  // 1011 (in b)
+  keymask_t q4 = {0b0011, 0x3};  // XX11 (in b and c)
+  keymask_t q5 = {0b0100, 0xc};  // 01XX
+  ck_assert(tindex_intersects(&index, q1));
+  ck_assert(!tindex_intersects(&index, q2));
+  ck_assert(tindex_intersects(&index, q3));
+  ck_assert(tindex_intersects(&index, q4));
+  ck_assert(!tindex_intersects(&index, q5));
+  ck_assert(tindex_intersects(&index, all));
+
+  // Remove keymasks and check again
+  ck_assert(tindex_remove(&index, b));
+  ck_assert(!tindex_intersects(&index, q3));
+  ck_assert(tindex_intersects(&index, q4));  // Still in c
+
+  ck_assert(tindex_remove(&index, c));
+  ck_assert(!tindex_intersects(&index, q4));
+
+  // Removing something which isn't present fails
+  ck_assert(!tindex_remove(&index, c));
+  ck_assert(!tindex_remove(&index, q2));
+
+  // Re-adding a keymask works
+  tindex_insert(&index, b);
+  ck_assert(tindex_intersects(&index, q3));
+
+  tindex_delete(&index);
+}
+END_TEST
+
+
+START_TEST(test_tindex_duplicates)
+{
+  tindex_t index = tindex_init();
+
+  // Add the same keymask twice, it should remain present until removed twice
+  keymask_t a = {0x1234, 0xffff};
+  tindex_insert(&index, a);
+  tindex_insert(&index, a);
+  ck_assert(tindex_intersects(&index, a));
+
+  ck_assert(tindex_remove(&index, a));
+  ck_assert(tindex_intersects(&index, a));
+  ck_assert(tindex_remove(&index, a));
+  ck_assert(!tindex_intersects(&index, a));
+  ck_assert(!tindex_remove(&index, a));
+
+  tindex_delete(&index);
+}
+END_TEST
+
+
+START_TEST(test_tindex_matches_brute_force)
+{
+  // Generate random keymasks over a small number of bits and compare the
+  // index against testing every keymask in turn.
+  srand(1234);
+
+  keymask_t kms[200];
+  bool present[200];
+  tindex_t index = tindex_init();
+  for (unsigned int i = 0; i < 200; i++)
+  {
+    kms[i].mask = rand() & 0x3ff;
+    kms[i].key = rand() & kms[i].mask;
+    tindex_insert(&index, kms[i]);
+    present[i] = true;
+  }
+
+  for (unsigned int round = 0; round < 4; round++)
+  {
+    // Remove a random selection of keymasks
+    for (unsigned int i = 0; i < 200; i++)
+    {
+      if (present[i] && rand() % 4 == 0)
+      {
+        ck_assert(tindex_remove(&index, kms[i]));
+        present[i] = false;
+      }
+    }
+
+    // Compare queries against the brute force result
+    for (unsigned int q = 0; q < 500; q++)
+    {
+      keymask_t query;
+      query.mask = rand() & 0x3ff;
+      query.key = rand() & query.mask;
+
+      bool expected = false;
+      for (unsigned int i = 0; i < 200; i++)
+      {
+        expected |= present[i] && keymask_intersect(query, kms[i]);
+      }
+
+      ck_assert(tindex_intersects(&index, query) == expected);
+    }
+  }
+
+  tindex_delete(&index);
+}
+END_TEST
+
+
+Suite* ternary_index_suite(void)
+{
+  Suite *s;
+  TCase *tests;
+
+  s = suite_create("Ternary Index");
+  tests = tcase_create("Core");
+  suite_add_tcase(s, tests);
+
+  // Add the tests
+  tcase_add_test(tests, test_tindex_intersects);
+  tcase_add_test(tests, test_tindex_duplicates);
+  tcase_add_test(tests, test_tindex_matches_brute_force);
+
+  return s;
+}
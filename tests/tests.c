@@ -26,6 +26,39 @@ int main(void)
   Suite *s_rdr = remove_default_suite();
   srunner_add_suite(sr, s_rdr);
 
+  Suite *s_columns = constant_columns_suite();
+  srunner_add_suite(sr, s_columns);
+
+  Suite *s_tindex = ternary_index_suite();
+  srunner_add_suite(sr, s_tindex);
+
+  Suite *s_history = merge_history_suite();
+  srunner_add_suite(sr, s_history);
+
+  Suite *s_snapshot = snapshot_suite();
+  srunner_add_suite(sr, s_snapshot);
+
+  Suite *s_rig_rt = rig_rt_suite();
+  srunner_add_suite(sr, s_rig_rt);
+
+  Suite *s_stats = oc_stats_suite();
+  srunner_add_suite(sr, s_stats);
+
+  Suite *s_profile = profile_suite();
+  srunner_add_suite(sr, s_profile);
+
+  Suite *s_generator = table_generator_suite();
+  srunner_add_suite(sr, s_generator);
+
+  Suite *s_equivalence = equivalence_suite();
+  srunner_add_suite(sr, s_equivalence);
+
+  Suite *s_lookup = lookup_suite();
+  srunner_add_suite(sr, s_lookup);
+
+  Suite *s_complexity = complexity_suite();
+  srunner_add_suite(sr, s_complexity);
+
   // Run the tests
   srunner_run_all(sr, CK_NORMAL);
 
@@ -10,6 +10,17 @@ Suite* ordered_covering_suite(void);
 Suite* aliases_suite(void);
 Suite* mtrie_suite(void);
 Suite* remove_default_suite(void);
+Suite* constant_columns_suite(void);
+Suite* ternary_index_suite(void);
+Suite* merge_history_suite(void);
+Suite* snapshot_suite(void);
+Suite* rig_rt_suite(void);
+Suite* oc_stats_suite(void);
+Suite* profile_suite(void);
+Suite* table_generator_suite(void);
+Suite* equivalence_suite(void);
+Suite* lookup_suite(void);
+Suite* complexity_suite(void);
 
 
 #define __TEST_H__